@@ -11,17 +11,22 @@
 #define BST_HPP
 #include <iostream>
 #include <queue>
+#include <type_traits>
 #include <vector>
 #include "BSTIterator.hpp"
 #include "BSTNode.hpp"
+#include "NodeIndex.hpp"
 using namespace std;
 
 /**
  * To build a BST with root, size and height.
  * It is able to build an empty
  * tree directly or delete all of the nodes in a BST.
+ * Index is the kind of hash index find() can use: NoIndex by default,
+ * or NodeIndex<Data> for a BST whose Data has std::hash, which makes
+ * enableIndex() available.
  */
-template <typename Data>
+template <typename Data, typename Index = NoIndex<Data>>
 class BST {
   protected:
     // pointer to the root of this BST, or 0 if the BST is empty
@@ -33,6 +38,10 @@ class BST {
     // height of this BST.
     int iheight;
 
+    // optional hash index from data to node used by find(),
+    // or nullptr if it is disabled
+    Index* index;
+
   public:
     /** Define iterator as an aliased typename for BSTIterator<Data>. */
     typedef BSTIterator<Data> iterator;
@@ -41,22 +50,33 @@ class BST {
      * Default constructor.
      * Initialize an empty BST.
      */
-    BST() : root(0), isize(0), iheight(-1) {}
+    BST() : root(0), isize(0), iheight(-1), index(nullptr) {}
 
     /** A copy constructor that creates a valid balanced BST with all
      * the data in the given binary search tree */
-    BST(const BST<Data>& bst) : root(0), isize(0), iheight(-1) {
-        vector<Data> inorder_vector = bst.inorder();
+    BST(const BST& bst)
+        : root(0), isize(0), iheight(-1), index(nullptr) {
+        // collect pointers to the data in order instead of copies, so
+        // that every item is copied only once, into its new node
+        vector<const Data*> inorder_vector;
+        inorder_vector.reserve(bst.size());
+        bst.forEachInOrder([&inorder_vector](const Data& item) {
+            inorder_vector.push_back(&item);
+        });
         // call the 'buildSubtree' helper function to
         // build subtress by recursion
         this->root =
             buildSubtree(inorder_vector, 0, inorder_vector.size(), iheight);
         this->isize = bst.size();
+        if (bst.indexed()) {
+            buildIndex();
+        }
     }
 
     /** Default destructor.
      * Delete every node in this BST. */
     ~BST() {
+        delete this->index;
         deleteAll(this->root);
         this->isize = 0;
         this->iheight = -1;
@@ -73,6 +93,9 @@ class BST {
         if (this->empty() == true) {
             BSTNode<Data>* rt = new BSTNode<Data>(item);
             this->root = rt;
+            if (this->index != nullptr) {
+                this->index->insert(rt);
+            }
             isize++;
             iheight++;
             return true;
@@ -91,6 +114,9 @@ class BST {
                     BSTNode<Data>* child = new BSTNode<Data>(item);
                     child->parent = current;
                     current->left = child;
+                    if (this->index != nullptr) {
+                        this->index->insert(child);
+                    }
                     isize++;
                     if (iheight < ht) {
                         iheight = ht;
@@ -106,6 +132,9 @@ class BST {
                     BSTNode<Data>* child = new BSTNode<Data>(item);
                     child->parent = current;
                     current->right = child;
+                    if (this->index != nullptr) {
+                        this->index->insert(child);
+                    }
                     isize++;
                     if (iheight < ht) {
                         iheight = ht;
@@ -124,6 +153,11 @@ class BST {
      * Reference: Stepik
      */
     iterator find(const Data& item) const {
+        // an exact match is one hash lookup if the index is enabled
+        if (this->index != nullptr) {
+            iterator indexItr(this->index->find(item));
+            return indexItr;
+        }
         if (!(this->root < nullptr) && !(nullptr < this->root)) {
             iterator nullItr(nullptr);
             return nullItr;
@@ -161,6 +195,12 @@ class BST {
             return false;
         }
 
+        // the node holding item is about to go away or to take
+        // its successor's data
+        if (this->index != nullptr) {
+            this->index->erase(item);
+        }
+
         // leaf node
         // findNd->left == nullptr && findNd->right == nullptr
         if (!(findNd->left < nullptr) && !(nullptr < findNd->left) &&
@@ -184,6 +224,10 @@ class BST {
                 ((findNd->right < nullptr) || (nullptr < findNd->right))) {
                 BSTNode<Data>* successorNode = findNd->successor();
                 findNd->setData(successorNode->getData());
+                // the successor's data now lives in findNd
+                if (this->index != nullptr) {
+                    this->index->update(findNd->getData(), findNd);
+                }
                 // call the helper method to delete a node with
                 // two children
                 twoChildrenDelete(findNd, successorNode);
@@ -225,6 +269,33 @@ class BST {
         }
     }
 
+    /** Build a hash index over the current nodes and keep it in sync
+     * from now on, so that find() no longer descends the tree.
+     * Ordered operations are not affected. */
+    void enableIndex() {
+        static_assert(!is_same<Index, NoIndex<Data>>::value,
+                      "declare the BST with NodeIndex<Data> to index it");
+        buildIndex();
+    }
+
+    /** Drop the hash index, find() descends the tree again. */
+    void disableIndex() {
+        delete this->index;
+        this->index = nullptr;
+    }
+
+    /** Return true if the hash index is enabled. */
+    bool indexed() const { return this->index != nullptr; }
+
+    /** Return the number of heap bytes used by the hash index,
+     * 0 if it is disabled. */
+    size_t indexMemoryUsage() const {
+        if (this->index == nullptr) {
+            return 0;
+        }
+        return this->index->memoryUsage();
+    }
+
     /** Return the number of items currently in the BST. */
     unsigned int size() const { return this->isize; }
 
@@ -255,23 +326,80 @@ class BST {
     }
 
     /** Return an iterator pointing past the last item in the BST. */
-    iterator end() const { return typename BST<Data>::iterator(0); }
+    iterator end() const { return iterator(0); }
 
     /**Perform an inorder traversal of this BST to collect
      * the data of each node in ascending order to a vector.
      * Return a vector.*/
     vector<Data> inorder() const {
         vector<Data> returnVec;
-        if (isize == 0) {
-            return returnVec;
+        returnVec.reserve(isize);
+        forEachInOrder(
+            [&returnVec](const Data& item) { returnVec.push_back(item); });
+        return returnVec;
+    }
+
+    /**
+     * Call visit(const Data&) on every item in ascending order without
+     * copying anything. The walk follows parent links from node to
+     * successor, so it neither recurses nor allocates and works on
+     * trees of any depth.
+     */
+    template <typename Visitor>
+    void forEachInOrder(Visitor visit) const {
+        for (BSTNode<Data>* n = first(this->root); n != nullptr;
+             n = n->successor()) {
+            visit(n->getData());
         }
-        BSTNode<Data>* current = this->root;
+    }
 
-        // call helper method to make a ascending vector
-        ordertraverse(current, returnVec);
-        return returnVec;
+    /**
+     * Call visit(const Data&) in ascending order on every item that
+     * is not less than low and not greater than high. Like
+     * forEachInOrder it neither recurses nor allocates.
+     */
+    template <typename Visitor>
+    void forEachInRange(const Data& low, const Data& high,
+                        Visitor visit) const {
+        for (BSTNode<Data>* n = lowerBound(low);
+             n != nullptr && !(high < n->getData()); n = n->successor()) {
+            visit(n->getData());
+        }
     }
 
+    /**
+     * A cursor that hands out the items of a BST in ascending order in
+     * batches of pointers to the data stored in the nodes, so a caller
+     * can process the tree chunk by chunk without copying it. The
+     * cursor keeps only the next node, so the tree must not be
+     * modified while it is in use.
+     */
+    class Cursor {
+      private:
+        BSTNode<Data>* next;
+
+      public:
+        /** Create a cursor positioned at node n. */
+        explicit Cursor(BSTNode<Data>* n) : next(n) {}
+
+        /** Store pointers to at most max following items into out and
+         * return how many were stored, 0 once the cursor is done. */
+        size_t nextBatch(const Data** out, size_t max) {
+            size_t count = 0;
+            while (count < max && next != nullptr) {
+                out[count++] = &next->getData();
+                next = next->successor();
+            }
+            return count;
+        }
+
+        /** Return true if every item has been handed out. */
+        bool done() const { return next == nullptr; }
+    };
+
+    /** Return a Cursor positioned at the smallest item. */
+    Cursor cursor() const { return Cursor(first(this->root)); }
+
     /**
      * DO NOT CHANGE THIS METHOD
      * Prints a tree, including its structure to an
@@ -318,6 +446,20 @@ class BST {
     }
 
   private:
+    /** Helper function for enableIndex() and the copy constructor
+     * Index every node, unless the index is already enabled.
+     */
+    void buildIndex() {
+        if (this->index != nullptr) {
+            return;
+        }
+        this->index = new Index();
+        for (BSTNode<Data>* n = first(this->root); n != nullptr;
+             n = n->successor()) {
+            this->index->insert(n);
+        }
+    }
+
     /** Helper function for begin()
      * Find the first or smallest element in the BST.
      */
@@ -332,39 +474,56 @@ class BST {
         return current;
     }
 
+    /** Helper function for forEachInRange()
+     * Return the node with the smallest item not less than low,
+     * or nullptr if there is none.
+     */
+    BSTNode<Data>* lowerBound(const Data& low) const {
+        BSTNode<Data>* current = this->root;
+        BSTNode<Data>* candidate = nullptr;
+        while (current != nullptr) {
+            if (current->getData() < low) {
+                current = current->right;
+            } else {
+                candidate = current;
+                current = current->left;
+            }
+        }
+        return candidate;
+    }
+
     /** Helper function for the destructor
      * Delete all nodes in the BST
      */
     static void deleteAll(BSTNode<Data>* n) {
-        /* Pseudocode:
-           if current node is null: return;
-           recursively delete left sub-tree
-           recursively delete right sub-tree
-           delete current node
+        /* Rotate every left child up until the current node has
+           none, then delete it and continue with its right subtree.
+           This needs no recursion, so a degenerate tree cannot
+           overflow the stack.
         */
-        if (n == nullptr) {
-            return;
-        }
-
-        if (n->left != nullptr) {  // has a left child
-            deleteAll(n->left);
-        }
-        if (n->right != nullptr) {  // has a right child
-            deleteAll(n->right);
+        while (n != nullptr) {
+            if (n->left != nullptr) {  // has a left child, rotate right
+                BSTNode<Data>* leftChild = n->left;
+                n->left = leftChild->right;
+                leftChild->right = n;
+                n = leftChild;
+            } else {
+                BSTNode<Data>* rightChild = n->right;
+                delete n;
+                n = rightChild;
+            }
         }
-        delete n;
-        return;
     }
 
     /** The helper function
      * that recursively builds a balanced BST with the given data.
-     * data: a vector of data used in building BST
+     * data: a vector of pointers to the data used in building BST
      * start: the start index (inclusive) of the vector
      * used to build the subtre
      * end: the end index (exclusive) of the vector used to build the subtree
      * Depth: the depth of recursion, used to update height
      */
-    BSTNode<Data>* buildSubtree(vector<Data>& data, int start, int end,
+    BSTNode<Data>* buildSubtree(vector<const Data*>& data, int start, int end,
                                 int depth) {
         // The subtree is empty
         if (start == end) {
@@ -378,7 +537,7 @@ class BST {
 
         // Only have one element
         if ((start + 1) == end) {
-            BSTNode<Data>* current = new BSTNode<Data>(data.at(start));
+            BSTNode<Data>* current = new BSTNode<Data>(*data.at(start));
             if (depth > iheight) {  // need to renew the height
                 iheight = depth;
             }
@@ -387,7 +546,7 @@ class BST {
 
         // look for the median
         int median = (end + start) / 2;
-        BSTNode<Data>* current = new BSTNode<Data>(data.at(median));
+        BSTNode<Data>* current = new BSTNode<Data>(*data.at(median));
 
         BSTNode<Data>* left_sub = buildSubtree(data, start, median, depth + 1);
         current->left = left_sub;
@@ -410,19 +569,6 @@ class BST {
         return current;
     }
 
-    /**
-     * Perform an inorder traversal of this BST to
-     * collect the data of each node in ascending order to a vector.
-     */
-    void ordertraverse(BSTNode<Data>* node, vector<Data>& v) const {
-        if (node == nullptr) {
-            return;
-        }
-        ordertraverse(node->left, v);   // add the left subtree
-        v.push_back(node->getData());   // add the node itself
-        ordertraverse(node->right, v);  // add the right subtree
-    }
-
     /**
      * Helper method for 'deleteNode'.
      * Return the node pointer which contains the certain value
@@ -38,8 +38,8 @@ class BSTNode {
     /** Set the value of data */
     void setData(const Data& d) { data = d; }
 
-    /** Get the value of data */
-    Data getData() { return data; }
+    /** Get a reference to the value of data */
+    const Data& getData() const { return data; }
 
     /** Return the successor of this BSTNode in a BST
      * Successor has the smallest element that is
@@ -0,0 +1,445 @@
+/**
+ * This file defines a binary search tree specialised for string keys.
+ * Instead of one heap allocated BSTNode<string> per key (plus a second
+ * allocation for every name longer than the SSO buffer), all nodes live
+ * in a single pool addressed by 32-bit indices. Short keys are stored
+ * inline in the node and long keys are appended to a shared, append-only
+ * character arena. Optionally each node also caches the first 8 bytes of
+ * its key as a big-endian integer, so most comparisons during a descent
+ * are a single integer compare.
+ */
+#ifndef COMPACT_STRING_BST_HPP
+#define COMPACT_STRING_BST_HPP
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Append-only storage for the characters of keys that are too long to be
+ * stored inline. Keys are referred to by their offset, so growing the
+ * underlying vector never invalidates them. Space of deleted keys is not
+ * reclaimed until the arena is destroyed.
+ */
+class KeyArena {
+  private:
+    vector<char> chars;
+
+  public:
+    /** Copy len characters of s to the end of the arena and
+     * return the offset of the first one. */
+    uint32_t append(const char* s, uint32_t len) {
+        uint32_t offset = chars.size();
+        chars.insert(chars.end(), s, s + len);
+        return offset;
+    }
+
+    /** Return a pointer to the characters stored at offset. */
+    const char* at(uint32_t offset) const { return chars.data() + offset; }
+
+    /** Return the number of bytes reserved by the arena. */
+    size_t bytes() const { return chars.capacity(); }
+
+    /** Release the capacity not used by any key. */
+    void shrinkToFit() { chars.shrink_to_fit(); }
+};
+
+/**
+ * The part of a node shared by both layouts: the key record and the
+ * 32-bit links to the children and the parent. A key of up to
+ * INLINE_CAP characters is stored in 'small', otherwise 'offset' is the
+ * position of its characters in the KeyArena.
+ */
+struct CompactStringLinks {
+    static const uint32_t INLINE_CAP = 16;
+    static const uint32_t NIL = 0xFFFFFFFF;
+
+    uint32_t len;
+    union {
+        char small[INLINE_CAP];
+        uint32_t offset;
+    } key;
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;
+};
+
+/** Node layout without a cached prefix (32 bytes). */
+template <bool CachePrefix>
+struct CompactStringNode : CompactStringLinks {};
+
+/** Node layout with the first 8 key bytes cached (40 bytes). */
+template <>
+struct CompactStringNode<true> : CompactStringLinks {
+    uint64_t prefix;
+};
+
+/**
+ * A BST of strings with the same insert/find/deleteNode/inorder contract
+ * as BST<string>, storing its nodes in a pool and its long keys in a
+ * KeyArena. CachePrefix selects whether each node caches an 8-byte key
+ * prefix for fast comparisons.
+ */
+template <bool CachePrefix = true>
+class CompactStringBST {
+  private:
+    typedef CompactStringNode<CachePrefix> Node;
+    static const uint32_t NIL = CompactStringLinks::NIL;
+
+    // pool holding every node, including deleted ones on the free list
+    vector<Node> nodes;
+
+    // characters of the keys longer than INLINE_CAP
+    KeyArena arena;
+
+    // head of the list of deleted node slots, linked through 'right'
+    uint32_t freeList;
+
+    // index of the root node, or NIL if the tree is empty
+    uint32_t root;
+
+    // number of strings stored in this BST
+    unsigned int isize;
+
+    // height of this BST
+    int iheight;
+
+  public:
+    /** Iterator over the keys of a CompactStringBST in ascending order.
+     * Dereferencing returns a copy of the key, like BSTIterator does. */
+    class iterator {
+      private:
+        const CompactStringBST* tree;
+        uint32_t curr;
+
+      public:
+        iterator(const CompactStringBST* tree, uint32_t curr)
+            : tree(tree), curr(curr) {}
+
+        /** Dereference operator. */
+        string operator*() const { return tree->keyOf(curr); }
+
+        /** Pre-increment operator. */
+        iterator& operator++() {
+            curr = tree->successor(curr);
+            return *this;
+        }
+
+        /** Post-increment operator. */
+        iterator operator++(int) {
+            iterator before = *this;
+            ++(*this);
+            return before;
+        }
+
+        /** Equality test operator. */
+        bool operator==(const iterator& other) const {
+            return curr == other.curr;
+        }
+
+        /** Inequality test operator. */
+        bool operator!=(const iterator& other) const {
+            return curr != other.curr;
+        }
+    };
+
+    /** Default constructor. Initialize an empty tree. */
+    CompactStringBST() : freeList(NIL), root(NIL), isize(0), iheight(-1) {}
+
+    /** Insert a copy of item. Return true if it was added, false if an
+     * equal string was already in the tree. */
+    bool insert(const string& item) {
+        uint32_t len = item.size();
+        uint64_t prefix = makePrefix(item.data(), len);
+
+        if (root == NIL) {
+            root = newNode(item, NIL);
+            isize++;
+            iheight++;
+            return true;
+        }
+
+        uint32_t current = root;
+        int ht = 0;
+        while (true) {
+            int cmp = compare(current, item.data(), len, prefix);
+            if (cmp == 0) {
+                return false;
+            }
+            ht++;
+            uint32_t next =
+                cmp > 0 ? nodes[current].left : nodes[current].right;
+            if (next == NIL) {
+                // newNode may grow the pool, so take the index first
+                uint32_t child = newNode(item, current);
+                if (cmp > 0) {
+                    nodes[current].left = child;
+                } else {
+                    nodes[current].right = child;
+                }
+                isize++;
+                if (iheight < ht) {
+                    iheight = ht;
+                }
+                return true;
+            }
+            current = next;
+        }
+    }
+
+    /** Return an iterator pointing to item, or end() if not found. */
+    iterator find(const string& item) const {
+        return iterator(this, findIndex(item));
+    }
+
+    /** Delete item from the tree. Return true if it was deleted, false if
+     * it was not in the tree. */
+    bool deleteNode(const string& item) {
+        uint32_t target = findIndex(item);
+        if (target == NIL) {
+            return false;
+        }
+
+        // With two children, move the successor's key record into the
+        // target and unlink the successor instead; keys are plain
+        // records, so this never touches the arena.
+        if (nodes[target].left != NIL && nodes[target].right != NIL) {
+            uint32_t succ = nodes[target].right;
+            while (nodes[succ].left != NIL) {
+                succ = nodes[succ].left;
+            }
+            copyKey(target, succ);
+            target = succ;
+        }
+
+        uint32_t child = nodes[target].left != NIL ? nodes[target].left
+                                                   : nodes[target].right;
+        uint32_t parent = nodes[target].parent;
+        if (child != NIL) {
+            nodes[child].parent = parent;
+        }
+        if (parent == NIL) {
+            root = child;
+        } else if (nodes[parent].left == target) {
+            nodes[parent].left = child;
+        } else {
+            nodes[parent].right = child;
+        }
+
+        nodes[target].right = freeList;
+        freeList = target;
+        isize--;
+        iheight = computeHeight();
+        return true;
+    }
+
+    /** Return the number of strings in the tree. */
+    unsigned int size() const { return isize; }
+
+    /** Return the height of the tree, -1 if it is empty. */
+    int height() const { return iheight; }
+
+    /** Return true if the tree is empty. */
+    bool empty() const { return isize == 0; }
+
+    /** Return an iterator pointing to the smallest string. */
+    iterator begin() const {
+        if (root == NIL) {
+            return end();
+        }
+        uint32_t current = root;
+        while (nodes[current].left != NIL) {
+            current = nodes[current].left;
+        }
+        return iterator(this, current);
+    }
+
+    /** Return an iterator pointing past the largest string. */
+    iterator end() const { return iterator(this, NIL); }
+
+    /** Return all strings of the tree in ascending order. */
+    vector<string> inorder() const {
+        vector<string> returnVec;
+        returnVec.reserve(isize);
+        for (iterator it = begin(); it != end(); ++it) {
+            returnVec.push_back(*it);
+        }
+        return returnVec;
+    }
+
+    /** Return the number of heap bytes reserved by the node pool
+     * and the key arena. */
+    size_t memoryUsage() const {
+        return nodes.capacity() * sizeof(Node) + arena.bytes();
+    }
+
+    /** Release the pool and arena capacity left over by growth, for
+     * example after loading all keys of a file. */
+    void shrinkToFit() {
+        nodes.shrink_to_fit();
+        arena.shrinkToFit();
+    }
+
+  private:
+    /**
+     * Pack the first 8 bytes of s into a big-endian integer, padding
+     * short strings with zero bytes. Comparing two prefixes as unsigned
+     * integers gives the same order as comparing the strings, unless the
+     * prefixes are equal.
+     */
+    static uint64_t makePrefix(const char* s, uint32_t len) {
+        uint64_t prefix = 0;
+        for (uint32_t i = 0; i < sizeof(uint64_t); i++) {
+            prefix <<= 8;
+            if (i < len) {
+                prefix |= static_cast<unsigned char>(s[i]);
+            }
+        }
+        return prefix;
+    }
+
+    /** Return a pointer to the characters of the key of node n. */
+    const char* keyData(uint32_t n) const {
+        const Node& node = nodes[n];
+        if (node.len <= CompactStringLinks::INLINE_CAP) {
+            return node.key.small;
+        }
+        return arena.at(node.key.offset);
+    }
+
+    /** Return a copy of the key of node n. */
+    string keyOf(uint32_t n) const { return string(keyData(n), nodes[n].len); }
+
+    /** Return the cached prefix of node n, or 0 without prefix caching. */
+    uint64_t prefixOf(const CompactStringNode<true>& node) const {
+        return node.prefix;
+    }
+    uint64_t prefixOf(const CompactStringNode<false>&) const { return 0; }
+
+    /** Store the prefix of a key in node n when prefix caching is on. */
+    static void setPrefix(CompactStringNode<true>& node, uint64_t prefix) {
+        node.prefix = prefix;
+    }
+    static void setPrefix(CompactStringNode<false>&, uint64_t) {}
+
+    /**
+     * Compare the key of node n with the string (s, len) whose prefix is
+     * 'prefix'. Return a negative number, zero or a positive number if the
+     * key is less than, equal to or greater than the string.
+     */
+    int compare(uint32_t n, const char* s, uint32_t len,
+                uint64_t prefix) const {
+        const Node& node = nodes[n];
+        if (CachePrefix) {
+            uint64_t nodePrefix = prefixOf(node);
+            if (nodePrefix != prefix) {
+                return nodePrefix < prefix ? -1 : 1;
+            }
+        }
+        uint32_t minLen = node.len < len ? node.len : len;
+        int cmp = memcmp(keyData(n), s, minLen);
+        if (cmp != 0) {
+            return cmp;
+        }
+        if (node.len == len) {
+            return 0;
+        }
+        return node.len < len ? -1 : 1;
+    }
+
+    /** Return the index of the node holding item, or NIL. */
+    uint32_t findIndex(const string& item) const {
+        uint32_t len = item.size();
+        uint64_t prefix = makePrefix(item.data(), len);
+        uint32_t current = root;
+        while (current != NIL) {
+            int cmp = compare(current, item.data(), len, prefix);
+            if (cmp == 0) {
+                return current;
+            }
+            current = cmp > 0 ? nodes[current].left : nodes[current].right;
+        }
+        return NIL;
+    }
+
+    /** Take a node slot from the free list or the end of the pool and
+     * store item in it. Return the index of the new node. */
+    uint32_t newNode(const string& item, uint32_t parent) {
+        uint32_t n;
+        if (freeList != NIL) {
+            n = freeList;
+            freeList = nodes[n].right;
+        } else {
+            n = nodes.size();
+            nodes.push_back(Node());
+        }
+        Node& node = nodes[n];
+        node.len = item.size();
+        if (node.len <= CompactStringLinks::INLINE_CAP) {
+            memcpy(node.key.small, item.data(), node.len);
+        } else {
+            node.key.offset = arena.append(item.data(), node.len);
+        }
+        setPrefix(node, makePrefix(item.data(), node.len));
+        node.left = node.right = NIL;
+        node.parent = parent;
+        return n;
+    }
+
+    /** Copy the key record (and cached prefix) of node from to node to. */
+    void copyKey(uint32_t to, uint32_t from) {
+        nodes[to].len = nodes[from].len;
+        nodes[to].key = nodes[from].key;
+        setPrefix(nodes[to], prefixOf(nodes[from]));
+    }
+
+    /** Return the in-order successor of node n, or NIL. */
+    uint32_t successor(uint32_t n) const {
+        if (nodes[n].right != NIL) {
+            uint32_t current = nodes[n].right;
+            while (nodes[current].left != NIL) {
+                current = nodes[current].left;
+            }
+            return current;
+        }
+        uint32_t current = n;
+        uint32_t parent = nodes[n].parent;
+        while (parent != NIL && nodes[parent].right == current) {
+            current = parent;
+            parent = nodes[parent].parent;
+        }
+        return parent;
+    }
+
+    /** Return the height of the tree, walking it with an explicit stack
+     * of (node, depth) pairs. */
+    int computeHeight() const {
+        int maxDepth = -1;
+        if (root == NIL) {
+            return maxDepth;
+        }
+        vector<pair<uint32_t, int>> toVisit;
+        toVisit.push_back(make_pair(root, 0));
+        while (!toVisit.empty()) {
+            pair<uint32_t, int> top = toVisit.back();
+            toVisit.pop_back();
+            if (top.second > maxDepth) {
+                maxDepth = top.second;
+            }
+            if (nodes[top.first].left != NIL) {
+                toVisit.push_back(
+                    make_pair(nodes[top.first].left, top.second + 1));
+            }
+            if (nodes[top.first].right != NIL) {
+                toVisit.push_back(
+                    make_pair(nodes[top.first].right, top.second + 1));
+            }
+        }
+        return maxDepth;
+    }
+};
+
+#endif  // COMPACT_STRING_BST_HPP
@@ -0,0 +1,162 @@
+/**
+ * This file defines an open-addressing hash table that maps the data of
+ * a BST to the BSTNode holding it. BST keeps one as an optional side
+ * index so that exact-match lookups cost one hash probe sequence instead
+ * of a root-to-node descent, while the tree itself still provides the
+ * ordered operations. NoIndex is the index of a BST that has none, so a
+ * key type only needs std::hash if the BST is declared with NodeIndex.
+ */
+#ifndef NODEINDEX_HPP
+#define NODEINDEX_HPP
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "BSTNode.hpp"
+
+using namespace std;
+
+/**
+ * A linear-probing hash table from Data to BSTNode<Data>*. The table
+ * does not own the nodes. Each slot caches the full hash of its key, so
+ * probing and growing never recompute hashes and only compare keys whose
+ * hashes match. Deletion shifts the following entries back instead of
+ * leaving tombstones, so lookups never scan dead slots.
+ */
+template <typename Data, typename Hash = hash<Data>>
+class NodeIndex {
+  private:
+    struct Slot {
+        uint64_t hash;
+        BSTNode<Data>* node;  // nullptr if the slot is empty
+    };
+
+    // the table, its size is always a power of two
+    vector<Slot> slots;
+
+    // number of nodes stored in the table
+    size_t count;
+
+    // the table grows once count exceeds MAX_LOAD_NUM / MAX_LOAD_DEN
+    // of its capacity
+    static const size_t MAX_LOAD_NUM = 3;
+    static const size_t MAX_LOAD_DEN = 4;
+    static const size_t MIN_CAPACITY = 16;
+
+  public:
+    /** Create an empty index. */
+    NodeIndex() : slots(MIN_CAPACITY, Slot{0, nullptr}), count(0) {}
+
+    /** Return the node holding item, or nullptr if there is none. */
+    BSTNode<Data>* find(const Data& item) const {
+        size_t i = slotOf(item);
+        return i == slots.size() ? nullptr : slots[i].node;
+    }
+
+    /** Add node under its own data. The data must not be indexed yet. */
+    void insert(BSTNode<Data>* node) {
+        if ((count + 1) * MAX_LOAD_DEN > slots.size() * MAX_LOAD_NUM) {
+            grow();
+        }
+        place(Slot{hashOf(node->getData()), node});
+        count++;
+    }
+
+    /** Point the entry for item at node, which now holds item. Used when
+     * BST::deleteNode moves a successor's data into another node. */
+    void update(const Data& item, BSTNode<Data>* node) {
+        size_t i = slotOf(item);
+        if (i != slots.size()) {
+            slots[i].node = node;
+        }
+    }
+
+    /** Remove the entry for item, if there is one. */
+    void erase(const Data& item) {
+        size_t hole = slotOf(item);
+        if (hole == slots.size()) {
+            return;
+        }
+        // Shift back every following entry of the cluster that would
+        // become unreachable across the hole.
+        size_t mask = slots.size() - 1;
+        for (size_t i = (hole + 1) & mask; slots[i].node != nullptr;
+             i = (i + 1) & mask) {
+            size_t home = slots[i].hash & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole].node = nullptr;
+        count--;
+    }
+
+    /** Return the number of indexed nodes. */
+    size_t size() const { return count; }
+
+    /** Return the number of heap bytes reserved by the table. */
+    size_t memoryUsage() const { return slots.capacity() * sizeof(Slot); }
+
+  private:
+    /** Hash item and spread the bits, since std::hash of an integer is
+     * usually the identity and the table uses the low bits. */
+    static uint64_t hashOf(const Data& item) {
+        const uint64_t GOLDEN = 0x9E3779B97F4A7C15ULL;
+        uint64_t h = static_cast<uint64_t>(Hash()(item)) * GOLDEN;
+        return h ^ (h >> 32);
+    }
+
+    /** Return the slot holding item, or slots.size() if there is none. */
+    size_t slotOf(const Data& item) const {
+        uint64_t h = hashOf(item);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.node == nullptr) {
+                return slots.size();
+            }
+            if (slot.hash == h && !(slot.node->getData() < item) &&
+                !(item < slot.node->getData())) {
+                return i;
+            }
+        }
+    }
+
+    /** Put an entry into the first free slot of its probe sequence. */
+    void place(const Slot& entry) {
+        size_t mask = slots.size() - 1;
+        size_t i = entry.hash & mask;
+        while (slots[i].node != nullptr) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = entry;
+    }
+
+    /** Double the table and re-place every entry. */
+    void grow() {
+        vector<Slot> old(slots.size() * 2, Slot{0, nullptr});
+        old.swap(slots);
+        for (const Slot& entry : old) {
+            if (entry.node != nullptr) {
+                place(entry);
+            }
+        }
+    }
+};
+
+/**
+ * The index policy of a BST without a side index. It never holds a
+ * node and never hashes, so it puts no requirement on Data.
+ */
+template <typename Data>
+class NoIndex {
+  public:
+    BSTNode<Data>* find(const Data&) const { return nullptr; }
+    void insert(BSTNode<Data>*) {}
+    void update(const Data&, BSTNode<Data>*) {}
+    void erase(const Data&) {}
+    size_t size() const { return 0; }
+    size_t memoryUsage() const { return 0; }
+};
+
+#endif  // NODEINDEX_HPP
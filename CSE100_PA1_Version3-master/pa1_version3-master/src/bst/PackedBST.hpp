@@ -0,0 +1,406 @@
+/**
+ * This file defines a binary search tree for arithmetic keys that stores
+ * its nodes as a structure of arrays: one pool of keys and one pool each
+ * of left, right and parent links, all addressed by 32-bit indices. A
+ * node of BST<int> is a 4-byte key next to three 8-byte pointers in its
+ * own heap block. Here a node costs 16 bytes, and a descent only touches
+ * the key and link arrays.
+ */
+#ifndef PACKEDBST_HPP
+#define PACKEDBST_HPP
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "BST.hpp"
+
+using namespace std;
+
+/**
+ * A BST with the same contract as BST<Data> (insert, find, deleteNode,
+ * iterators, inorder, print and the balancing copy constructor) for
+ * trivially copyable arithmetic keys. Branchless selects the descent
+ * used by find(): the branch-free one walks to a leaf tracking the
+ * lower bound, picking each child with an index instead of a branch,
+ * the other one stops at the first equal key. The branchy descent is
+ * the default because it lets the CPU speculate the next load, which
+ * measured faster on random keys (see benchBST int).
+ */
+template <typename Data, bool Branchless = false>
+class PackedBST {
+    static_assert(is_arithmetic<Data>::value &&
+                      is_trivially_copyable<Data>::value,
+                  "PackedBST needs trivially copyable arithmetic keys");
+
+  private:
+    static const uint32_t NIL = 0xFFFFFFFF;
+
+    // the node pools, node i is (keys[i], left[i], right[i], parent[i])
+    vector<Data> keys;
+    vector<uint32_t> left;
+    vector<uint32_t> right;
+    vector<uint32_t> parent;
+
+    // head of the list of deleted node slots, linked through 'right'
+    uint32_t freeList;
+
+    // index of the root node, or NIL if the tree is empty
+    uint32_t root;
+
+    // number of Data items stored in this BST
+    unsigned int isize;
+
+    // height of this BST
+    int iheight;
+
+  public:
+    /** Iterator over the keys in ascending order. */
+    class iterator {
+      private:
+        const PackedBST* tree;
+        uint32_t curr;
+
+      public:
+        iterator(const PackedBST* tree, uint32_t curr)
+            : tree(tree), curr(curr) {}
+
+        /** Dereference operator. */
+        Data operator*() const { return tree->keys[curr]; }
+
+        /** Pre-increment operator. */
+        iterator& operator++() {
+            curr = tree->successor(curr);
+            return *this;
+        }
+
+        /** Post-increment operator. */
+        iterator operator++(int) {
+            iterator before = *this;
+            ++(*this);
+            return before;
+        }
+
+        /** Equality test operator. */
+        bool operator==(const iterator& other) const {
+            return curr == other.curr;
+        }
+
+        /** Inequality test operator. */
+        bool operator!=(const iterator& other) const {
+            return curr != other.curr;
+        }
+    };
+
+    /** Default constructor. Initialize an empty BST. */
+    PackedBST() : freeList(NIL), root(NIL), isize(0), iheight(-1) {}
+
+    /** A copy constructor that creates a valid balanced BST with all
+     * the data in the given tree, like the one of BST. */
+    PackedBST(const PackedBST& bst)
+        : freeList(NIL), root(NIL), isize(0), iheight(-1) {
+        vector<Data> sorted = bst.inorder();
+        reserve(sorted.size());
+        root = buildSubtree(sorted, 0, sorted.size(), 0, NIL);
+        isize = sorted.size();
+    }
+
+    /** Reserve room for n nodes in every pool. */
+    void reserve(size_t n) {
+        keys.reserve(n);
+        left.reserve(n);
+        right.reserve(n);
+        parent.reserve(n);
+    }
+
+    /** Insert a copy of item. Return true if it was added, false if an
+     * equal item was already in this BST. */
+    bool insert(const Data& item) {
+        if (root == NIL) {
+            root = newNode(item, NIL);
+            isize++;
+            iheight++;
+            return true;
+        }
+        uint32_t current = root;
+        int ht = 0;
+        while (keys[current] < item || item < keys[current]) {
+            ht++;
+            vector<uint32_t>& side = item < keys[current] ? left : right;
+            if (side[current] == NIL) {
+                // newNode may reallocate the pools, so link the child
+                // only after it returns
+                uint32_t child = newNode(item, current);
+                side[current] = child;
+                isize++;
+                if (iheight < ht) {
+                    iheight = ht;
+                }
+                return true;
+            }
+            current = side[current];
+        }
+        return false;
+    }
+
+    /** Return an iterator pointing to item, or end() if not found. */
+    iterator find(const Data& item) const {
+        return iterator(this, findIndex(item));
+    }
+
+    /** Delete item from this BST. Return true if it was deleted, false
+     * if it was not in this BST. */
+    bool deleteNode(const Data& item) {
+        uint32_t target = findIndex(item);
+        if (target == NIL) {
+            return false;
+        }
+        // With two children, the successor's key moves into the target
+        // and the successor is unlinked instead, as in BST::deleteNode.
+        if (left[target] != NIL && right[target] != NIL) {
+            uint32_t succ = right[target];
+            while (left[succ] != NIL) {
+                succ = left[succ];
+            }
+            keys[target] = keys[succ];
+            target = succ;
+        }
+        uint32_t child = left[target] != NIL ? left[target] : right[target];
+        uint32_t up = parent[target];
+        if (child != NIL) {
+            parent[child] = up;
+        }
+        if (up == NIL) {
+            root = child;
+        } else if (left[up] == target) {
+            left[up] = child;
+        } else {
+            right[up] = child;
+        }
+        right[target] = freeList;
+        freeList = target;
+        isize--;
+        iheight = computeHeight();
+        return true;
+    }
+
+    /** Return the number of items currently in the BST. */
+    unsigned int size() const { return isize; }
+
+    /** Return the height of the BST, -1 if it is empty. */
+    int height() const { return iheight; }
+
+    /** Return true if the BST is empty. */
+    bool empty() const { return isize == 0; }
+
+    /** Return an iterator pointing to the smallest item. */
+    iterator begin() const {
+        if (root == NIL) {
+            return end();
+        }
+        uint32_t current = root;
+        while (left[current] != NIL) {
+            current = left[current];
+        }
+        return iterator(this, current);
+    }
+
+    /** Return an iterator pointing past the last item. */
+    iterator end() const { return iterator(this, NIL); }
+
+    /** Return all items in ascending order. */
+    vector<Data> inorder() const {
+        vector<Data> returnVec;
+        returnVec.reserve(isize);
+        for (iterator it = begin(); it != end(); ++it) {
+            returnVec.push_back(*it);
+        }
+        return returnVec;
+    }
+
+    /** Return the number of heap bytes reserved by the node pools. */
+    size_t memoryUsage() const {
+        return keys.capacity() * sizeof(Data) +
+               (left.capacity() + right.capacity() + parent.capacity()) *
+                   sizeof(uint32_t);
+    }
+
+    /** Release the pool capacity left over by growth. */
+    void shrinkToFit() {
+        keys.shrink_to_fit();
+        left.shrink_to_fit();
+        right.shrink_to_fit();
+        parent.shrink_to_fit();
+    }
+
+    /**
+     * Prints a tree, including its structure, in exactly the same format
+     * as BST::print.
+     */
+    void print(ostream* out) const {
+        if (empty()) {
+            *out << "(Empty tree)" << endl;
+            return;
+        }
+        queue<uint32_t> toVisit;
+        toVisit.push(root);
+        int nodesPerLevel = 1;
+        int totalSpacing = 1 << iheight;
+
+        for (int i = 0; i <= iheight; i++) {
+            for (int j = 0; j < nodesPerLevel; j++) {
+                uint32_t curr = toVisit.front();
+                toVisit.pop();
+                if (curr == NIL) {
+                    *out << "X";
+                    toVisit.push(NIL);
+                    toVisit.push(NIL);
+                } else {
+                    *out << keys[curr];
+                    toVisit.push(left[curr]);
+                    toVisit.push(right[curr]);
+                }
+                for (int k = 0; k < totalSpacing / nodesPerLevel; k++) {
+                    *out << "\t";
+                }
+            }
+            *out << endl;
+            nodesPerLevel *= 2;
+        }
+    }
+
+  private:
+    /** Return the index of the node holding item, or NIL. */
+    uint32_t findIndex(const Data& item) const {
+        if (Branchless) {
+            // Walk to a leaf, remembering the last node whose key is not
+            // less than item; the child is selected by indexing, so the
+            // only branch is the loop condition.
+            const uint32_t* children[2] = {left.data(), right.data()};
+            const Data* k = keys.data();
+            uint32_t current = root;
+            uint32_t candidate = NIL;
+            while (current != NIL) {
+                bool goRight = k[current] < item;
+                candidate = goRight ? candidate : current;
+                current = children[goRight][current];
+            }
+            if (candidate != NIL && !(item < k[candidate])) {
+                return candidate;
+            }
+            return NIL;
+        }
+        uint32_t current = root;
+        while (current != NIL) {
+            if (item < keys[current]) {
+                current = left[current];
+            } else if (keys[current] < item) {
+                current = right[current];
+            } else {
+                return current;
+            }
+        }
+        return NIL;
+    }
+
+    /** Take a slot from the free list or the end of the pools, store
+     * item in it and return its index. */
+    uint32_t newNode(const Data& item, uint32_t up) {
+        uint32_t n;
+        if (freeList != NIL) {
+            n = freeList;
+            freeList = right[n];
+            keys[n] = item;
+            left[n] = NIL;
+            right[n] = NIL;
+            parent[n] = up;
+        } else {
+            n = keys.size();
+            keys.push_back(item);
+            left.push_back(NIL);
+            right.push_back(NIL);
+            parent.push_back(up);
+        }
+        return n;
+    }
+
+    /** Build a balanced subtree from data[start, end) and return its
+     * root, updating the height with the depth of every node. */
+    uint32_t buildSubtree(const vector<Data>& data, size_t start, size_t end,
+                          int depth, uint32_t up) {
+        if (start == end) {
+            return NIL;
+        }
+        size_t median = (start + end) / 2;
+        uint32_t current = newNode(data[median], up);
+        if (depth > iheight) {
+            iheight = depth;
+        }
+        uint32_t leftSub =
+            buildSubtree(data, start, median, depth + 1, current);
+        left[current] = leftSub;
+        uint32_t rightSub =
+            buildSubtree(data, median + 1, end, depth + 1, current);
+        right[current] = rightSub;
+        return current;
+    }
+
+    /** Return the in-order successor of node n, or NIL. */
+    uint32_t successor(uint32_t n) const {
+        if (right[n] != NIL) {
+            uint32_t current = right[n];
+            while (left[current] != NIL) {
+                current = left[current];
+            }
+            return current;
+        }
+        uint32_t current = n;
+        uint32_t up = parent[n];
+        while (up != NIL && right[up] == current) {
+            current = up;
+            up = parent[up];
+        }
+        return up;
+    }
+
+    /** Return the height of the tree, walking it with an explicit stack
+     * of (node, depth) pairs. */
+    int computeHeight() const {
+        int maxDepth = -1;
+        if (root == NIL) {
+            return maxDepth;
+        }
+        vector<pair<uint32_t, int>> toVisit;
+        toVisit.push_back(make_pair(root, 0));
+        while (!toVisit.empty()) {
+            pair<uint32_t, int> top = toVisit.back();
+            toVisit.pop_back();
+            if (top.second > maxDepth) {
+                maxDepth = top.second;
+            }
+            if (left[top.first] != NIL) {
+                toVisit.push_back(make_pair(left[top.first], top.second + 1));
+            }
+            if (right[top.first] != NIL) {
+                toVisit.push_back(make_pair(right[top.first], top.second + 1));
+            }
+        }
+        return maxDepth;
+    }
+};
+
+template <typename Data, bool Branchless>
+const uint32_t PackedBST<Data, Branchless>::NIL;
+
+/**
+ * Select the BST implementation for Data at compile time: PackedBST for
+ * trivially copyable arithmetic keys, BST otherwise.
+ */
+template <typename Data>
+using SelectBST =
+    typename conditional<is_arithmetic<Data>::value &&
+                             is_trivially_copyable<Data>::value,
+                         PackedBST<Data>, BST<Data>>::type;
+
+#endif  // PACKEDBST_HPP
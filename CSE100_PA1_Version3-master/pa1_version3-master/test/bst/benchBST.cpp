@@ -0,0 +1,328 @@
+/**
+ * This program benchmarks the BST variants against each other. It
+ * reports heap usage per key, measured by counting every allocation the
+ * program makes, and the average time of a lookup.
+ *
+ * Modes:
+ * string <actors file>
+ *   Compares BST<string> with CompactStringBST, with and without
+ *   the cached key prefix, on the names in the given file.
+ * index <actors file>
+ *   Compares find() on BST<string> with and without the hash side
+ *   index, and reports the memory cost of the index.
+ * int <number of keys>
+ *   Compares BST<int> with PackedBST<int>, with and without the
+ *   branch-free descent, and std::set<int> on random keys.
+ * traverse <number of keys>
+ *   Compares the time and peak extra heap of a full in-order pass with
+ *   inorder(), forEachInOrder() and a batched Cursor on BST<string>.
+ *
+ * Usage: ./benchBST.cpp.executable <mode> <input filename or count>
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "BST.hpp"
+#include "CompactStringBST.hpp"
+#include "PackedBST.hpp"
+
+using namespace std;
+
+/* Live heap bytes and number of allocations made by the program. Every
+ * block carries its size in a header so that operator delete can
+ * subtract it again. */
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+static size_t numAllocs = 0;
+static const size_t HEADER = alignof(max_align_t);
+
+void* operator new(size_t size) {
+    char* block = static_cast<char*>(malloc(size + HEADER));
+    if (block == nullptr) {
+        throw bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    liveBytes += size;
+    if (liveBytes > peakBytes) {
+        peakBytes = liveBytes;
+    }
+    numAllocs++;
+    return block + HEADER;
+}
+
+void operator delete(void* p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    char* block = static_cast<char*>(p) - HEADER;
+    liveBytes -= *reinterpret_cast<size_t*>(block);
+    free(block);
+}
+
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+/** Snapshot of the allocation counters, used to measure one build. */
+struct HeapUsage {
+    size_t bytes;
+    size_t allocs;
+    HeapUsage() : bytes(liveBytes), allocs(numAllocs) {}
+};
+
+/** Return the nanoseconds elapsed since start. */
+static long long nanosSince(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now() - start)
+        .count();
+}
+
+/** Read one name per line, dropping a trailing CR. */
+static vector<string> loadLines(const char* fileName) {
+    vector<string> lines;
+    ifstream in(fileName, ios::binary);
+    string line;
+    while (getline(in, line)) {
+        line = line.substr(0, line.find('\r'));
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+/** Give the pooled trees back the capacity left over by growth. */
+template <typename Tree>
+static void finishBuild(Tree&) {}
+
+template <bool CachePrefix>
+static void finishBuild(CompactStringBST<CachePrefix>& tree) {
+    tree.shrinkToFit();
+}
+
+template <typename Data, bool Branchless>
+static void finishBuild(PackedBST<Data, Branchless>& tree) {
+    tree.shrinkToFit();
+}
+
+/** std::set has no height, report -1 for it. */
+template <typename Tree>
+static int heightOf(const Tree& tree) {
+    return tree.height();
+}
+
+template <typename Data>
+static int heightOf(const set<Data>&) {
+    return -1;
+}
+
+/**
+ * Build a tree of type Tree from keys, then look every key up ROUNDS
+ * times in shuffled order. Print bytes and allocations per key and the
+ * average lookup time.
+ */
+template <typename Tree, typename Key>
+static void benchTree(const string& name, const vector<Key>& keys,
+                      const vector<Key>& queries) {
+    const int ROUNDS = 20;
+
+    HeapUsage before;
+    auto buildStart = chrono::steady_clock::now();
+    Tree* tree = new Tree();
+    for (const Key& k : keys) {
+        tree->insert(k);
+    }
+    finishBuild(*tree);
+    long long buildTime = nanosSince(buildStart);
+    HeapUsage after;
+
+    size_t found = 0;
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (const Key& q : queries) {
+            if (tree->find(q) != tree->end()) {
+                found++;
+            }
+        }
+    }
+    long long time = nanosSince(start);
+
+    cout << name << endl;
+    cout << "\tBytes per key: "
+         << double(after.bytes - before.bytes) / tree->size() << endl;
+    cout << "\tAllocations per key: "
+         << double(after.allocs - before.allocs) / tree->size() << endl;
+    cout << "\tHeight: " << heightOf(*tree) << endl;
+    cout << "\tBuild time: " << buildTime << " nanoseconds." << endl;
+    cout << "\tLookup time: " << double(time) / (ROUNDS * queries.size())
+         << " nanoseconds." << endl;
+    cout << "\tKeys found: " << found / ROUNDS << endl;
+    delete tree;
+}
+
+/* Compare the string trees on the names in fileName */
+static void benchString(const char* fileName) {
+    vector<string> names = loadLines(fileName);
+    vector<string> queries = names;
+    shuffle(queries.begin(), queries.end(), mt19937(100));
+    cout << "Keys: " << names.size() << endl;
+
+    benchTree<BST<string>>("BST<string>", names, queries);
+    benchTree<CompactStringBST<false>>("CompactStringBST<false>", names,
+                                       queries);
+    benchTree<CompactStringBST<true>>("CompactStringBST<true>", names,
+                                      queries);
+}
+
+/* Compare tree lookups with hash index lookups on the names in fileName */
+static void benchIndex(const char* fileName) {
+    const int ROUNDS = 20;
+    vector<string> names = loadLines(fileName);
+    vector<string> queries = names;
+    shuffle(queries.begin(), queries.end(), mt19937(100));
+    cout << "Keys: " << names.size() << endl;
+
+    BST<string, NodeIndex<string>> tree;
+    for (const string& name : names) {
+        tree.insert(name);
+    }
+
+    for (int indexed = 0; indexed < 2; indexed++) {
+        HeapUsage before;
+        if (indexed) {
+            tree.enableIndex();
+        }
+        HeapUsage after;
+
+        size_t found = 0;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (const string& q : queries) {
+                if (tree.find(q) != tree.end()) {
+                    found++;
+                }
+            }
+        }
+        long long time = nanosSince(start);
+
+        cout << (indexed ? "BST<string> with index" : "BST<string>") << endl;
+        cout << "\tIndex bytes per key: "
+             << double(after.bytes - before.bytes) / tree.size() << endl;
+        cout << "\tLookup time: " << double(time) / (ROUNDS * queries.size())
+             << " nanoseconds." << endl;
+        cout << "\tKeys found: " << found / ROUNDS << endl;
+    }
+}
+
+/* Compare the integer trees on count random keys */
+static void benchInt(unsigned int count) {
+    mt19937 gen(100);
+    vector<int> keys(count);
+    for (int& k : keys) {
+        k = gen();
+    }
+    vector<int> queries = keys;
+    shuffle(queries.begin(), queries.end(), gen);
+    cout << "Keys: " << keys.size() << endl;
+
+    benchTree<BST<int>>("BST<int>", keys, queries);
+    benchTree<PackedBST<int, false>>("PackedBST<int, false>", keys, queries);
+    benchTree<PackedBST<int, true>>("PackedBST<int, true>", keys, queries);
+    benchTree<set<int>>("std::set<int>", keys, queries);
+}
+
+/**
+ * Run one full in-order pass with pass(), ROUNDS times, and print its
+ * average time and the peak heap it needed on top of the tree.
+ */
+template <typename Pass>
+static void benchPass(const string& name, Pass pass) {
+    const int ROUNDS = 10;
+    size_t checksum = 0;
+    size_t base = liveBytes;
+    peakBytes = liveBytes;
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        checksum += pass();
+    }
+    long long time = nanosSince(start);
+    cout << name << endl;
+    cout << "\tTime per pass: " << time / ROUNDS << " nanoseconds." << endl;
+    cout << "\tPeak extra heap: " << peakBytes - base << " bytes." << endl;
+    cout << "\tChecksum: " << checksum / ROUNDS << endl;
+}
+
+/* Compare the ways of walking a BST<string> of count random keys */
+static void benchTraverse(unsigned int count) {
+    const size_t BATCH = 64;
+    mt19937 gen(100);
+    BST<string> tree;
+    for (unsigned int i = 0; i < count; i++) {
+        tree.insert("actor #" + to_string(gen()));
+    }
+    cout << "Keys: " << tree.size() << endl;
+
+    benchPass("inorder()", [&tree]() {
+        size_t total = 0;
+        for (const string& s : tree.inorder()) {
+            total += s.size();
+        }
+        return total;
+    });
+    benchPass("forEachInOrder()", [&tree]() {
+        size_t total = 0;
+        tree.forEachInOrder([&total](const string& s) { total += s.size(); });
+        return total;
+    });
+    benchPass("Cursor, batches of 64", [&tree]() {
+        size_t total = 0;
+        const string* batch[BATCH];
+        BST<string>::Cursor cursor = tree.cursor();
+        size_t n;
+        while ((n = cursor.nextBatch(batch, BATCH)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                total += batch[i]->size();
+            }
+        }
+        return total;
+    });
+}
+
+int main(int argc, char* argv[]) {
+    const int NUM_ARG = 3;
+    if (argc != NUM_ARG) {
+        cout << "Invalid number of arguments.\n"
+             << "Usage: ./benchBST <mode> <input filename>" << endl;
+        return -1;
+    }
+
+    string mode = argv[1];
+    if (mode == "int") {
+        benchInt(stoi(argv[2]));
+        return 0;
+    }
+    if (mode == "traverse") {
+        benchTraverse(stoi(argv[2]));
+        return 0;
+    }
+    if (!ifstream(argv[2]).is_open()) {
+        cout << "Invalid input file. No file was opened. Please try again.\n";
+        return -1;
+    }
+    if (mode == "string") {
+        benchString(argv[2]);
+    } else if (mode == "index") {
+        benchIndex(argv[2]);
+    } else {
+        cout << "Unknown mode: " << mode << endl;
+        return -1;
+    }
+    return 0;
+}
@@ -91,7 +91,6 @@ int main(int argc, char* argv[]) {
     const int TRUC_LEN = 2;
     const int NUM_ARG_FLAG = 4;
     bool printFlag = false;
-    vector<string> inorderVec;
     string result;
 
     // check for Arguments
@@ -126,12 +125,11 @@ int main(int argc, char* argv[]) {
     cout << "Find results for query names: " << result << endl;
 
     if (printFlag) {
-        // print inorder traversal
-        inorderVec = tree.inorder();
+        // print inorder traversal, visiting the data in place
+        // instead of copying the whole tree into a vector
         result = "";
-        for (string& data : inorderVec) {
-            result += (data + ", ");
-        }
+        tree.forEachInOrder(
+            [&result](const string& data) { result += (data + ", "); });
         result = result.substr(0, result.length() - TRUC_LEN);
         cout << "Inorder traversal: " << result << endl;
 
@@ -39,7 +39,7 @@
 #include <sstream>
 #include <string>
 #include <vector>
-#include "BST.hpp"
+#include "PackedBST.hpp"
 
 #define NUM_ARGS_FOR_STD_INOUT 1
 #define NUM_ARGS_FOR_FILE_INOUT 3
@@ -78,10 +78,12 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    BST<int>* bst = new BST<int>();
+    // SelectBST<int> is the structure-of-arrays PackedBST<int>,
+    // which has the same interface as BST<int>
+    SelectBST<int>* bst = new SelectBST<int>();
     // Allocate a buffer into which we can store
     // the iterator
-    BST<int>::iterator it = bst->end();
+    SelectBST<int>::iterator it = bst->end();
 
     *out << "GREETINGS! TYPE COMMANDS TO VISUALIZE YOUR BST." << endl;
 
@@ -151,7 +153,7 @@ int main(int argc, char* argv[]) {
             // Since we're getting rid of the old BST here, we
             // need to delete it in order to ensure that we don't
             // have a memory leak.
-            BST<int>* newBst = new BST<int>(*bst);
+            SelectBST<int>* newBst = new SelectBST<int>(*bst);
             delete bst;
             bst = newBst;
             // The iterator uses a pointer into the old BST's structure
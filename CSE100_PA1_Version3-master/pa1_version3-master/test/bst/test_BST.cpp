@@ -368,4 +368,215 @@ TEST_F(TwoChildrenBSTFixture, deleteNode_TEST) {
     out = &cout;
     bst.print(out);
 }
+/**
+ * Create a test fixture with the hash index enabled before and
+ * after inserting
+ * */
+class IndexedBSTFixture : public ::testing::Test {
+  protected:
+    BST<int, NodeIndex<int>> bst;
+    BST<int, NodeIndex<int>> lateBst;
+    vector<int> input{50, 20, 80, 10, 30, 70, 90, 25, 35, 60, 75};
+
+  public:
+    IndexedBSTFixture() {
+        bst.enableIndex();
+        insertIntoBST(input, bst);
+        insertIntoBST(input, lateBst);
+        lateBst.enableIndex();
+    }
+};
+
+// Test that find() through the index returns the same nodes as the tree
+TEST_F(IndexedBSTFixture, INDEX_FIND_TEST) {
+    ASSERT_TRUE(bst.indexed());
+    ASSERT_TRUE(lateBst.indexed());
+    for (int i : input) {
+        ASSERT_EQ(*bst.find(i), i);
+        ASSERT_EQ(*lateBst.find(i), i);
+    }
+    ASSERT_TRUE(bst.find(55) == bst.end());
+    ASSERT_TRUE(lateBst.find(-1) == lateBst.end());
+
+    // iterators from the index still walk the tree in order
+    BSTIterator<int> it = bst.find(30);
+    ASSERT_EQ(*(++it), 35);
+}
+
+// Test that deleteNode() keeps the index in sync for every case
+TEST_F(IndexedBSTFixture, INDEX_DELETE_TEST) {
+    ASSERT_TRUE(bst.deleteNode(20));  // two children
+    ASSERT_TRUE(bst.deleteNode(10));  // leaf
+    ASSERT_TRUE(bst.deleteNode(90));  // leaf
+    ASSERT_TRUE(bst.deleteNode(80));  // one left child
+    ASSERT_TRUE(bst.deleteNode(50));  // root, two children
+    ASSERT_FALSE(bst.deleteNode(50));
+
+    set<int> remaining{30, 70, 25, 35, 60, 75};
+    for (int i : input) {
+        BSTIterator<int> it = bst.find(i);
+        if (remaining.count(i) > 0) {
+            ASSERT_EQ(*it, i);
+        } else {
+            ASSERT_TRUE(it == bst.end());
+        }
+    }
+    ASSERT_TRUE(bst.insert(20));
+    ASSERT_EQ(*bst.find(20), 20);
+}
+
+// Test that the copy constructor keeps the index and disabling works
+TEST_F(IndexedBSTFixture, INDEX_COPY_TEST) {
+    BST<int, NodeIndex<int>> copy(bst);
+    ASSERT_TRUE(copy.indexed());
+    ASSERT_EQ(*copy.find(75), 75);
+    ASSERT_GT(copy.indexMemoryUsage(), 0u);
+
+    copy.disableIndex();
+    ASSERT_FALSE(copy.indexed());
+    ASSERT_EQ(copy.indexMemoryUsage(), 0u);
+    ASSERT_EQ(*copy.find(75), 75);
+}
+
+// Test that the index survives many inserts and deletes with strings
+TEST(IndexedBSTTests, INDEX_STRESS_TEST) {
+    BST<string, NodeIndex<string>> bst;
+    set<string> reference;
+    bst.enableIndex();
+    for (int i = 0; i < 2000; i++) {
+        string key = to_string((i * 7919) % 1000);
+        if (i % 3 == 2) {
+            ASSERT_EQ(bst.deleteNode(key), reference.erase(key) > 0);
+        } else {
+            ASSERT_EQ(bst.insert(key), reference.insert(key).second);
+        }
+    }
+    for (int i = 0; i < 1000; i++) {
+        string key = to_string(i);
+        ASSERT_EQ(bst.find(key) != bst.end(), reference.count(key) > 0);
+    }
+    ASSERT_EQ(bst.inorder(),
+              vector<string>(reference.begin(), reference.end()));
+}
+
+/* A key type with operator< and nothing else, in particular no
+ * std::hash */
+struct OrderedOnly {
+    int key;
+    bool operator<(const OrderedOnly& other) const { return key < other.key; }
+};
+
+// Test that a BST without an index needs nothing of Data but operator<
+TEST(IndexedBSTTests, NO_HASH_TEST) {
+    BST<OrderedOnly> bst;
+    for (int i : {5, 2, 8, 1, 9, 3}) {
+        ASSERT_TRUE(bst.insert(OrderedOnly{i}));
+    }
+    ASSERT_FALSE(bst.insert(OrderedOnly{8}));
+    ASSERT_FALSE(bst.indexed());
+    ASSERT_EQ((*bst.find(OrderedOnly{3})).key, 3);
+    ASSERT_TRUE(bst.find(OrderedOnly{4}) == bst.end());
+    ASSERT_TRUE(bst.deleteNode(OrderedOnly{5}));
+    BST<OrderedOnly> copy(bst);
+    ASSERT_EQ(copy.size(), 5);
+    ASSERT_TRUE(copy.find(OrderedOnly{5}) == copy.end());
+}
+
+// Test forEachInOrder() against inorder()
+TEST_F(BigBSTFixture, FOR_EACH_IN_ORDER_TEST) {
+    vector<int> visited;
+    bst.forEachInOrder([&visited](const int& i) { visited.push_back(i); });
+    ASSERT_EQ(visited, bst.inorder());
+    ASSERT_EQ(visited, vector<int>({-1, 1, 2, 7, 8, 20, 100}));
+}
+
+// Test forEachInRange() with bounds inside, outside and between items
+TEST_F(BigBSTFixture, FOR_EACH_IN_RANGE_TEST) {
+    vector<int> visited;
+    auto collect = [&visited](const int& i) { visited.push_back(i); };
+    bst.forEachInRange(1, 8, collect);
+    ASSERT_EQ(visited, vector<int>({1, 2, 7, 8}));
+    visited.clear();
+    bst.forEachInRange(3, 50, collect);
+    ASSERT_EQ(visited, vector<int>({7, 8, 20}));
+    visited.clear();
+    bst.forEachInRange(-100, 1000, collect);
+    ASSERT_EQ(visited, bst.inorder());
+    visited.clear();
+    bst.forEachInRange(101, 1000, collect);
+    bst.forEachInRange(9, 10, collect);
+    ASSERT_TRUE(visited.empty());
+}
+
+// Test that the cursor hands out every item once, in batches
+TEST_F(BigBSTFixture, CURSOR_TEST) {
+    const size_t BATCH = 3;
+    const int* batch[BATCH];
+    vector<int> visited;
+    vector<size_t> sizes;
+    BST<int>::Cursor cursor = bst.cursor();
+    while (!cursor.done()) {
+        size_t count = cursor.nextBatch(batch, BATCH);
+        sizes.push_back(count);
+        for (size_t i = 0; i < count; i++) {
+            visited.push_back(*batch[i]);
+        }
+    }
+    ASSERT_EQ(sizes, vector<size_t>({3, 3, 1}));
+    ASSERT_EQ(visited, bst.inorder());
+    ASSERT_EQ(cursor.nextBatch(batch, BATCH), 0u);
+
+    // the pointers refer to the data inside the tree, not to copies
+    const int* smallest[1] = {nullptr};
+    const int* again[1] = {nullptr};
+    ASSERT_EQ(bst.cursor().nextBatch(smallest, 1), 1u);
+    ASSERT_EQ(bst.cursor().nextBatch(again, 1), 1u);
+    ASSERT_EQ(smallest[0], again[0]);
+    ASSERT_EQ(*smallest[0], -1);
+}
+
+/**
+ * A BST that can link a degenerate chain of nodes directly, since
+ * inserting sorted items one by one takes quadratic time.
+ * */
+class ChainBST : public BST<int> {
+  public:
+    explicit ChainBST(int n) {
+        BSTNode<int>* last = nullptr;
+        for (int i = 0; i < n; i++) {
+            BSTNode<int>* node = new BSTNode<int>(i);
+            node->parent = last;
+            if (last == nullptr) {
+                this->root = node;
+            } else {
+                last->right = node;
+            }
+            last = node;
+        }
+        this->isize = n;
+        this->iheight = n - 1;
+    }
+};
+
+// Test that traversing, copying and destroying a very deep tree
+// does not overflow the stack
+TEST(DeepBSTTests, DEGENERATE_TREE_TEST) {
+    const int DEPTH = 1000000;
+    ChainBST chain(DEPTH);
+    long long sum = 0;
+    chain.forEachInOrder([&sum](const int& i) { sum += i; });
+    ASSERT_EQ(sum, (long long)DEPTH * (DEPTH - 1) / 2);
+
+    int count = 0;
+    chain.forEachInRange(10, DEPTH, [&count](const int&) { count++; });
+    ASSERT_EQ(count, DEPTH - 10);
+
+    vector<int> all = chain.inorder();
+    ASSERT_EQ(all.size(), (size_t)DEPTH);
+    ASSERT_EQ(all.back(), DEPTH - 1);
+
+    BST<int> balanced(chain);
+    ASSERT_EQ(balanced.height(), 19);
+}
+
 // TODO: add more BST tests here
\ No newline at end of file
@@ -0,0 +1,106 @@
+/**
+ * This file contains google tests to test the
+ * methods written in CompactStringBST.hpp.
+ */
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "BST.hpp"
+#include "CompactStringBST.hpp"
+
+using namespace std;
+using namespace testing;
+
+/**
+ * Builds a tree mixing keys that fit inline with keys that have to
+ * live in the arena, and keys that only differ after the cached prefix.
+ */
+class CompactStringBSTFixture : public ::testing::Test {
+  protected:
+    CompactStringBST<true> bst;
+    CompactStringBST<false> plain;
+    vector<string> input{"KEEGAN",
+                         "BRANDON MARK (I)",
+                         "FORRESTALL SHANNA",
+                         "A",
+                         "ABCDEFGH",
+                         "ABCDEFGHI",
+                         "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+                         "ABCDEFGHIJKLMNOPQRSTUVWXYY",
+                         "ZED"};
+
+  public:
+    CompactStringBSTFixture() {
+        for (const string& s : input) {
+            bst.insert(s);
+            plain.insert(s);
+        }
+    }
+};
+
+// Test that every inserted key is found and others are not
+TEST_F(CompactStringBSTFixture, FIND_TEST) {
+    for (const string& s : input) {
+        ASSERT_EQ(*bst.find(s), s);
+        ASSERT_EQ(*plain.find(s), s);
+    }
+    ASSERT_TRUE(bst.find("ABCDEFG") == bst.end());
+    ASSERT_TRUE(bst.find("ABCDEFGHIJ") == bst.end());
+    ASSERT_TRUE(bst.find("") == bst.end());
+    ASSERT_TRUE(plain.find("KEEGANS") == plain.end());
+}
+
+// Test that duplicates are rejected
+TEST_F(CompactStringBSTFixture, INSERT_DUPLICATE_TEST) {
+    ASSERT_EQ(bst.size(), input.size());
+    ASSERT_FALSE(bst.insert("ABCDEFGHIJKLMNOPQRSTUVWXYZ"));
+    ASSERT_FALSE(plain.insert("A"));
+    ASSERT_EQ(bst.size(), input.size());
+}
+
+// Test that inorder() and the iterator give the same order as std::sort
+TEST_F(CompactStringBSTFixture, INORDER_TEST) {
+    vector<string> sorted = input;
+    sort(sorted.begin(), sorted.end());
+    ASSERT_EQ(bst.inorder(), sorted);
+    ASSERT_EQ(plain.inorder(), sorted);
+
+    vector<string> iterated;
+    for (auto it = bst.begin(); it != bst.end(); ++it) {
+        iterated.push_back(*it);
+    }
+    ASSERT_EQ(iterated, sorted);
+}
+
+// Test deleteNode() on leaves, inner nodes and the root
+TEST_F(CompactStringBSTFixture, DELETE_TEST) {
+    set<string> expected(input.begin(), input.end());
+    ASSERT_FALSE(bst.deleteNode("NOT THERE"));
+    for (const string& s : input) {
+        ASSERT_TRUE(bst.deleteNode(s));
+        expected.erase(s);
+        ASSERT_TRUE(bst.find(s) == bst.end());
+        ASSERT_EQ(bst.inorder(),
+                  vector<string>(expected.begin(), expected.end()));
+    }
+    ASSERT_TRUE(bst.empty());
+    ASSERT_EQ(bst.height(), -1);
+
+    // slots on the free list are reused
+    ASSERT_TRUE(bst.insert("AGAIN"));
+    ASSERT_EQ(*bst.begin(), "AGAIN");
+}
+
+// Test that the height matches the generic BST for the same input
+TEST_F(CompactStringBSTFixture, HEIGHT_TEST) {
+    BST<string> generic;
+    for (const string& s : input) {
+        generic.insert(s);
+    }
+    ASSERT_EQ(bst.height(), generic.height());
+    ASSERT_EQ(plain.height(), generic.height());
+}
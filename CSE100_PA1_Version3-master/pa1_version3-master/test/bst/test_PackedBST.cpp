@@ -0,0 +1,141 @@
+/**
+ * This file contains google tests to test the
+ * methods written in PackedBST.hpp against BST.hpp.
+ */
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "BST.hpp"
+#include "PackedBST.hpp"
+#include "util.hpp"
+
+using namespace std;
+using namespace testing;
+
+/** Return what print() writes for the given tree. */
+template <typename Tree>
+static string printed(Tree& tree) {
+    ostringstream out;
+    tree.print(&out);
+    return out.str();
+}
+
+// Test that SelectBST picks the packed tree only for arithmetic keys
+TEST(PackedBSTTests, SELECT_TEST) {
+    ASSERT_TRUE((is_same<SelectBST<int>, PackedBST<int>>::value));
+    ASSERT_TRUE((is_same<SelectBST<double>, PackedBST<double>>::value));
+    ASSERT_TRUE((is_same<SelectBST<string>, BST<string>>::value));
+}
+
+// Test the empty tree
+TEST(PackedBSTTests, EMPTY_TEST) {
+    PackedBST<int> bst;
+    ASSERT_TRUE(bst.empty());
+    ASSERT_EQ(bst.height(), -1);
+    ASSERT_TRUE(bst.begin() == bst.end());
+    ASSERT_TRUE(bst.find(1) == bst.end());
+    ASSERT_FALSE(bst.deleteNode(1));
+    ASSERT_EQ(printed(bst), "(Empty tree)\n");
+}
+
+/**
+ * Builds the same trees as a BST<int> so that every operation can be
+ * compared, including the printed structure.
+ */
+class PackedBSTFixture : public ::testing::Test {
+  protected:
+    BST<int> reference;
+    PackedBST<int, true> branchless;
+    PackedBST<int, false> branchy;
+    vector<int> input{8, 7, 2, 1, 20, -1, 100, 15, 17, 16, 30};
+
+  public:
+    PackedBSTFixture() {
+        insertIntoBST(input, reference);
+        for (int i : input) {
+            branchless.insert(i);
+            branchy.insert(i);
+        }
+    }
+};
+
+// Test insert(), find(), size() and height()
+TEST_F(PackedBSTFixture, FIND_TEST) {
+    ASSERT_EQ(branchless.size(), reference.size());
+    ASSERT_EQ(branchless.height(), reference.height());
+    ASSERT_FALSE(branchless.insert(8));
+    for (int i = -5; i < 105; i++) {
+        bool found = reference.find(i) != reference.end();
+        ASSERT_EQ(branchless.find(i) != branchless.end(), found);
+        ASSERT_EQ(branchy.find(i) != branchy.end(), found);
+    }
+    ASSERT_EQ(*branchless.find(17), 17);
+    ASSERT_EQ(*branchy.find(-1), -1);
+}
+
+// Test inorder(), the iterator and print()
+TEST_F(PackedBSTFixture, TRAVERSAL_TEST) {
+    ASSERT_EQ(branchless.inorder(), reference.inorder());
+    PackedBST<int, true>::iterator it = branchless.find(8);
+    ASSERT_EQ(*(++it), 15);
+    ASSERT_EQ(*(it++), 15);
+    ASSERT_EQ(*it, 16);
+    ASSERT_EQ(printed(branchless), printed(reference));
+}
+
+// Test that deleteNode() reshapes the tree exactly like BST
+TEST_F(PackedBSTFixture, DELETE_TEST) {
+    for (int i : {20, 1, 8, 100, 16, 7}) {
+        ASSERT_EQ(branchless.deleteNode(i), reference.deleteNode(i));
+        ASSERT_EQ(printed(branchless), printed(reference));
+        ASSERT_EQ(branchless.height(), reference.height());
+    }
+    ASSERT_FALSE(branchless.deleteNode(20));
+    ASSERT_TRUE(branchless.insert(20));
+    ASSERT_TRUE(reference.insert(20));
+    ASSERT_EQ(printed(branchless), printed(reference));
+}
+
+// Test that the copy constructor balances like BST
+TEST_F(PackedBSTFixture, BALANCE_TEST) {
+    PackedBST<int, true> balanced(branchless);
+    BST<int> referenceBalanced(reference);
+    ASSERT_EQ(balanced.height(), referenceBalanced.height());
+    ASSERT_EQ(printed(balanced), printed(referenceBalanced));
+}
+
+// Test both descents against std::set on random data
+TEST(PackedBSTTests, RANDOM_TEST) {
+    mt19937 gen(7);
+    uniform_int_distribution<int> dist(-500, 500);
+    set<int> expected;
+    PackedBST<int, true> branchless;
+    PackedBST<int, false> branchy;
+    for (int i = 0; i < 3000; i++) {
+        int val = dist(gen);
+        if (i % 4 == 3) {
+            bool erased = expected.erase(val) > 0;
+            ASSERT_EQ(branchless.deleteNode(val), erased);
+            ASSERT_EQ(branchy.deleteNode(val), erased);
+        } else {
+            bool added = expected.insert(val).second;
+            ASSERT_EQ(branchless.insert(val), added);
+            ASSERT_EQ(branchy.insert(val), added);
+        }
+    }
+    vector<int> sorted(expected.begin(), expected.end());
+    ASSERT_EQ(branchless.inorder(), sorted);
+    ASSERT_EQ(branchy.inorder(), sorted);
+    for (int val = -501; val <= 501; val++) {
+        bool found = expected.count(val) > 0;
+        ASSERT_EQ(branchless.find(val) != branchless.end(), found);
+        ASSERT_EQ(branchy.find(val) != branchy.end(), found);
+    }
+}
@@ -0,0 +1,1035 @@
+/**
+ * This file implements ArtTrie: inserting, updating and removing words
+ * with node growth and prefix splits, and the searches of the
+ * DictionaryTrie contract on top of the tree.
+ */
+#include "ArtTrie.hpp"
+#include <algorithm>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const uint32_t ArtTrie::NONE;
+
+ArtTrie::ArtTrie() : root(NONE), wordCount(0) {}
+
+/**
+ * Return the header of an inner node
+ */
+ArtTrie::Header& ArtTrie::header(uint32_t ref) {
+    uint32_t i = indexOf(ref);
+    switch (kindOf(ref)) {
+        case NODE4:
+            return node4s[i].h;
+        case NODE16:
+            return node16s[i].h;
+        case NODE48:
+            return node48s[i].h;
+        default:
+            return node256s[i].h;
+    }
+}
+
+const ArtTrie::Header& ArtTrie::header(uint32_t ref) const {
+    return const_cast<ArtTrie*>(this)->header(ref);
+}
+
+/**
+ * Return the frequency of a leaf, or the maxFreq of an inner node
+ */
+unsigned int ArtTrie::maxFreqOf(uint32_t ref) const {
+    if (kindOf(ref) == LEAF) {
+        return leaves[indexOf(ref)].freq;
+    }
+    return header(ref).maxFreq;
+}
+
+/**
+ * Take a freed slot of the kind, or grow its pool by one
+ */
+uint32_t ArtTrie::allocate(Kind kind) {
+    if (!freeSlots[kind].empty()) {
+        uint32_t i = freeSlots[kind].back();
+        freeSlots[kind].pop_back();
+        return makeRef(kind, i);
+    }
+    switch (kind) {
+        case LEAF:
+            leaves.emplace_back();
+            return makeRef(kind, leaves.size() - 1);
+        case NODE4:
+            node4s.emplace_back();
+            return makeRef(kind, node4s.size() - 1);
+        case NODE16:
+            node16s.emplace_back();
+            return makeRef(kind, node16s.size() - 1);
+        case NODE48:
+            node48s.emplace_back();
+            return makeRef(kind, node48s.size() - 1);
+        default:
+            node256s.emplace_back();
+            return makeRef(kind, node256s.size() - 1);
+    }
+}
+
+/**
+ * Append word to words and return a leaf for it
+ */
+uint32_t ArtTrie::newLeaf(string_view word, unsigned int freq) {
+    uint32_t ref = allocate(LEAF);
+    leaves[indexOf(ref)] = Leaf{uint32_t(words.size()),
+                                uint32_t(word.length()), freq};
+    words += word;
+    return ref;
+}
+
+/**
+ * Return an empty Node4 skipping the given bytes
+ */
+uint32_t ArtTrie::newNode4(uint32_t prefixAt, uint32_t prefixLen) {
+    uint32_t ref = allocate(NODE4);
+    Node4& n = node4s[indexOf(ref)];
+    n.h = Header{prefixAt, prefixLen, NONE, 0, 0};
+    return ref;
+}
+
+/**
+ * Return the child of ref under byte c. A Node16 compares c with its
+ * sixteen keys in one SSE2 instruction and masks off the unused ones.
+ */
+uint32_t ArtTrie::findChild(uint32_t ref, uint8_t c) const {
+    uint32_t i = indexOf(ref);
+    switch (kindOf(ref)) {
+        case NODE4: {
+            const Node4& n = node4s[i];
+            for (unsigned int k = 0; k < n.h.count; k++) {
+                if (n.keys[k] == c) {
+                    return n.children[k];
+                }
+            }
+            return NONE;
+        }
+        case NODE16: {
+            const Node16& n = node16s[i];
+#ifdef __SSE2__
+            __m128i keys =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(n.keys));
+            __m128i equal = _mm_cmpeq_epi8(keys, _mm_set1_epi8(char(c)));
+            unsigned int mask =
+                _mm_movemask_epi8(equal) & ((1u << n.h.count) - 1);
+            return mask != 0 ? n.children[__builtin_ctz(mask)] : NONE;
+#else
+            for (unsigned int k = 0; k < n.h.count; k++) {
+                if (n.keys[k] == c) {
+                    return n.children[k];
+                }
+            }
+            return NONE;
+#endif
+        }
+        case NODE48: {
+            const Node48& n = node48s[i];
+            return n.slots[c] == NO_SLOT ? NONE : n.children[n.slots[c]];
+        }
+        default:
+            return node256s[i].children[c];
+    }
+}
+
+/**
+ * Insert (c, child) into the sorted keys and children of a Node4 or a
+ * Node16 that has room for it
+ */
+static void insertSorted(uint8_t* keys, uint32_t* children, uint16_t& count,
+                         uint8_t c, uint32_t child) {
+    unsigned int pos = 0;
+    while (pos < count && keys[pos] < c) {
+        pos++;
+    }
+    memmove(keys + pos + 1, keys + pos, count - pos);
+    memmove(children + pos + 1, children + pos,
+            (count - pos) * sizeof(uint32_t));
+    keys[pos] = c;
+    children[pos] = child;
+    count++;
+}
+
+/**
+ * Add a child, growing a full node into the next kind first. The old
+ * slot is freed, and allocate may move the pools, so nodes are looked
+ * up again after it.
+ */
+uint32_t ArtTrie::addChild(uint32_t ref, uint8_t c, uint32_t child) {
+    uint32_t i = indexOf(ref);
+    switch (kindOf(ref)) {
+        case NODE4: {
+            if (node4s[i].h.count < 4) {
+                Node4& n = node4s[i];
+                insertSorted(n.keys, n.children, n.h.count, c, child);
+                return ref;
+            }
+            uint32_t grown = allocate(NODE16);
+            Node16& g = node16s[indexOf(grown)];
+            const Node4& n = node4s[i];
+            g.h = n.h;
+            memcpy(g.keys, n.keys, sizeof(n.keys));
+            memcpy(g.children, n.children, sizeof(n.children));
+            insertSorted(g.keys, g.children, g.h.count, c, child);
+            release(ref);
+            return grown;
+        }
+        case NODE16: {
+            if (node16s[i].h.count < 16) {
+                Node16& n = node16s[i];
+                insertSorted(n.keys, n.children, n.h.count, c, child);
+                return ref;
+            }
+            uint32_t grown = allocate(NODE48);
+            Node48& g = node48s[indexOf(grown)];
+            const Node16& n = node16s[i];
+            g.h = n.h;
+            memset(g.slots, NO_SLOT, sizeof(g.slots));
+            fill(begin(g.children), end(g.children), NONE);
+            for (unsigned int k = 0; k < n.h.count; k++) {
+                g.slots[n.keys[k]] = k;
+                g.children[k] = n.children[k];
+            }
+            g.slots[c] = n.h.count;
+            g.children[n.h.count] = child;
+            g.h.count++;
+            release(ref);
+            return grown;
+        }
+        case NODE48: {
+            if (node48s[i].h.count < 48) {
+                Node48& n = node48s[i];
+                // removed children leave holes, so look for a free slot
+                uint8_t slot = 0;
+                while (n.children[slot] != NONE) {
+                    slot++;
+                }
+                n.slots[c] = slot;
+                n.children[slot] = child;
+                n.h.count++;
+                return ref;
+            }
+            uint32_t grown = allocate(NODE256);
+            Node256& g = node256s[indexOf(grown)];
+            const Node48& n = node48s[i];
+            g.h = n.h;
+            fill(begin(g.children), end(g.children), NONE);
+            for (unsigned int b = 0; b < 256; b++) {
+                if (n.slots[b] != NO_SLOT) {
+                    g.children[b] = n.children[n.slots[b]];
+                }
+            }
+            g.children[c] = child;
+            g.h.count++;
+            release(ref);
+            return grown;
+        }
+        default: {
+            Node256& n = node256s[i];
+            n.children[c] = child;
+            n.h.count++;
+            return ref;
+        }
+    }
+}
+
+/**
+ * Replace the child under c, which must exist
+ */
+void ArtTrie::setChild(uint32_t ref, uint8_t c, uint32_t child) {
+    uint32_t i = indexOf(ref);
+    switch (kindOf(ref)) {
+        case NODE4: {
+            Node4& n = node4s[i];
+            size_t pos = std::find(n.keys, n.keys + n.h.count, c) - n.keys;
+            n.children[pos] = child;
+            return;
+        }
+        case NODE16: {
+            Node16& n = node16s[i];
+            size_t pos = std::find(n.keys, n.keys + n.h.count, c) - n.keys;
+            n.children[pos] = child;
+            return;
+        }
+        case NODE48: {
+            Node48& n = node48s[i];
+            n.children[n.slots[c]] = child;
+            return;
+        }
+        default:
+            node256s[i].children[c] = child;
+    }
+}
+
+/**
+ * Remove the child under c, which must exist. Nodes never shrink into
+ * a smaller kind.
+ */
+void ArtTrie::removeChild(uint32_t ref, uint8_t c) {
+    uint32_t i = indexOf(ref);
+    switch (kindOf(ref)) {
+        case NODE4:
+        case NODE16: {
+            uint8_t* keys;
+            uint32_t* children;
+            uint16_t* count;
+            if (kindOf(ref) == NODE4) {
+                Node4& n = node4s[i];
+                keys = n.keys;
+                children = n.children;
+                count = &n.h.count;
+            } else {
+                Node16& n = node16s[i];
+                keys = n.keys;
+                children = n.children;
+                count = &n.h.count;
+            }
+            unsigned int pos = std::find(keys, keys + *count, c) - keys;
+            memmove(keys + pos, keys + pos + 1, *count - pos - 1);
+            memmove(children + pos, children + pos + 1,
+                    (*count - pos - 1) * sizeof(uint32_t));
+            (*count)--;
+            return;
+        }
+        case NODE48: {
+            Node48& n = node48s[i];
+            n.children[n.slots[c]] = NONE;
+            n.slots[c] = NO_SLOT;
+            n.h.count--;
+            return;
+        }
+        default: {
+            Node256& n = node256s[i];
+            n.children[c] = NONE;
+            n.h.count--;
+        }
+    }
+}
+
+/**
+ * Call f(byte, child) for every child of ref, by increasing byte
+ */
+template <typename F>
+void ArtTrie::forEachChild(uint32_t ref, F f) const {
+    uint32_t i = indexOf(ref);
+    switch (kindOf(ref)) {
+        case NODE4: {
+            const Node4& n = node4s[i];
+            for (unsigned int k = 0; k < n.h.count; k++) {
+                f(n.keys[k], n.children[k]);
+            }
+            return;
+        }
+        case NODE16: {
+            const Node16& n = node16s[i];
+            for (unsigned int k = 0; k < n.h.count; k++) {
+                f(n.keys[k], n.children[k]);
+            }
+            return;
+        }
+        case NODE48: {
+            const Node48& n = node48s[i];
+            for (unsigned int b = 0; b < 256; b++) {
+                if (n.slots[b] != NO_SLOT) {
+                    f(uint8_t(b), n.children[n.slots[b]]);
+                }
+            }
+            return;
+        }
+        default: {
+            const Node256& n = node256s[i];
+            for (unsigned int b = 0; b < 256; b++) {
+                if (n.children[b] != NONE) {
+                    f(uint8_t(b), n.children[b]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Recompute the maxFreq of an inner node from its value and children
+ */
+void ArtTrie::recomputeMaxFreq(uint32_t ref) {
+    unsigned int highest = 0;
+    uint32_t value = header(ref).value;
+    if (value != NONE) {
+        highest = leaves[indexOf(value)].freq;
+    }
+    forEachChild(ref, [&](uint8_t, uint32_t child) {
+        highest = max(highest, maxFreqOf(child));
+    });
+    header(ref).maxFreq = highest;
+}
+
+/**
+ * Given a string and an unsigned int, insert the word into the tree.
+ * Return false if the word is empty or already in the tree.
+ */
+bool ArtTrie::insert(string_view word, unsigned int freq,
+                     DictionaryTrie::SearchStats* stats) {
+    if (word.empty()) {
+        return false;
+    }
+    bool added = false;
+    size_t visited = 0;
+    root = insertAt(root, word, 0, freq, added, visited);
+    if (stats != nullptr) {
+        stats->nodesVisited += visited;
+    }
+    if (added) {
+        wordCount++;
+    }
+    return added;
+}
+
+/**
+ * Helper method for insert. A leaf that is reached is split into a
+ * Node4 over the bytes it shares with word, and so is an inner node
+ * whose skipped bytes differ from word. Nodes are held by reference
+ * across the calls that allocate, which may move the pools.
+ */
+uint32_t ArtTrie::insertAt(uint32_t ref, string_view word, size_t depth,
+                           unsigned int freq, bool& added, size_t& visited) {
+    if (ref == NONE) {
+        added = true;
+        return newLeaf(word, freq);
+    }
+    visited++;
+
+    if (kindOf(ref) == LEAF) {
+        Leaf& leaf = leaves[indexOf(ref)];
+        string_view other = wordOf(indexOf(ref));
+        if (other == word) {
+            // a word removed by setting its frequency to 0 comes back
+            if (leaf.freq == 0) {
+                leaf.freq = freq;
+                added = true;
+            }
+            return ref;
+        }
+        size_t shared = 0;
+        while (depth + shared < other.size() &&
+               depth + shared < word.size() &&
+               other[depth + shared] == word[depth + shared]) {
+            shared++;
+        }
+        uint32_t at = leaf.at + depth;
+        uint32_t node = newNode4(at, shared);
+        uint32_t fresh = newLeaf(word, freq);
+        size_t branch = depth + shared;
+        for (uint32_t l : {ref, fresh}) {
+            string_view w = wordOf(indexOf(l));
+            if (w.size() == branch) {
+                node4s[indexOf(node)].h.value = l;
+            } else {
+                node = addChild(node, w[branch], l);
+            }
+        }
+        header(node).maxFreq = max(maxFreqOf(ref), freq);
+        added = true;
+        return node;
+    }
+
+    Header& h = header(ref);
+    uint32_t prefixAt = h.prefixAt;
+    uint32_t prefixLen = h.prefixLen;
+    size_t matched = 0;
+    while (matched < prefixLen && depth + matched < word.size() &&
+           words[prefixAt + matched] == word[depth + matched]) {
+        matched++;
+    }
+    if (matched < prefixLen) {
+        // word leaves the skipped bytes: a new Node4 takes the bytes
+        // before the difference, and ref keeps the ones after
+        uint32_t node = newNode4(prefixAt, matched);
+        Header& old = header(ref);
+        old.prefixAt = prefixAt + matched + 1;
+        old.prefixLen = prefixLen - matched - 1;
+        unsigned int oldMax = old.maxFreq;
+        node = addChild(node, words[prefixAt + matched], ref);
+        size_t branch = depth + matched;
+        uint32_t fresh = newLeaf(word, freq);
+        if (word.size() == branch) {
+            header(node).value = fresh;
+        } else {
+            node = addChild(node, word[branch], fresh);
+        }
+        header(node).maxFreq = max(oldMax, freq);
+        added = true;
+        return node;
+    }
+
+    size_t branch = depth + prefixLen;
+    if (word.size() == branch) {
+        uint32_t value = h.value;
+        if (value == NONE) {
+            uint32_t fresh = newLeaf(word, freq);
+            header(ref).value = fresh;
+            added = true;
+        } else if (leaves[indexOf(value)].freq == 0) {
+            leaves[indexOf(value)].freq = freq;
+            added = true;
+        }
+    } else {
+        uint8_t c = word[branch];
+        uint32_t child = findChild(ref, c);
+        if (child == NONE) {
+            ref = addChild(ref, c, newLeaf(word, freq));
+            added = true;
+        } else {
+            uint32_t updated =
+                insertAt(child, word, branch + 1, freq, added, visited);
+            if (updated != child) {
+                setChild(ref, c, updated);
+            }
+        }
+    }
+    if (added) {
+        Header& after = header(ref);
+        after.maxFreq = max(after.maxFreq, freq);
+    }
+    return ref;
+}
+
+/**
+ * Helper method for find and frequency. Follow word down to the leaf
+ * that holds it, if any.
+ */
+uint32_t ArtTrie::findLeaf(string_view word, size_t& visited) const {
+    uint32_t ref = root;
+    size_t depth = 0;
+    while (ref != NONE && !word.empty()) {
+        visited++;
+        if (kindOf(ref) == LEAF) {
+            return wordOf(indexOf(ref)) == word ? indexOf(ref) : NONE;
+        }
+        const Header& h = header(ref);
+        if (word.size() - depth < h.prefixLen ||
+            word.compare(depth, h.prefixLen, words, h.prefixAt,
+                         h.prefixLen) != 0) {
+            return NONE;
+        }
+        depth += h.prefixLen;
+        if (depth == word.size()) {
+            return h.value == NONE ? NONE : indexOf(h.value);
+        }
+        ref = findChild(ref, word[depth]);
+        depth++;
+    }
+    return NONE;
+}
+
+/**
+ * Given a string word, return true if it is in the tree
+ */
+bool ArtTrie::find(string_view word,
+                   DictionaryTrie::SearchStats* stats) const {
+    size_t visited = 0;
+    uint32_t leaf = findLeaf(word, visited);
+    if (stats != nullptr) {
+        stats->nodesVisited += visited;
+    }
+    return leaf != NONE && leaves[leaf].freq > 0;
+}
+
+/**
+ * Return the frequency of the leaf of word
+ */
+unsigned int ArtTrie::frequency(string_view word) const {
+    size_t visited = 0;
+    uint32_t leaf = findLeaf(word, visited);
+    return leaf == NONE ? 0 : leaves[leaf].freq;
+}
+
+/**
+ * Set the frequency of word, removing it if freq is 0, and recompute
+ * the maxFreq of the nodes on its path
+ */
+bool ArtTrie::updateFrequency(string_view word, unsigned int freq) {
+    if (word.empty() || root == NONE) {
+        return false;
+    }
+    bool found = false;
+    root = updateAt(root, word, 0, freq, found);
+    if (found && freq == 0) {
+        wordCount--;
+    }
+    return found;
+}
+
+/**
+ * Remove word from the tree
+ */
+bool ArtTrie::remove(string_view word) { return updateFrequency(word, 0); }
+
+/**
+ * Helper method for updateFrequency. A removed word frees its leaf,
+ * and an inner node left with neither a value nor children is freed
+ * as well.
+ */
+uint32_t ArtTrie::updateAt(uint32_t ref, string_view word, size_t depth,
+                           unsigned int freq, bool& found) {
+    if (kindOf(ref) == LEAF) {
+        Leaf& leaf = leaves[indexOf(ref)];
+        if (leaf.freq == 0 || wordOf(indexOf(ref)) != word) {
+            return ref;
+        }
+        found = true;
+        if (freq == 0) {
+            release(ref);
+            return NONE;
+        }
+        leaf.freq = freq;
+        return ref;
+    }
+
+    const Header& h = header(ref);
+    if (word.size() - depth < h.prefixLen ||
+        word.compare(depth, h.prefixLen, words, h.prefixAt, h.prefixLen) !=
+            0) {
+        return ref;
+    }
+    size_t branch = depth + h.prefixLen;
+    if (word.size() == branch) {
+        uint32_t value = h.value;
+        if (value == NONE) {
+            return ref;
+        }
+        uint32_t updated = updateAt(value, word, depth, freq, found);
+        header(ref).value = updated;
+    } else {
+        uint8_t c = word[branch];
+        uint32_t child = findChild(ref, c);
+        if (child == NONE) {
+            return ref;
+        }
+        uint32_t updated = updateAt(child, word, branch + 1, freq, found);
+        if (updated == NONE) {
+            removeChild(ref, c);
+        } else if (updated != child) {
+            setChild(ref, c, updated);
+        }
+    }
+    if (!found) {
+        return ref;
+    }
+    Header& after = header(ref);
+    if (after.value == NONE && after.count == 0) {
+        release(ref);
+        return NONE;
+    }
+    recomputeMaxFreq(ref);
+    return ref;
+}
+
+/**
+ * Return true if bytes, which start at position depth of a word, match
+ * pattern from depth on
+ */
+bool ArtTrie::matchesPattern(string_view bytes, const string& pattern,
+                             size_t depth) const {
+    if (pattern.size() - depth < bytes.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < bytes.size(); i++) {
+        char p = pattern[depth + i];
+        if (p == '_' ? !DictionaryTrie::matchesUnderscore(bytes[i])
+                     : p != bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * predictCompletions writing into out
+ * The walk down to the prefix ends at the first node whose words all
+ * start with it, then the subtree is searched depth first. The top-k
+ * heap holds frequencies and leaves, and words of equal frequency are
+ * compared where they lie in the word string.
+ */
+size_t ArtTrie::predictCompletions(const string& prefix,
+                                   unsigned int numCompletions,
+                                   DictionaryTrie::SearchScratch& scratch,
+                                   vector<string>& out,
+                                   DictionaryTrie::SearchStats* stats) const {
+    if (prefix.empty() || numCompletions == 0) {
+        return 0;
+    }
+    size_t visited = 0;
+    uint32_t ref = root;
+    size_t depth = 0;
+    while (ref != NONE && depth < prefix.size()) {
+        visited++;
+        if (kindOf(ref) == LEAF) {
+            if (wordOf(indexOf(ref)).substr(0, prefix.size()) != prefix) {
+                ref = NONE;
+            }
+            break;
+        }
+        const Header& h = header(ref);
+        size_t n = min<size_t>(h.prefixLen, prefix.size() - depth);
+        if (prefix.compare(depth, n, words, h.prefixAt, n) != 0) {
+            ref = NONE;
+            break;
+        }
+        depth += n;
+        if (depth == prefix.size()) {
+            break;
+        }
+        ref = findChild(ref, prefix[depth]);
+        depth++;
+    }
+    if (ref == NONE) {
+        if (stats != nullptr) {
+            stats->nodesVisited += visited;
+        }
+        return 0;
+    }
+
+    using Candidate = DictionaryTrie::Candidate;
+    Candidate local[DictionaryTrie::STACK_HEAP];
+    Candidate* heap = local;
+    if (numCompletions > DictionaryTrie::STACK_HEAP) {
+        // the heap never holds more than every word
+        scratch.heap.resize(min<size_t>(numCompletions, wordCount));
+        heap = scratch.heap.data();
+    }
+    size_t heapSize = 0;
+    auto better = [this](const Candidate& a, const Candidate& b) {
+        return a.freq > b.freq ||
+               (a.freq == b.freq && wordOf(a.rank) < wordOf(b.rank));
+    };
+    auto offer = [&](uint32_t leaf) {
+        Candidate c{leaves[indexOf(leaf)].freq, indexOf(leaf)};
+        if (c.freq == 0) {
+            return;
+        }
+        if (heapSize < numCompletions) {
+            heap[heapSize++] = c;
+            push_heap(heap, heap + heapSize, better);
+        } else if (better(c, heap[0])) {
+            pop_heap(heap, heap + heapSize, better);
+            heap[heapSize - 1] = c;
+            push_heap(heap, heap + heapSize, better);
+        }
+    };
+
+    vector<uint32_t>& traverseStack = scratch.refs;
+    traverseStack.clear();
+    traverseStack.push_back(ref);
+    while (!traverseStack.empty()) {
+        uint32_t curr = traverseStack.back();
+        traverseStack.pop_back();
+        visited++;
+        if (heapSize == numCompletions && maxFreqOf(curr) < heap[0].freq) {
+            continue;
+        }
+        if (kindOf(curr) == LEAF) {
+            offer(curr);
+            continue;
+        }
+        if (header(curr).value != NONE) {
+            offer(header(curr).value);
+        }
+        forEachChild(curr, [&](uint8_t, uint32_t child) {
+            traverseStack.push_back(child);
+        });
+    }
+    if (stats != nullptr) {
+        stats->nodesVisited += visited;
+    }
+
+    sort(heap, heap + heapSize, better);
+    if (out.size() < heapSize) {
+        out.resize(heapSize);
+    }
+    for (size_t i = 0; i < heapSize; i++) {
+        string_view word = wordOf(heap[i].rank);
+        out[i].assign(word.data(), word.size());
+    }
+    return heapSize;
+}
+
+/**
+ * predictUnderscores on the tree: the skipped bytes of a node are
+ * matched against the pattern one by one, a fixed character follows
+ * one child and a '_' every child it matches
+ */
+vector<string> ArtTrie::predictUnderscores(
+    const string& pattern, unsigned int numCompletions,
+    DictionaryTrie::SearchStats* stats) const {
+    vector<string> vecReturn;
+    if (numCompletions == 0 || pattern.empty() || root == NONE) {
+        return vecReturn;
+    }
+
+    vector<pair<string, int>> heap;
+    // DFS stack of (node, position in the pattern)
+    vector<pair<uint32_t, size_t>> traverseStack;
+    traverseStack.push_back(make_pair(root, 0));
+    size_t visited = 0;
+    while (!traverseStack.empty()) {
+        uint32_t ref = traverseStack.back().first;
+        size_t depth = traverseStack.back().second;
+        traverseStack.pop_back();
+        visited++;
+        if (heap.size() == numCompletions &&
+            (int)maxFreqOf(ref) < heap.front().second) {
+            continue;
+        }
+
+        if (kindOf(ref) == LEAF) {
+            string_view word = wordOf(indexOf(ref));
+            const Leaf& leaf = leaves[indexOf(ref)];
+            if (leaf.freq != 0 && word.size() == pattern.size() &&
+                matchesPattern(word.substr(depth), pattern, depth)) {
+                DictionaryTrie::pd_fixed(heap, numCompletions, string(word),
+                                         leaf.freq);
+            }
+            continue;
+        }
+        const Header& h = header(ref);
+        string_view skipped =
+            string_view(words).substr(h.prefixAt, h.prefixLen);
+        if (!matchesPattern(skipped, pattern, depth)) {
+            continue;
+        }
+        size_t branch = depth + h.prefixLen;
+        if (branch == pattern.size()) {
+            if (h.value != NONE && leaves[indexOf(h.value)].freq != 0) {
+                const Leaf& leaf = leaves[indexOf(h.value)];
+                DictionaryTrie::pd_fixed(heap, numCompletions,
+                                         string(wordOf(indexOf(h.value))),
+                                         leaf.freq);
+            }
+            continue;
+        }
+        char c = pattern[branch];
+        if (c != '_') {
+            uint32_t child = findChild(ref, c);
+            if (child != NONE) {
+                traverseStack.push_back(make_pair(child, branch + 1));
+            }
+            continue;
+        }
+        forEachChild(ref, [&](uint8_t b, uint32_t child) {
+            if (DictionaryTrie::matchesUnderscore(b)) {
+                traverseStack.push_back(make_pair(child, branch + 1));
+            }
+        });
+    }
+    if (stats != nullptr) {
+        stats->nodesVisited += visited;
+    }
+
+    // sort the heap from the best word to the worst
+    sort(heap.begin(), heap.end(), DictionaryTrie::compare());
+    for (pair<string, int>& element : heap) {
+        vecReturn.push_back(move(element.first));
+    }
+    return vecReturn;
+}
+
+/**
+ * predictFuzzy on the tree, with the rows of the Levenshtein table of
+ * DictionaryTrie::predictFuzzy kept per byte of depth. A node steps the
+ * row through its skipped bytes, and a leaf through the rest of its
+ * word. The row of a branch is shared by the children, each of which
+ * steps it by its own byte when it is taken off the stack, and a
+ * subtree only writes the rows below its branch.
+ */
+vector<string> ArtTrie::predictFuzzy(const string& prefix,
+                                     unsigned int maxEdits,
+                                     unsigned int numCompletions) const {
+    vector<string> vecReturn;
+    if (prefix.empty() || numCompletions == 0 || root == NONE) {
+        return vecReturn;
+    }
+
+    // one row of width + 1 entries per depth, entries above maxEdits
+    // are all stored as maxEdits + 1
+    const size_t width = prefix.size();
+    const unsigned int over = maxEdits + 1;
+    vector<unsigned int> rows(width + 1);
+    for (size_t j = 0; j <= width; j++) {
+        rows[j] = min<size_t>(j, over);
+    }
+
+    // Step the row at depth by byte c into the row at depth + 1 and go
+    // one byte down. Return false if no entry is within maxEdits, so
+    // no word below can match. A matched path needs no rows.
+    auto advance = [&](size_t& depth, char c, bool& matched) {
+        depth++;
+        if (matched) {
+            return true;
+        }
+        if (rows.size() < (depth + 1) * (width + 1)) {
+            rows.resize((depth + 1) * (width + 1));
+        }
+        const unsigned int* above = &rows[(depth - 1) * (width + 1)];
+        unsigned int* row = &rows[depth * (width + 1)];
+        row[0] = min<size_t>(depth, over);
+        unsigned int lowest = row[0];
+        for (size_t j = 1; j <= width; j++) {
+            unsigned int cost = above[j - 1] + (prefix[j - 1] != c);
+            cost = min(cost, min(above[j], row[j - 1]) + 1);
+            row[j] = min(cost, over);
+            lowest = min(lowest, row[j]);
+        }
+        matched = row[width] <= maxEdits;
+        return lowest <= maxEdits;
+    };
+
+    // DFS stack of nodes with the depth of the byte that leads to them,
+    // the byte, -1 for the root, and whether every word above them
+    // matches
+    struct Entry {
+        uint32_t ref;
+        size_t depth;
+        int byte;
+        bool matched;
+    };
+    vector<pair<string, int>> heap;
+    vector<Entry> traverseStack;
+    traverseStack.push_back(Entry{root, 0, -1, width <= maxEdits});
+    while (!traverseStack.empty()) {
+        Entry entry = traverseStack.back();
+        traverseStack.pop_back();
+        if (heap.size() == numCompletions &&
+            (int)maxFreqOf(entry.ref) < heap.front().second) {
+            continue;
+        }
+        size_t depth = entry.depth;
+        bool matched = entry.matched;
+        if (entry.byte >= 0 && !advance(depth, char(entry.byte), matched)) {
+            continue;
+        }
+
+        if (kindOf(entry.ref) == LEAF) {
+            const Leaf& leaf = leaves[indexOf(entry.ref)];
+            string_view word = wordOf(indexOf(entry.ref));
+            bool alive = true;
+            while (alive && !matched && depth < word.size()) {
+                alive = advance(depth, word[depth], matched);
+            }
+            if (matched && leaf.freq != 0) {
+                DictionaryTrie::pd_fixed(heap, numCompletions, string(word),
+                                         leaf.freq);
+            }
+            continue;
+        }
+        const Header& h = header(entry.ref);
+        bool alive = true;
+        for (uint32_t i = 0; alive && i < h.prefixLen; i++) {
+            alive = advance(depth, words[h.prefixAt + i], matched);
+        }
+        if (!alive) {
+            continue;
+        }
+        if (matched && h.value != NONE) {
+            const Leaf& leaf = leaves[indexOf(h.value)];
+            if (leaf.freq != 0) {
+                DictionaryTrie::pd_fixed(heap, numCompletions,
+                                         string(wordOf(indexOf(h.value))),
+                                         leaf.freq);
+            }
+        }
+        forEachChild(entry.ref, [&](uint8_t b, uint32_t child) {
+            traverseStack.push_back(Entry{child, depth, b, matched});
+        });
+    }
+
+    // sort the heap from the best word to the worst
+    sort(heap.begin(), heap.end(), DictionaryTrie::compare());
+    for (pair<string, int>& element : heap) {
+        vecReturn.push_back(move(element.first));
+    }
+    return vecReturn;
+}
+
+/**
+ * Walk the tree by increasing bytes, the value of a node before its
+ * children, which gives the words in alphabetical order. The places of
+ * the words in text are kept until text is complete, since text moves
+ * as it grows.
+ */
+vector<DictionaryTrie::Record> ArtTrie::listWords(string& text) const {
+    text.clear();
+    vector<uint32_t> places;
+    vector<uint32_t> traverseStack;
+    if (root != NONE) {
+        traverseStack.push_back(root);
+    }
+    while (!traverseStack.empty()) {
+        uint32_t ref = traverseStack.back();
+        traverseStack.pop_back();
+        uint32_t leaf = kindOf(ref) == LEAF ? indexOf(ref) : NONE;
+        if (kindOf(ref) != LEAF) {
+            if (header(ref).value != NONE) {
+                leaf = indexOf(header(ref).value);
+            }
+            // pushed backwards, so the smallest byte comes off first
+            size_t first = traverseStack.size();
+            forEachChild(ref, [&](uint8_t, uint32_t child) {
+                traverseStack.push_back(child);
+            });
+            reverse(traverseStack.begin() + first, traverseStack.end());
+        }
+        if (leaf != NONE && leaves[leaf].freq != 0) {
+            places.push_back(leaf);
+        }
+    }
+
+    size_t length = 0;
+    for (uint32_t leaf : places) {
+        length += leaves[leaf].length;
+    }
+    text.reserve(length);
+    for (uint32_t leaf : places) {
+        text += wordOf(leaf);
+    }
+    vector<DictionaryTrie::Record> records;
+    records.reserve(places.size());
+    size_t at = 0;
+    for (uint32_t leaf : places) {
+        records.push_back(DictionaryTrie::Record{
+            string_view(text).substr(at, leaves[leaf].length),
+            leaves[leaf].freq});
+        at += leaves[leaf].length;
+    }
+    return records;
+}
+
+/**
+ * Return the slots of the pools that are not free
+ */
+size_t ArtTrie::numNodes() const {
+    size_t count = leaves.size() + node4s.size() + node16s.size() +
+                   node48s.size() + node256s.size();
+    for (const vector<uint32_t>& slots : freeSlots) {
+        count -= slots.size();
+    }
+    return count;
+}
+
+/**
+ * Return the bytes reserved by the pools and the word string
+ */
+size_t ArtTrie::memoryUsage() const {
+    size_t bytes = words.capacity() + leaves.capacity() * sizeof(Leaf) +
+                   node4s.capacity() * sizeof(Node4) +
+                   node16s.capacity() * sizeof(Node16) +
+                   node48s.capacity() * sizeof(Node48) +
+                   node256s.capacity() * sizeof(Node256);
+    for (const vector<uint32_t>& slots : freeSlots) {
+        bytes += slots.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,240 @@
+/**
+ * This file defines an adaptive radix tree (ART) over the bytes of
+ * words, the engine a DictionaryTrie keeps its words in when it is
+ * constructed with DictionaryTrie::ART.
+ */
+#ifndef ART_TRIE_HPP
+#define ART_TRIE_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DictionaryTrie.hpp"
+
+using namespace std;
+
+/**
+ * A radix tree branching on one byte per inner node. An inner node is
+ * a Node4, Node16, Node48 or Node256 after the most children it can
+ * hold, and grows into the next kind when it is full, so a sparse node
+ * costs tens of bytes and a dense one finds its child with one load.
+ * Node16 compares the byte with all of its keys at once with SSE2.
+ *
+ * Paths are compressed: an inner node skips the bytes its words all
+ * share before they branch, and a word that is alone below a byte is a
+ * leaf right there. Every word is stored once, back to back in one
+ * string; a leaf is its place there and its frequency, and the skipped
+ * bytes of an inner node point into the same string. A word that ends
+ * where an inner node branches is the value of the node.
+ *
+ * Every inner node holds the highest frequency of the words below it,
+ * which the searches use to skip subtrees like highestFq of the TST.
+ * Nodes live in one pool per kind and link to each other by 32-bit
+ * references, the kind in the top bits and the index in the pool below.
+ */
+class ArtTrie {
+  public:
+    /* Create an empty tree */
+    ArtTrie();
+
+    /* Same as DictionaryTrie::insert */
+    bool insert(string_view word, unsigned int freq,
+                DictionaryTrie::SearchStats* stats = nullptr);
+
+    /* Same as DictionaryTrie::find */
+    bool find(string_view word,
+              DictionaryTrie::SearchStats* stats = nullptr) const;
+
+    /* Same as DictionaryTrie::frequency */
+    unsigned int frequency(string_view word) const;
+
+    /* Same as DictionaryTrie::updateFrequency */
+    bool updateFrequency(string_view word, unsigned int freq);
+
+    /**
+     * Same as DictionaryTrie::remove. A node left without words is
+     * freed, but a node left with one child is not merged into it, and
+     * the bytes of the word stay in the word string.
+     */
+    bool remove(string_view word);
+
+    /* Same as the output buffer overload of
+     * DictionaryTrie::predictCompletions */
+    size_t predictCompletions(const string& prefix,
+                              unsigned int numCompletions,
+                              DictionaryTrie::SearchScratch& scratch,
+                              vector<string>& out,
+                              DictionaryTrie::SearchStats* stats) const;
+
+    /* Same as DictionaryTrie::predictUnderscores */
+    vector<string> predictUnderscores(
+        const string& pattern, unsigned int numCompletions,
+        DictionaryTrie::SearchStats* stats = nullptr) const;
+
+    /* Same as DictionaryTrie::predictFuzzy */
+    vector<string> predictFuzzy(const string& prefix, unsigned int maxEdits,
+                                unsigned int numCompletions) const;
+
+    /* Same as DictionaryTrie::listWords */
+    vector<DictionaryTrie::Record> listWords(string& text) const;
+
+    /* Return the number of words */
+    size_t numWords() const { return wordCount; }
+
+    /* Return the number of inner nodes and leaves in use */
+    size_t numNodes() const;
+
+    /* Return the number of heap bytes reserved by the nodes, the leaves
+     * and the words */
+    size_t memoryUsage() const;
+
+  private:
+    // a reference to no node
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    // the kind of a node, kept in the top bits of its references
+    enum Kind { LEAF = 0, NODE4 = 1, NODE16 = 2, NODE48 = 3, NODE256 = 4 };
+    static const uint32_t KIND_SHIFT = 29;
+    static const uint32_t INDEX_MASK = (1u << KIND_SHIFT) - 1;
+
+    // index of a Node48 for a byte that has no child
+    static const uint8_t NO_SLOT = 0xFF;
+
+    /* A word, at words[at, at + length) */
+    struct Leaf {
+        uint32_t at;
+        uint32_t length;
+        unsigned int freq;
+    };
+
+    /* The part of every inner node before its children */
+    struct Header {
+        // the skipped bytes are words[prefixAt, prefixAt + prefixLen)
+        uint32_t prefixAt;
+        uint32_t prefixLen;
+        // the leaf of the word ending at the branch, or NONE
+        uint32_t value;
+        // the highest frequency of the words below the node
+        unsigned int maxFreq;
+        uint16_t count;
+    };
+
+    // Node4 and Node16 keep their keys sorted, with the children at
+    // the same positions. Node48 maps every byte to one of its child
+    // slots, Node256 holds a child for every byte.
+    struct Node4 {
+        Header h;
+        uint8_t keys[4];
+        uint32_t children[4];
+    };
+    struct Node16 {
+        Header h;
+        uint8_t keys[16];
+        uint32_t children[16];
+    };
+    struct Node48 {
+        Header h;
+        uint8_t slots[256];
+        uint32_t children[48];
+    };
+    struct Node256 {
+        Header h;
+        uint32_t children[256];
+    };
+
+    // every inserted word, back to back
+    string words;
+
+    // the node pools, and the slots freed in each of them
+    vector<Leaf> leaves;
+    vector<Node4> node4s;
+    vector<Node16> node16s;
+    vector<Node48> node48s;
+    vector<Node256> node256s;
+    vector<uint32_t> freeSlots[5];
+
+    uint32_t root;
+    size_t wordCount;
+
+    static Kind kindOf(uint32_t ref) { return Kind(ref >> KIND_SHIFT); }
+    static uint32_t indexOf(uint32_t ref) { return ref & INDEX_MASK; }
+    static uint32_t makeRef(Kind kind, uint32_t index) {
+        return (uint32_t(kind) << KIND_SHIFT) | index;
+    }
+
+    /* Return the bytes of the word of a leaf */
+    string_view wordOf(uint32_t leaf) const {
+        return string_view(words).substr(leaves[leaf].at,
+                                         leaves[leaf].length);
+    }
+
+    /* Return the header of an inner node */
+    Header& header(uint32_t ref);
+    const Header& header(uint32_t ref) const;
+
+    /* Return the highest frequency of a word at or below ref */
+    unsigned int maxFreqOf(uint32_t ref) const;
+
+    /* Take a slot of the given kind, reusing a freed one if there is
+     * one, and return its reference. The pool may move. */
+    uint32_t allocate(Kind kind);
+
+    /* Free the slot of ref */
+    void release(uint32_t ref) {
+        freeSlots[kindOf(ref)].push_back(indexOf(ref));
+    }
+
+    /* Return a new leaf for word with freq, copying word to words */
+    uint32_t newLeaf(string_view word, unsigned int freq);
+
+    /* Return a new Node4 skipping words[prefixAt, prefixAt + len) */
+    uint32_t newNode4(uint32_t prefixAt, uint32_t prefixLen);
+
+    /* Return the child of ref under byte c, or NONE */
+    uint32_t findChild(uint32_t ref, uint8_t c) const;
+
+    /* Add child under byte c, which ref has no child for, and return
+     * the reference of the node, which is new if ref had to grow */
+    uint32_t addChild(uint32_t ref, uint8_t c, uint32_t child);
+
+    /* Replace the child of ref under byte c */
+    void setChild(uint32_t ref, uint8_t c, uint32_t child);
+
+    /* Remove the child of ref under byte c */
+    void removeChild(uint32_t ref, uint8_t c);
+
+    /* Call f(byte, child) for every child of ref, by increasing byte */
+    template <typename F>
+    void forEachChild(uint32_t ref, F f) const;
+
+    /* Recompute the maxFreq of an inner node from its value and its
+     * children */
+    void recomputeMaxFreq(uint32_t ref);
+
+    /**
+     * Insert the leaf for word into the subtree ref, whose bytes before
+     * depth match word, and return the new reference of the subtree.
+     * added is set if the word was not there before.
+     */
+    uint32_t insertAt(uint32_t ref, string_view word, size_t depth,
+                      unsigned int freq, bool& added, size_t& visited);
+
+    /**
+     * Set the frequency of word in the subtree ref to freq, or remove
+     * it if freq is 0, and return the new reference of the subtree,
+     * NONE if it holds no word anymore. found is set if word is there.
+     */
+    uint32_t updateAt(uint32_t ref, string_view word, size_t depth,
+                      unsigned int freq, bool& found);
+
+    /* Return the leaf holding word, or NONE, counting the nodes looked
+     * at in visited */
+    uint32_t findLeaf(string_view word, size_t& visited) const;
+
+    /* Return true if the bytes of ref from depth on match pattern */
+    bool matchesPattern(string_view bytes, const string& pattern,
+                        size_t depth) const;
+};
+
+#endif  // ART_TRIE_HPP
@@ -0,0 +1,273 @@
+/**
+ * This file implements the autocomplete server declared in
+ * AutocompleteServer.hpp.
+ */
+#include "AutocompleteServer.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+/**
+ * Write all of data to fd, returning false if the reader is gone. A
+ * socket is written with MSG_NOSIGNAL, so a client that went away
+ * fails the write instead of raising SIGPIPE; any other file is written
+ * with write.
+ */
+static bool writeAll(int fd, const string& data) {
+    size_t done = 0;
+    bool isSocket = true;
+    while (done < data.size()) {
+        ssize_t n;
+        if (isSocket) {
+            n = send(fd, data.data() + done, data.size() - done,
+                     MSG_NOSIGNAL);
+            if (n < 0 && errno == ENOTSOCK) {
+                isSocket = false;
+                continue;
+            }
+        } else {
+            n = write(fd, data.data() + done, data.size() - done);
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+/**
+ * Start the pool and give every worker its SearchScratch
+ */
+AutocompleteServer::AutocompleteServer(const DictionaryTrie& trie,
+                                       unsigned int numThreads,
+                                       size_t maxBatch)
+    : trie(trie), maxBatch(max<size_t>(1, maxBatch)), pool(numThreads) {
+    scratch.resize(pool.size());
+}
+
+/**
+ * Helper method for serve. A request is digits, one space and a query
+ * that is not empty; a '\r' ending the line is dropped.
+ */
+void AutocompleteServer::parse(string_view line, Request& request) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    request.error.clear();
+    request.query.clear();
+    size_t pos = 0;
+    unsigned long long numCompletions = 0;
+    while (pos < line.size() && line[pos] >= '0' && line[pos] <= '9') {
+        if (numCompletions <= MAX_COMPLETIONS) {
+            numCompletions = numCompletions * 10 + (line[pos] - '0');
+        }
+        pos++;
+    }
+    if (pos == 0 || pos == line.size() || line[pos] != ' ') {
+        request.error = "expected <k> <query>";
+        return;
+    }
+    if (numCompletions > MAX_COMPLETIONS) {
+        request.error = "k above " + to_string(MAX_COMPLETIONS);
+        return;
+    }
+    if (pos + 1 == line.size()) {
+        request.error = "empty query";
+        return;
+    }
+    request.numCompletions = numCompletions;
+    request.query.assign(line.substr(pos + 1));
+}
+
+/**
+ * Helper method for serve. The workers write into the answer buffers
+ * of their requests, then the responses are formatted in order.
+ */
+void AutocompleteServer::answer(const vector<Request>& batch, size_t count,
+                                vector<vector<string>>& answers,
+                                vector<size_t>& sizes, string& response) {
+    {
+        lock_guard<mutex> guard(poolLock);
+        pool.run(count, [&](size_t i, unsigned int worker) {
+            const Request& request = batch[i];
+            sizes[i] = 0;
+            if (!request.error.empty()) {
+                return;
+            }
+            if (request.query.find('_') != string::npos) {
+                answers[i] = trie.predictUnderscores(request.query,
+                                                     request.numCompletions);
+                sizes[i] = answers[i].size();
+            } else {
+                sizes[i] = trie.predictCompletions(
+                    request.query, request.numCompletions, scratch[worker],
+                    answers[i]);
+            }
+        });
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!batch[i].error.empty()) {
+            response += "ERR ";
+            response += batch[i].error;
+            response += '\n';
+            continue;
+        }
+        response += to_string(sizes[i]);
+        response += '\n';
+        for (size_t j = 0; j < sizes[i]; j++) {
+            response += answers[i][j];
+            response += '\n';
+        }
+    }
+}
+
+/**
+ * Read as much as has arrived, answer the complete lines in batches of
+ * up to maxBatch and keep a partial line for the next read. A last
+ * line without a newline is answered at the end of the input. A line
+ * longer than MAX_LINE is answered with an error as soon as that is
+ * known, and the rest of it is dropped as it arrives, so the partial
+ * line kept, and scanned again on the next read, stays short.
+ */
+size_t AutocompleteServer::serve(int inFd, int outFd) {
+    const size_t CHUNK = 1 << 16;
+    vector<char> chunk(CHUNK);
+    string input;
+    string response;
+    vector<Request> batch(maxBatch);
+    vector<vector<string>> answers(maxBatch);
+    vector<size_t> sizes(maxBatch);
+    size_t answered = 0;
+    bool done = false;
+    // true while the rest of a line too long is dropped
+    bool discarding = false;
+    while (!done) {
+        ssize_t n = read(inFd, chunk.data(), CHUNK);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            done = true;
+            if (!input.empty() && input.back() != '\n') {
+                input += '\n';
+            }
+        } else {
+            input.append(chunk.data(), n);
+        }
+
+        size_t start = 0;
+        while (true) {
+            size_t count = 0;
+            while (count < maxBatch) {
+                size_t end = input.find('\n', start);
+                if (discarding) {
+                    start = end == string::npos ? input.size() : end + 1;
+                    discarding = end == string::npos;
+                    if (discarding) {
+                        break;
+                    }
+                    continue;
+                }
+                if (end == string::npos) {
+                    if (input.size() - start > MAX_LINE) {
+                        batch[count++].error = "line too long";
+                        start = input.size();
+                        discarding = true;
+                    }
+                    break;
+                }
+                if (end - start > MAX_LINE) {
+                    batch[count].error = "line too long";
+                } else {
+                    parse(string_view(input).substr(start, end - start),
+                          batch[count]);
+                }
+                start = end + 1;
+                count++;
+            }
+            if (count == 0) {
+                break;
+            }
+            response.clear();
+            answer(batch, count, answers, sizes, response);
+            if (!writeAll(outFd, response)) {
+                return answered;
+            }
+            answered += count;
+        }
+        input.erase(0, start);
+    }
+    return answered;
+}
+
+/**
+ * The connection threads are counted, and the server waits for the
+ * count to drop to 0 before it returns, so no thread outlives it.
+ */
+bool AutocompleteServer::listenUnix(const string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    sockaddr* address = reinterpret_cast<sockaddr*>(&addr);
+    if (bind(listener, address, sizeof(addr)) < 0 ||
+        listen(listener, SOMAXCONN) < 0) {
+        close(listener);
+        return false;
+    }
+    mutex connLock;
+    condition_variable idle;
+    size_t connections = 0;
+    auto finish = [&]() {
+        lock_guard<mutex> guard(connLock);
+        if (--connections == 0) {
+            idle.notify_all();
+        }
+    };
+    while (true) {
+        int conn = accept(listener, nullptr, nullptr);
+        if (conn < 0 && errno == EINTR) {
+            continue;
+        }
+        if (conn < 0) {
+            break;
+        }
+        {
+            lock_guard<mutex> guard(connLock);
+            connections++;
+        }
+        try {
+            thread([this, conn, &finish]() {
+                serve(conn, conn);
+                close(conn);
+                finish();
+            }).detach();
+        } catch (const system_error&) {
+            close(conn);
+            finish();
+        }
+    }
+    close(listener);
+    unique_lock<mutex> guard(connLock);
+    idle.wait(guard, [&]() { return connections == 0; });
+    return true;
+}
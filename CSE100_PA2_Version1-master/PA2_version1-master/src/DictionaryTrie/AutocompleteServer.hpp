@@ -0,0 +1,94 @@
+/**
+ * This file defines a server answering autocomplete requests from a
+ * loaded DictionaryTrie over a file descriptor or a Unix domain socket.
+ */
+#ifndef AUTOCOMPLETE_SERVER_HPP
+#define AUTOCOMPLETE_SERVER_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DictionaryTrie.hpp"
+#include "ThreadPool.hpp"
+
+using namespace std;
+
+/**
+ * Answers requests of one line each:
+ *
+ *   <k> <query>
+ *
+ * with the k most frequent completions of query, from
+ * predictUnderscores if query holds a '_' and from predictCompletions
+ * otherwise. The query is the rest of the line and may hold spaces. The
+ * response is a line with the number of words followed by one line per
+ * word, or one line starting with "ERR " for a request that cannot be
+ * parsed, so a client reads responses in the order of its requests.
+ *
+ * Clients may pipeline: every request that has arrived when the server
+ * reads is answered in one batch by the workers of a ThreadPool, each
+ * with its own SearchScratch, and the responses of the batch go back
+ * in one write. The trie must not change while the server runs.
+ */
+class AutocompleteServer {
+  public:
+    // largest k a request may ask for
+    static const unsigned int MAX_COMPLETIONS = 1000;
+
+    // longest request line, without its newline
+    static const size_t MAX_LINE = 4096;
+
+    /* Serve trie with numThreads workers, one per hardware thread if it
+     * is 0, answering at most maxBatch requests per batch */
+    AutocompleteServer(const DictionaryTrie& trie,
+                       unsigned int numThreads = 0, size_t maxBatch = 256);
+
+    AutocompleteServer(const AutocompleteServer&) = delete;
+    AutocompleteServer& operator=(const AutocompleteServer&) = delete;
+
+    /**
+     * Answer the requests read from inFd on outFd until the end of the
+     * input, and return the number of requests answered. Several
+     * threads may serve at once; their batches take turns on the pool.
+     * A line longer than MAX_LINE gets an "ERR line too long" response.
+     */
+    size_t serve(int inFd, int outFd);
+
+    /**
+     * Listen on a Unix domain socket at path, replacing any file there,
+     * and serve every connection on a thread of its own. Return false
+     * if the socket cannot be set up; otherwise only return when accept
+     * fails and every connection has been served. A client that goes
+     * away fails its writes without a SIGPIPE.
+     */
+    bool listenUnix(const string& path);
+
+  private:
+    /* A parsed request; a request with an error gets no answer */
+    struct Request {
+        unsigned int numCompletions;
+        string query;
+        string error;
+    };
+
+    const DictionaryTrie& trie;
+    size_t maxBatch;
+
+    // guards pool and scratch, which one batch uses at a time
+    mutex poolLock;
+    ThreadPool pool;
+    vector<DictionaryTrie::SearchScratch> scratch;
+
+    /* Parse one request line into request */
+    static void parse(string_view line, Request& request);
+
+    /* Answer batch[0, count) on the pool and append the responses to
+     * response. answers is a buffer per request. */
+    void answer(const vector<Request>& batch, size_t count,
+                vector<vector<string>>& answers, vector<size_t>& sizes,
+                string& response);
+};
+
+#endif  // AUTOCOMPLETE_SERVER_HPP
@@ -7,311 +7,652 @@
  * useful methods which can be processed on a TST object.
  */
 #include "DictionaryTrie.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <queue>
-#include <stack>
 #include <vector>
+#include "ArtTrie.hpp"
+
+const uint32_t DictionaryTrie::NIL;
+const unsigned int DictionaryTrie::NO_CACHE;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'D', 'I', 'C', 'T', 'T', 'S', 'T', '\0'};
+
+/* The start of a snapshot file, followed by the node pool */
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeSize;
+    uint64_t numNodes;
+    uint64_t numFree;
+    uint32_t root;
+    uint32_t freeList;
+};
+
+/* Read exactly size bytes from fd into data */
+bool readAll(int fd, void* data, size_t size) {
+    char* at = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, at, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        at += n;
+        size -= n;
+    }
+    return true;
+}
+
+}  // namespace
 
 // Construtor for a TrieNode object
 DictionaryTrie::TrieNode::TrieNode(char c) : data(c) {
-    left = middle = right = nullptr;  // child nodes
+    left = middle = right = NIL;  // child nodes
     freq = 0;
-    highestFq = 0;    // highest frequency in the subtree whose root is the node
-    visited = false;  // check whether a node is visited
-    notmd = false;
-    md = false;
-    layer = -1;  // the position this node could only be placed
+    highestFq = 0;  // highest frequency in the subtree whose root is the node
+    cacheSlot = NO_CACHE;
+    memset(pad, 0, sizeof(pad));
 }
 
+static_assert(sizeof(DictionaryTrie::TrieNode) == 28,
+              "a TrieNode has padding that is not zeroed");
+
 /**
- * A constructor that only sets root to nullptr
+ * A constructor that only sets root to NIL
  */
 
-DictionaryTrie::DictionaryTrie() { this->root = nullptr; }
+DictionaryTrie::DictionaryTrie(Engine engine)
+    : root(NIL),
+      walkOrder(DEPTH_FIRST),
+      freeList(NIL),
+      numFree(0),
+      cacheSize(0) {
+    if (engine == ART) {
+        art.reset(new ArtTrie());
+    }
+}
+
+// defined here, where ArtTrie is complete
+DictionaryTrie::~DictionaryTrie() = default;
+DictionaryTrie::DictionaryTrie(DictionaryTrie&& other) noexcept = default;
+DictionaryTrie& DictionaryTrie::operator=(DictionaryTrie&& other) noexcept =
+    default;
+
+/**
+ * Return the nodes of the pool that are not on the free list, or the
+ * nodes of the ArtTrie
+ */
+size_t DictionaryTrie::numNodes() const {
+    if (art) {
+        return art->numNodes();
+    }
+    return nodes.size() - numFree;
+}
+
+/**
+ * Return the bytes of the node pool, or of the ArtTrie
+ */
+size_t DictionaryTrie::nodeMemory() const {
+    if (art) {
+        return art->memoryUsage();
+    }
+    return nodes.capacity() * sizeof(TrieNode);
+}
+
+/**
+ * Helper method for insert. Reuse a removed slot if there is one, so a
+ * TST that keeps changing does not grow its pool.
+ */
+uint32_t DictionaryTrie::newNode(char c) {
+    if (freeList != NIL) {
+        uint32_t n = freeList;
+        freeList = nodes[n].middle;
+        numFree--;
+        nodes[n] = TrieNode(c);
+        return n;
+    }
+    nodes.push_back(TrieNode(c));
+    return nodes.size() - 1;
+}
 
 /**
  * Given a string and an unsigned int
  * Insert a copy of the string in the TST
  * Return true if the item was successfully added to this TST,
  * false if the call does not input any word into this TST.
+ * Every node on the path gets the new word under it, so the highestFq
+ * of each of them is raised to freq if it was lower.
  */
-bool DictionaryTrie::insert(string word, unsigned int freq) {
+bool DictionaryTrie::insert(string_view word, unsigned int freq,
+                            SearchStats* stats) {
     if (word.length() == 0) {  // the word is invalid
         return false;
     }
-
-    if (this->root == nullptr) {  // the TST is empty
-        this->root = new TrieNode(word[0]);
-        this->root->md = true;
-        this->root->layer = 0;
+    if (art) {
+        if (!art->insert(word, freq, stats)) {
+            return false;
+        }
+        wordChanged(word);
+        return true;
     }
+    SearchStats unused;
+    SearchStats& counts = stats != nullptr ? *stats : unused;
 
-    // store the word in a vector
-    vector<char> vec;
-    for (int i = 0; i < word.length(); i++) {
-        vec.push_back(word[i]);
+    if (this->root == NIL) {  // the TST is empty
+        this->root = newNode(word[0]);
     }
 
     // insert the word
-    int index = 0;
-    TrieNode* curr = this->root;     // traverse the TST through root
+    // newNode may move the pool, so nodes are held by index and a new
+    // child is linked only after newNode returns
+    size_t index = 0;
+    uint32_t curr = this->root;      // traverse the TST through root
     while (index < word.length()) {  // has not been to the end of the word
-        if (vec.at(index) < curr->data) {  // might be on the left
-            if (curr->left == nullptr) {   // insert the character
-                curr->left = new TrieNode(word[index]);
-                curr->left->notmd = true;
-                curr->left->layer = curr->layer;
+        counts.nodesVisited++;
+        if (charLess(word[index], nodes[curr].data)) {  // on the left
+            if (nodes[curr].left == NIL) {              // insert the character
+                uint32_t child = newNode(word[index]);
+                nodes[curr].left = child;
             }
-            curr = curr->left;
-        } else if (vec.at(index) > curr->data) {  // might be on the right
-            if (curr->right == nullptr) {         // insert the character
-                curr->right = new TrieNode(word[index]);
-                curr->right->notmd = true;
-                curr->right->layer = curr->layer;
+            curr = nodes[curr].left;
+        } else if (charLess(nodes[curr].data, word[index])) {  // on the right
+            if (nodes[curr].right == NIL) {                    // insert it
+                uint32_t child = newNode(word[index]);
+                nodes[curr].right = child;
             }
-            curr = curr->right;
-        } else if (vec.at(index) == curr->data) {  // might be in the middle
+            curr = nodes[curr].right;
+        } else {  // might be in the middle
             if (index == word.length() - 1 &&
-                curr->freq != 0) {  // the word is existed
+                nodes[curr].freq != 0) {  // the word is existed
                 return false;
             } else if (index == word.length() - 1) {  // insert successfully
-                curr->freq = freq;
+                wordChanged(word);
+                nodes[curr].freq = freq;
+                raiseHighestFq(word, freq);
                 return true;
             }
 
-            if (curr->middle == nullptr) {  // insert the character
-                curr->middle = new TrieNode(word[index + 1]);
-                curr->middle->md = true;
-                curr->middle->layer = curr->layer + 1;
+            if (nodes[curr].middle == NIL) {  // insert the character
+                uint32_t child = newNode(word[index + 1]);
+                nodes[curr].middle = child;
             }
 
-            curr = curr->middle;
+            curr = nodes[curr].middle;
             index++;  // only move to the next character
                       // if the character is in the middle
         }
     }
+    return false;
+}
 
-    if (curr->freq != 0) {
-        return false;
+/**
+ * Add records to the TST. Sorting puts the words of every prefix next
+ * to each other, so an empty TST is built level by level: the records
+ * sharing a prefix are split into groups by their next character, the
+ * median group becomes the root of the sibling BST, the groups before
+ * and after it its left and right subtrees, and the rest of its words
+ * its middle subtree.
+ */
+void DictionaryTrie::bulkBuild(vector<Record>& records) {
+    records.erase(remove_if(records.begin(), records.end(),
+                            [](const Record& r) {
+                                return r.word.empty() || r.freq == 0;
+                            }),
+                  records.end());
+    stable_sort(records.begin(), records.end(),
+                [](const Record& a, const Record& b) {
+                    return a.word < b.word;
+                });
+    records.erase(unique(records.begin(), records.end(),
+                         [](const Record& a, const Record& b) {
+                             return a.word == b.word;
+                         }),
+                  records.end());
+    if (records.empty()) {
+        return;
+    }
+    if (resultCache) {
+        resultCache->clear();
+    }
+    if (art) {
+        for (const Record& r : records) {
+            art->insert(r.word, r.freq);
+        }
+        return;
+    }
+    clearCompletionCache();
+    if (this->root != NIL) {
+        insertMedians(records, 0, records.size());
+        return;
     }
 
-    curr->freq = freq;
-    return true;
+    // a word adds one node per character after the prefix it shares
+    // with the word before it
+    size_t numNew = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        size_t shared = 0;
+        if (i > 0) {
+            string_view prev = records[i - 1].word;
+            string_view curr = records[i].word;
+            while (shared < prev.size() && prev[shared] == curr[shared]) {
+                shared++;
+            }
+        }
+        numNew += records[i].word.size() - shared;
+    }
+    nodes.reserve(nodes.size() + numNew);
+    this->root = buildLevel(records, 0, records.size(), 0);
 }
 
 /**
- * Given a string word
- * Find the word in the TST.
- * Return true if the word is in the TST
- * Return false if the word is not in the TST
+ * Helper method for bulkBuild. Find where the character at depth
+ * changes and build the sibling BST of the groups.
  */
-bool DictionaryTrie::find(string word) const {
-    if (this->root == nullptr) {  // the TST is empty
-        return false;
+uint32_t DictionaryTrie::buildLevel(const vector<Record>& records, size_t lo,
+                                    size_t hi, size_t depth) {
+    vector<size_t> starts;
+    for (size_t i = lo; i < hi; i++) {
+        if (i == lo || records[i].word[depth] != records[i - 1].word[depth]) {
+            starts.push_back(i);
+        }
     }
+    starts.push_back(hi);
+    return buildSiblings(records, starts, 0, starts.size() - 1, depth);
+}
 
-    // plug a word string into a vector
-    vector<char> vec;
-    for (int i = 0; i < word.length(); i++) {
-        vec.push_back(word[i]);
+/**
+ * Helper method for bulkBuild. The median group is the node, and its
+ * word of depth + 1 characters, if any, sorts first in the group.
+ */
+uint32_t DictionaryTrie::buildSiblings(const vector<Record>& records,
+                                       const vector<size_t>& starts,
+                                       size_t first, size_t last,
+                                       size_t depth) {
+    if (first == last) {
+        return NIL;
     }
+    size_t mid = (first + last) / 2;
+    size_t lo = starts[mid];
+    size_t hi = starts[mid + 1];
+    uint32_t node = newNode(records[lo].word[depth]);
+    unsigned int freq = 0;
+    if (records[lo].word.size() == depth + 1) {  // the node ends a word
+        freq = records[lo].freq;
+        lo++;
+    }
+    // newNode may move the pool, so the children are linked afterwards
+    uint32_t left = buildSiblings(records, starts, first, mid, depth);
+    uint32_t middle = lo < hi ? buildLevel(records, lo, hi, depth + 1) : NIL;
+    uint32_t right = buildSiblings(records, starts, mid + 1, last, depth);
 
-    TrieNode* curr = this->root;
-    int index = 0;
-    // There are still some characters in the string
-    while (index < word.length()) {
-        if (vec.at(index) < curr->data) {  // might be on the left
-            if (curr->left == nullptr) {   // not found
-                break;
-            }
-            curr = curr->left;
-        } else if (vec.at(index) == curr->data) {  // might be in the middle
-            // find the word
-            if (index == word.length() - 1 && curr->freq > 0) {
-                return true;
-            }
-            if (curr->middle == nullptr) {  // not found
-                break;
-            }
-            curr = curr->middle;
+    TrieNode& n = nodes[node];
+    n.left = left;
+    n.middle = middle;
+    n.right = right;
+    n.freq = freq;
+    n.highestFq = freq;
+    for (uint32_t child : {left, middle, right}) {
+        if (child != NIL && nodes[child].highestFq > n.highestFq) {
+            n.highestFq = nodes[child].highestFq;
+        }
+    }
+    return node;
+}
+
+/**
+ * Helper method for bulkBuild on a TST that already holds words
+ */
+void DictionaryTrie::insertMedians(const vector<Record>& records,
+                                   size_t start, size_t end) {
+    if (start == end) {
+        return;
+    }
+    size_t median = (start + end) / 2;
+    insert(records[median].word, records[median].freq);
+    insertMedians(records, start, median);
+    insertMedians(records, median + 1, end);
+}
+
+/**
+ * Helper method for updateFrequency and remove. Fill path with the
+ * nodes passed on the way from the root to the last character of word
+ * and return that node, or NIL if word is not in the TST.
+ */
+uint32_t DictionaryTrie::findPath(string_view word,
+                                  vector<uint32_t>& path) const {
+    path.clear();
+    if (word.length() == 0) {
+        return NIL;
+    }
+    uint32_t curr = this->root;
+    unsigned int index = 0;
+    while (curr != NIL) {
+        path.push_back(curr);
+        const TrieNode& node = nodes[curr];
+        if (charLess(word[index], node.data)) {
+            curr = node.left;
+        } else if (charLess(node.data, word[index])) {
+            curr = node.right;
+        } else if (index == word.length() - 1) {
+            return node.freq != 0 ? curr : NIL;
+        } else {
+            curr = node.middle;
             index++;
-        } else if (vec.at(index) > curr->data) {  // might be on the right
-            if (curr->right == nullptr) {         // not found
-                break;
-            }
-            curr = curr->right;
         }
     }
-    return false;
+    return NIL;
 }
 
 /**
- * overloaded operator() for sort use in "predictUnderscores"
+ * Helper method for insert. A new word can only raise the highestFq
+ * of the nodes above it, which are walked again instead of being
+ * collected on the way down.
  */
-struct sortComp {
-    bool operator()(pair<string, int> a, pair<string, int> b) const {
-        if (a.second != b.second) {
-            return (a.second > b.second);  // swap if true
+void DictionaryTrie::raiseHighestFq(string_view word, unsigned int freq) {
+    uint32_t curr = this->root;
+    size_t index = 0;
+    while (curr != NIL) {
+        TrieNode& node = nodes[curr];
+        if (node.highestFq < freq) {
+            node.highestFq = freq;
+        }
+        if (charLess(word[index], node.data)) {
+            curr = node.left;
+        } else if (charLess(node.data, word[index])) {
+            curr = node.right;
+        } else if (index == word.length() - 1) {
+            return;
         } else {
-            return (a.first < b.first);  // swap if true
+            curr = node.middle;
+            index++;
         }
     }
-} sortComp;
+}
 
 /**
- * help method of "predictCompletions"
- * set the visited value of all nodes of the TST false
+ * Helper method for updateFrequency and remove. Recompute the
+ * highestFq of the nodes of path from the bottom up. The subtrees off
+ * the path did not change, so each node only looks at its children.
  */
-void DictionaryTrie::cleanVisited() {
-    TrieNode* curr = this->root;
-    stack<TrieNode*> traverseStack;
-    traverseStack.push(curr);
-    TrieNode* currTrieNode = nullptr;
-    // use DFS to traverse the TST
-    while ((!traverseStack.empty())) {
-        currTrieNode = traverseStack.top();
-        traverseStack.pop();
-        currTrieNode->visited = false;  // set the value false
+void DictionaryTrie::repairHighestFq(const vector<uint32_t>& path) {
+    for (size_t i = path.size(); i > 0; i--) {
+        TrieNode& node = nodes[path[i - 1]];
+        node.highestFq = node.freq;
+        uint32_t children[] = {node.left, node.middle, node.right};
+        for (uint32_t child : children) {
+            if (child != NIL && nodes[child].highestFq > node.highestFq) {
+                node.highestFq = nodes[child].highestFq;
+            }
+        }
+    }
+}
 
-        if (currTrieNode->right != nullptr) {  // push to the right child
-            traverseStack.push(currTrieNode->right);
+/**
+ * Set the frequency of word to freq and repair the highestFq on its
+ * path. Return false if word is not in the TST. A frequency of 0
+ * removes the word.
+ */
+bool DictionaryTrie::updateFrequency(string_view word, unsigned int freq) {
+    if (art) {
+        if (!art->updateFrequency(word, freq)) {
+            return false;
         }
+        wordChanged(word);
+        return true;
+    }
+    if (freq == 0) {
+        return remove(word);
+    }
+    vector<uint32_t> path;
+    uint32_t node = findPath(word, path);
+    if (node == NIL) {
+        return false;
+    }
+    wordChanged(word);
+    nodes[node].freq = freq;
+    repairHighestFq(path);
+    return true;
+}
 
-        if (currTrieNode->left != nullptr) {  // push to the left child
-            traverseStack.push(currTrieNode->left);
+/**
+ * Remove word from the TST. The nodes at the end of its path that no
+ * longer lead to any word go back to the free list, and the highestFq
+ * of the rest of the path is repaired. Return false if word is not in
+ * the TST.
+ */
+bool DictionaryTrie::remove(string_view word) {
+    if (art) {
+        if (!art->remove(word)) {
+            return false;
         }
+        wordChanged(word);
+        return true;
+    }
+    vector<uint32_t> path;
+    uint32_t node = findPath(word, path);
+    if (node == NIL) {
+        return false;
+    }
+    wordChanged(word);
+    nodes[node].freq = 0;
 
-        if (currTrieNode->middle != nullptr) {  // push the middle child
-            traverseStack.push(currTrieNode->middle);
+    // unlink empty leaves from the bottom of the path
+    while (!path.empty()) {
+        uint32_t last = path.back();
+        if (nodes[last].freq != 0 || nodes[last].left != NIL ||
+            nodes[last].middle != NIL || nodes[last].right != NIL) {
+            break;
+        }
+        path.pop_back();
+        if (path.empty()) {
+            this->root = NIL;
+        } else if (nodes[path.back()].left == last) {
+            nodes[path.back()].left = NIL;
+        } else if (nodes[path.back()].middle == last) {
+            nodes[path.back()].middle = NIL;
+        } else {
+            nodes[path.back()].right = NIL;
         }
+        nodes[last].middle = freeList;
+        freeList = last;
+        numFree++;
     }
+    repairHighestFq(path);
+    return true;
 }
 
 /**
- * helper method to control the size of the priority_queue
+ * Given a string word
+ * Find the word in the TST.
+ * Return true if the word is in the TST
+ * Return false if the word is not in the TST
  */
-void DictionaryTrie::pd_fixed(
-    priority_queue<pair<string, int>*, vector<pair<string, int>*>, compare>& pq,
-    int numCompletions, pair<string, int>* currPair) {
-    pair<string, int>* ref;
-    // there are no enough words in the vector
-    if (pq.size() < numCompletions) {
-        pq.push(currPair);
-        // cout << pq.top()->first << endl;
-    } else {  // the size is full
-        ref = pq.top();
-        // the current word has larger frequency than the word
-        // with smallest frequency in the vector
-        if (currPair->second > ref->second) {
-            pq.pop();
-            delete ref;
-            pq.push(currPair);
-        } else if (currPair->second == ref->second) {
-            if (currPair->first < ref->first) {
-                pq.pop();
-                delete ref;
-                pq.push(currPair);
-            } else {
-                delete currPair;
+bool DictionaryTrie::find(string_view word, SearchStats* stats) const {
+    if (art) {
+        return art->find(word, stats);
+    }
+    SearchStats unused;
+    SearchStats& counts = stats != nullptr ? *stats : unused;
+    uint32_t curr = this->root;
+    size_t index = 0;
+    // There are still some characters in the string
+    while (curr != NIL && index < word.length()) {
+        const TrieNode& node = nodes[curr];
+        counts.nodesVisited++;
+        if (charLess(word[index], node.data)) {  // might be on the left
+            curr = node.left;
+        } else if (charLess(node.data, word[index])) {  // on the right
+            curr = node.right;
+        } else {  // might be in the middle
+            // find the word
+            if (index == word.length() - 1) {
+                return node.freq > 0;
             }
-        } else {  // don't need to insert the current word
-            delete currPair;
+            curr = node.middle;
+            index++;
         }
     }
+    return false;
 }
 
 /**
- * helper method of main to set the highestFq of each node
+ * Return the frequency of the node of the last character of word
  */
-void DictionaryTrie::highestFreq(TrieNode* node) {
-    if (node->right != nullptr) {  // there is a subtree on the right
-        highestFreq(node->right);  // recurse to the right child
-        // the frequency of the node is not the highest frequency of
-        // the subtree whose root is the node
-        if (node->freq < node->right->highestFq) {
-            // the current highest frequency of the node is not the
-            // actual highest frequency
-            if (node->highestFq < node->right->highestFq) {
-                node->highestFq = node->right->highestFq;
-            }
-        } else {  // the frequency of the node is the highest frequency
-            node->highestFq = node->freq;
-        }
+unsigned int DictionaryTrie::frequency(string_view word) const {
+    if (art) {
+        return art->frequency(word);
     }
+    if (word.empty()) {
+        return 0;
+    }
+    uint32_t node = findPrefix(word);
+    return node == NIL ? 0 : nodes[node].freq;
+}
 
-    if (node->middle != nullptr) {  // there is a subtree in the middle
-        highestFreq(node->middle);  // recurse to the middle child
-        // the frequency of the node is not the highest frequency of
-        // the subtree whose root is the node
-        if (node->freq < node->middle->highestFq) {
-            // the current highest frequency of the node is not the
-            // actual highest frequency
-            if (node->highestFq < node->middle->highestFq) {
-                node->highestFq = node->middle->highestFq;
+/**
+ * Walk the TST in order with a stack of steps like the completion
+ * search, keeping the word spelled by the path in word. The places of
+ * the words in text are kept until text is complete, since text moves
+ * as it grows.
+ */
+vector<DictionaryTrie::Record> DictionaryTrie::listWords(string& text) const {
+    if (art) {
+        return art->listWords(text);
+    }
+    text.clear();
+    vector<pair<size_t, unsigned int>> places;
+    vector<SearchStep> stack;
+    string word;
+    if (root != NIL) {
+        stack.push_back(SearchStep{root, 0, false});
+    }
+    while (!stack.empty()) {
+        SearchStep step = stack.back();
+        stack.pop_back();
+        const TrieNode& curr = nodes[step.node];
+        // up is the length of the word above the node
+        if (step.emit) {
+            word.resize(step.up);
+            word += curr.data;
+            if (curr.freq != 0) {
+                places.push_back(make_pair(text.size(), curr.freq));
+                text += word;
             }
-        } else {  // the frequency of the node is the highest frequency
-            node->highestFq = node->freq;
-        }
-    }
-    if (node->left != nullptr) {  // there is a subtree on the left
-        highestFreq(node->left);  // recurse to the left child
-        // the frequency of the node is not the highest frequency of
-        // the subtree whose root is the node
-        if (node->freq < node->left->highestFq) {
-            // the current highest frequency of the node is not the
-            // actual highest frequency
-            if (node->highestFq < node->left->highestFq) {
-                node->highestFq = node->left->highestFq;
+            if (curr.middle != NIL) {
+                stack.push_back(SearchStep{curr.middle, step.up + 1, false});
             }
-        } else {  // the frequency of the node is the highest frequency
-            node->highestFq = node->freq;
+            continue;
+        }
+        if (curr.right != NIL) {
+            stack.push_back(SearchStep{curr.right, step.up, false});
         }
+        stack.push_back(SearchStep{step.node, step.up, true});
+        if (curr.left != NIL) {
+            stack.push_back(SearchStep{curr.left, step.up, false});
+        }
+    }
+
+    vector<Record> words;
+    words.reserve(places.size());
+    for (size_t i = 0; i < places.size(); i++) {
+        size_t end = i + 1 < places.size() ? places[i + 1].first : text.size();
+        words.push_back(Record{string_view(text).substr(places[i].first,
+                                                        end - places[i].first),
+                               places[i].second});
+    }
+    return words;
+}
+
+/**
+ * helper method to control the size of the top-k heap
+ * The front of the heap is the worst kept word, it is replaced when
+ * the heap is full and the new word is more frequent, or as frequent
+ * and alphabetically smaller.
+ */
+void DictionaryTrie::pd_fixed(vector<pair<string, int>>& heap,
+                              unsigned int numCompletions, const string& word,
+                              int freq) {
+    // there are no enough words in the heap
+    if (heap.size() < numCompletions) {
+        heap.push_back(make_pair(word, freq));
+        push_heap(heap.begin(), heap.end(), compare());
+        return;
     }
-    if (node->left == nullptr && node->middle == nullptr &&
-        node->right == nullptr) {  // the node is leaf node
-        node->highestFq = node->freq;
+    const pair<string, int>& ref = heap.front();
+    if (freq > ref.second || (freq == ref.second && word < ref.first)) {
+        pop_heap(heap.begin(), heap.end(), compare());
+        heap.back().first = word;
+        heap.back().second = freq;
+        push_heap(heap.begin(), heap.end(), compare());
+    }
+}
+
+/**
+ * helper method of main to set the highestFq of each node
+ * The highestFq of a node is the largest frequency among the node
+ * and all nodes of its left, middle and right subtrees. insert,
+ * updateFrequency and remove keep it up to date, so this full pass is
+ * only needed to check or rebuild it.
+ */
+void DictionaryTrie::highestFreq(uint32_t node) {
+    if (node == NIL) {  // the TST is empty
+        return;
+    }
+    TrieNode& n = nodes[node];
+    n.highestFq = n.freq;
+    uint32_t children[] = {n.left, n.middle, n.right};
+    for (uint32_t child : children) {
+        if (child != NIL) {
+            highestFreq(child);  // recurse to the child first
+            if (nodes[child].highestFq > n.highestFq) {
+                n.highestFq = nodes[child].highestFq;
+            }
+        }
     }
 }
 
 /**
  * Helper method for predictCompletion to find the last index of
- * the prefix in the DictionaryTrie and return the corresponding
- * TrieNode* to predictCompletion.
+ * the prefix in the DictionaryTrie and return the index of the
+ * corresponding TrieNode to predictCompletion, or NIL.
  * */
-DictionaryTrie::TrieNode* DictionaryTrie::findPrefix(string prefix) {
-    TrieNode* start = nullptr;
-    TrieNode* curr = this->root;
-    int index = 0;
-
-    while (index < prefix.length()) {
-        if (prefix[index] < curr->data) {  // might on the left
-            if (curr->left == nullptr) {   // the tree is not deep enough
-                // break;
-                return start;
-            }
-            curr = curr->left;                     // move to the left
-        } else if (prefix[index] == curr->data) {  // might in the middle
-            if (index == prefix.length() - 1) {    // find the word
-                start = curr;
-                // break;
-                return start;
-            }
-            if (curr->middle == nullptr) {  // the tree is not deep enough
-                // break;
-                return start;
-            }
-            curr = curr->middle;  // move to the middle and point to the next
-                                  // character
+uint32_t DictionaryTrie::findPrefix(string_view prefix,
+                                    SearchStats* stats) const {
+    if (prefix.empty()) {
+        return NIL;
+    }
+    SearchStats unused;
+    SearchStats& counts = stats != nullptr ? *stats : unused;
+    uint32_t curr = this->root;
+    size_t index = 0;
+
+    while (curr != NIL) {
+        const TrieNode& node = nodes[curr];
+        counts.nodesVisited++;
+        if (charLess(prefix[index], node.data)) {  // might on the left
+            curr = node.left;
+        } else if (charLess(node.data, prefix[index])) {  // on the right
+            curr = node.right;
+        } else if (index == prefix.length() - 1) {  // find the prefix
+            return curr;
+        } else {  // move to the middle and point to the next character
+            curr = node.middle;
             index++;
-        } else if (prefix[index] > curr->data) {  // might on the right
-            if (curr->right == nullptr) {         // the tree is not deep enough
-                // break;
-                return start;
-            }
-            curr = curr->right;  // move to the right
         }
     }
+    return NIL;  // the tree is not deep enough
 }
 
 /**
@@ -319,362 +660,829 @@ DictionaryTrie::TrieNode* DictionaryTrie::findPrefix(string prefix) {
  * Return a vector that include the "numCompletions" most frequenct
  * words which start with string "prefix".
  */
-vector<string> DictionaryTrie::predictCompletions(string prefix,
-                                                  unsigned int numCompletions) {
-    // Initialize the return vector
+vector<string> DictionaryTrie::predictCompletions(
+    string prefix, unsigned int numCompletions) const {
+    SearchScratch scratch;
+    return predictCompletions(prefix, numCompletions, scratch);
+}
+
+/**
+ * predictCompletions searching with the buffers in scratch
+ */
+vector<string> DictionaryTrie::predictCompletions(
+    const string& prefix, unsigned int numCompletions, SearchScratch& scratch,
+    SearchStats* stats) const {
     vector<string> vecReturn;
+    vecReturn.resize(
+        predictCompletions(prefix, numCompletions, scratch, vecReturn, stats));
+    return vecReturn;
+}
+
+/**
+ * predictCompletions writing into out
+ * A query the QueryCache answers skips the search, and the answer of a
+ * query it does not answer is stored in it. An empty prefix or
+ * numCompletions of 0 has nothing to cache.
+ */
+size_t DictionaryTrie::predictCompletions(const string& prefix,
+                                          unsigned int numCompletions,
+                                          SearchScratch& scratch,
+                                          vector<string>& out,
+                                          SearchStats* stats) const {
+    if (!resultCache || prefix.empty() || numCompletions == 0) {
+        return searchCompletions(prefix, numCompletions, scratch, out, stats);
+    }
+    size_t count;
+    if (resultCache->lookup(prefix, numCompletions, out, count)) {
+        return count;
+    }
+    count = searchCompletions(prefix, numCompletions, scratch, out, stats);
+    resultCache->store(prefix, numCompletions, out, count);
+    return count;
+}
 
+/**
+ * Helper method for predictCompletions, the search itself
+ * The middle subtree of the prefix is walked in order (left subtree,
+ * node, middle subtree, right subtree), so words are reached in
+ * alphabetical order and the heap breaks ties between equal
+ * frequencies by the order of the trail instead of comparing strings.
+ * A word is then spelled by following up from its trail entry.
+ */
+size_t DictionaryTrie::searchCompletions(const string& prefix,
+                                         unsigned int numCompletions,
+                                         SearchScratch& scratch,
+                                         vector<string>& out,
+                                         SearchStats* stats) const {
+    if (art) {
+        return art->predictCompletions(prefix, numCompletions, scratch, out,
+                                       stats);
+    }
     // Prefix is a string with length 0 or the numCompletions is 0.
     if (prefix.length() == 0 || numCompletions == 0) {
-        return vecReturn;
+        return 0;
     }
 
     // call the helper method to find the prefix
     // in the DictionaryTrie
-    TrieNode* start = findPrefix(prefix);
+    uint32_t found = findPrefix(prefix, stats);
 
-    if (start == nullptr) {  // there is no word starts with the string "prefix"
-        return vecReturn;
+    if (found == NIL) {  // there is no word starts with the string "prefix"
+        return 0;
     }
+    const TrieNode& start = nodes[found];
 
-    // Initialize a priority_queue with an overloaded comparater
-    std::priority_queue<pair<string, int>*, vector<pair<string, int>*>, compare>
-        pq;
+    // the cached list answers the query if it is long enough, or if it
+    // is shorter than cacheSize because it holds every completion
+    if (cacheSize != 0 && start.cacheSlot != NO_CACHE) {
+        unsigned int begin = cacheBegin[start.cacheSlot];
+        unsigned int end = cacheBegin[start.cacheSlot + 1];
+        if (numCompletions <= cacheSize || end - begin < cacheSize) {
+            size_t count = min(end - begin, numCompletions);
+            if (out.size() < count) {
+                out.resize(count);
+            }
+            for (size_t i = 0; i < count; i++) {
+                out[i] = cacheWords[cacheIds[begin + i]];
+            }
+            return count;
+        }
+    }
+    if (walkOrder == BEST_FIRST) {
+        return searchBestFirst(prefix, found, numCompletions, scratch, out,
+                               stats);
+    }
 
-    // Start traversing the selected subtree starting with
-    // the last element of the prefix with DFS
-    stack<TrieNode*> traverseStack;
-    string currword = "";
-    int currlen = 0;
-    traverseStack.push(start);
-    int diff = start->layer;
-    TrieNode* currTrieNode;
-    pair<string, int>* currPair;
-    while ((!traverseStack.empty())) {  // there is something in the stack
-        currTrieNode = traverseStack.top();
+    // the top-k heap with the worst word in front, on the stack unless
+    // numCompletions is large. Every word ends at its own node, so the
+    // heap never holds more than numNodes() words, whatever the k.
+    Candidate local[STACK_HEAP];
+    Candidate* heap = local;
+    if (numCompletions > STACK_HEAP) {
+        scratch.heap.resize(min<size_t>(numCompletions, numNodes()));
+        heap = scratch.heap.data();
+    }
+    size_t heapSize = 0;
+    auto better = [](const Candidate& a, const Candidate& b) {
+        return a.freq > b.freq || (a.freq == b.freq && a.rank < b.rank);
+    };
 
-        int l = currTrieNode->layer - diff;  // find out the index in currword
+    vector<TrailEntry>& trail = scratch.trail;
+    trail.clear();
+    trail.push_back(TrailEntry{found, NIL});
+    if (start.freq != 0) {  // the prefix itself is a word
+        heap[heapSize++] = Candidate{start.freq, 0};
+    }
 
-        for (int i = l + 1; i < currlen; i++) {
-            currword.pop_back();
-        }
+    vector<SearchStep>& traverseStack = scratch.stack;
+    traverseStack.clear();
+    if (start.middle != NIL) {
+        traverseStack.push_back(SearchStep{start.middle, 0, false});
+    }
+    size_t visited = 0;
+    size_t pruned = 0;
+    while (!traverseStack.empty()) {  // there is something in the stack
+        SearchStep step = traverseStack.back();
+        traverseStack.pop_back();
+        const TrieNode& curr = nodes[step.node];
 
-        if (l > currlen - 1) {
-            currword = currword + currTrieNode->data;
-        } else {
-            currword[l] = currTrieNode->data;
+        if (step.emit) {
+            // the left subtree is done, so this word comes next
+            uint32_t rank = trail.size();
+            trail.push_back(TrailEntry{step.node, step.up});
+            if (curr.freq != 0 && heapSize < numCompletions) {
+                heap[heapSize++] = Candidate{curr.freq, rank};
+                push_heap(heap, heap + heapSize, better);
+            } else if (curr.freq != 0 && curr.freq > heap[0].freq) {
+                // a word reached later only wins on frequency
+                pop_heap(heap, heap + heapSize, better);
+                heap[heapSize - 1] = Candidate{curr.freq, rank};
+                push_heap(heap, heap + heapSize, better);
+            }
+            if (curr.middle != NIL) {
+                traverseStack.push_back(SearchStep{curr.middle, rank, false});
+            }
+            continue;
         }
+        visited++;
 
-        currlen = l + 1;
-        if (currTrieNode->freq != 0) {  // the word exists
-            currPair = new pair<string, int>(currword, currTrieNode->freq);
+        // Later words are alphabetically larger, so one as frequent as
+        // the worst word in the heap loses to it as well. Skip the
+        // subtree unless it holds a strictly more frequent word.
+        if (heapSize == numCompletions && curr.highestFq <= heap[0].freq) {
+            pruned++;
+            continue;
+        }
+        if (curr.right != NIL) {
+            traverseStack.push_back(SearchStep{curr.right, step.up, false});
+        }
+        traverseStack.push_back(SearchStep{step.node, step.up, true});
+        if (curr.left != NIL) {
+            traverseStack.push_back(SearchStep{curr.left, step.up, false});
+        }
+    }
+    if (stats != nullptr) {
+        stats->nodesVisited += visited;
+        stats->nodesPruned += pruned;
+    }
 
-            pd_fixed(pq, numCompletions, currPair);
+    // sort the heap from the best word to the worst and spell the words
+    // backwards from their trail entries
+    sort(heap, heap + heapSize, better);
+    if (out.size() < heapSize) {
+        out.resize(heapSize);
+    }
+    for (size_t i = 0; i < heapSize; i++) {
+        size_t len = prefix.length();
+        for (uint32_t t = heap[i].rank; t != 0; t = trail[t].up) {
+            len++;
+        }
+        string& word = out[i];
+        word.resize(len);
+        prefix.copy(&word[0], prefix.length());
+        for (uint32_t t = heap[i].rank; t != 0; t = trail[t].up) {
+            word[--len] = nodes[trail[t].node].data;
         }
+    }
+    return heapSize;
+}
 
-        traverseStack.pop();
-        currTrieNode->visited = true;  // Mark the node as visited
+/**
+ * Helper method for searchCompletions, the BEST_FIRST search
+ * The frontier is a max-heap of subtrees keyed by highestFq and of
+ * words keyed by frequency, a subtree coming before a word of the same
+ * key. Entering a subtree adds the word of its root and its three
+ * children to the frontier. A word at the top of the frontier is
+ * therefore at least as frequent as every word not reached yet, and the
+ * words of its frequency are all in the frontier already: they are
+ * taken together and put in alphabetical order. The search stops once
+ * numCompletions words are out, and what is left in the frontier is
+ * pruned.
+ */
+size_t DictionaryTrie::searchBestFirst(const string& prefix, uint32_t found,
+                                       unsigned int numCompletions,
+                                       SearchScratch& scratch,
+                                       vector<string>& out,
+                                       SearchStats* stats) const {
+    auto lower = [](const FrontierEntry& a, const FrontierEntry& b) {
+        return a.bound < b.bound || (a.bound == b.bound && a.word && !b.word);
+    };
+    vector<FrontierEntry>& frontier = scratch.frontier;
+    frontier.clear();
+    auto push = [&](unsigned int bound, uint32_t node, uint32_t up,
+                    bool word) {
+        frontier.push_back(FrontierEntry{bound, node, up, word});
+        push_heap(frontier.begin(), frontier.end(), lower);
+    };
 
-        // check if the node has a right child, if so,
-        // then push its right child into the stack
-        if (currTrieNode->right != nullptr &&
-            currTrieNode->layer > start->layer) {
-            if (pq.size() == 0) {
-                if (currTrieNode->right->visited == false) {
-                    traverseStack.push(currTrieNode->right);
-                }
-                // check the highestFreq of its right child branch is greater
-                // than the lowest frequency in the priority_queue or if the
-                // size of the priority_queue is less than the number of
-                // suggested completions
-            } else if (currTrieNode->right->highestFq >= pq.top()->second ||
-                       pq.size() < numCompletions) {
-                if (currTrieNode->right->visited == false) {
-                    traverseStack.push(currTrieNode->right);
-                }
-            }
+    vector<TrailEntry>& trail = scratch.trail;
+    trail.clear();
+    trail.push_back(TrailEntry{found, NIL});
+    const TrieNode& start = nodes[found];
+    if (start.freq != 0) {  // the prefix itself is a word
+        push(start.freq, 0, NIL, true);
+    }
+    if (start.middle != NIL) {
+        push(nodes[start.middle].highestFq, start.middle, 0, false);
+    }
+
+    // spell the word of trail entry rank into word
+    auto spell = [&](uint32_t rank, string& word) {
+        size_t len = prefix.length();
+        for (uint32_t t = rank; t != 0; t = trail[t].up) {
+            len++;
         }
+        word.resize(len);
+        prefix.copy(&word[0], prefix.length());
+        for (uint32_t t = rank; t != 0; t = trail[t].up) {
+            word[--len] = nodes[trail[t].node].data;
+        }
+    };
 
-        // check if the node has a left child, if so,
-        // then push its left child into the stack
-        if (currTrieNode->left != nullptr &&
-            currTrieNode->layer > start->layer) {
-            if (pq.size() == 0) {
-                if (currTrieNode->left->visited == false) {
-                    traverseStack.push(currTrieNode->left);
-                }
-                // check the highestFreq of its left child branch is greater
-                // than the lowest frequency in the priority_queue or if the
-                // size of the priority_queue is less than the number of
-                // suggested completions
-            } else if (currTrieNode->left->highestFq >= pq.top()->second ||
-                       pq.size() < numCompletions) {
-                if (currTrieNode->left->visited == false) {
-                    traverseStack.push(currTrieNode->left);
+    size_t count = 0;
+    size_t visited = 0;
+    while (!frontier.empty() && count < numCompletions) {
+        pop_heap(frontier.begin(), frontier.end(), lower);
+        FrontierEntry top = frontier.back();
+        frontier.pop_back();
+
+        if (top.word) {
+            // spell every word of this frequency, then keep the first
+            // ones alphabetically
+            size_t ties = count;
+            if (out.size() <= ties) {
+                out.resize(ties + 1);
+            }
+            spell(top.node, out[ties++]);
+            while (!frontier.empty() && frontier.front().word &&
+                   frontier.front().bound == top.bound) {
+                pop_heap(frontier.begin(), frontier.end(), lower);
+                if (out.size() <= ties) {
+                    out.resize(ties + 1);
                 }
+                spell(frontier.back().node, out[ties++]);
+                frontier.pop_back();
             }
+            sort(out.begin() + count, out.begin() + ties);
+            count = min<size_t>(ties, numCompletions);
+            continue;
         }
 
-        // check if the node has a middle child, if so,
-        // then push its middle child into the stack
-        if (currTrieNode->middle != nullptr) {
-            if (pq.size() == 0) {
-                if (currTrieNode->middle->visited == false) {
-                    traverseStack.push(currTrieNode->middle);
-                }
-                // check the highestFreq of its middle child branch is greater
-                // than the lowest frequency in the priority_queue or if the
-                // size of the priority_queue is less than the number of
-                // suggested completions
-            } else if (currTrieNode->middle->highestFq >= pq.top()->second ||
-                       pq.size() < numCompletions) {
-                if (currTrieNode->middle->visited == false) {
-                    traverseStack.push(currTrieNode->middle);
-                }
-            }
+        visited++;
+        const TrieNode& curr = nodes[top.node];
+        uint32_t rank = trail.size();
+        trail.push_back(TrailEntry{top.node, top.up});
+        if (curr.freq != 0) {
+            push(curr.freq, rank, NIL, true);
+        }
+        if (curr.left != NIL) {
+            push(nodes[curr.left].highestFq, curr.left, top.up, false);
+        }
+        if (curr.middle != NIL) {
+            push(nodes[curr.middle].highestFq, curr.middle, rank, false);
+        }
+        if (curr.right != NIL) {
+            push(nodes[curr.right].highestFq, curr.right, top.up, false);
         }
     }
+    if (stats != nullptr) {
+        stats->nodesVisited += visited;
+        for (const FrontierEntry& entry : frontier) {
+            stats->nodesPruned += !entry.word;
+        }
+    }
+    return count;
+}
+
+/**
+ * Answer predictCompletions for every prefix on the workers of pool,
+ * each worker searching with its own scratch buffers
+ */
+vector<vector<string>> DictionaryTrie::predictCompletionsBatch(
+    const vector<string>& prefixes, unsigned int numCompletions,
+    ThreadPool& pool) const {
+    vector<vector<string>> answers(prefixes.size());
+    vector<SearchScratch> scratch(pool.size());
+    pool.run(prefixes.size(), [&](size_t i, unsigned int worker) {
+        answers[i] =
+            predictCompletions(prefixes[i], numCompletions, scratch[worker]);
+    });
+    return answers;
+}
+
+/**
+ * The batch above on a pool started for this call
+ */
+vector<vector<string>> DictionaryTrie::predictCompletionsBatch(
+    const vector<string>& prefixes, unsigned int numCompletions,
+    unsigned int numThreads) const {
+    ThreadPool pool(numThreads);
+    return predictCompletionsBatch(prefixes, numCompletions, pool);
+}
 
-    string pushString;
-    // Get the part of the prefix in which we will concatenate
-    // to the string in the priority_queue
-    string addPrefix = prefix.substr(0, prefix.length() - 1);
+/**
+ * Return true if a '_' in a pattern matches the character c, that is
+ * if c is printable and not an underscore
+ */
+bool DictionaryTrie::matchesUnderscore(char c) {
+    return c >= A && c < DELETE && c != UNDERSCORE;
+}
 
-    // check if the sie of the completed priority_queue is
-    // less than the numCompletions. If so, then set the
-    // numCompletions equal to the size of the priority_queue
-    if (pq.size() < numCompletions) {
-        numCompletions = pq.size();
+/**
+ * predictUnderscores() will return a vector holding up to
+ * the most frequent numCompletions of valid completions of
+ * pattern, which contains one or more '_'.
+ * The pattern is matched in one DFS of the TST. A node is tried against
+ * one position of the pattern: a fixed character steers the walk like
+ * in find, while a '_' visits both siblings and matches the node
+ * itself, so it only fans out to the characters actually stored there.
+ * Subtrees that cannot beat the worst word of the top-k heap are
+ * skipped.
+ */
+vector<string> DictionaryTrie::predictUnderscores(
+    string pattern, unsigned int numCompletions, SearchStats* stats) const {
+    if (art) {
+        return art->predictUnderscores(pattern, numCompletions, stats);
     }
+    // vector<string> to be returned
+    vector<string> vecReturn;
+    // edge cases if the numCompletions are 0 or the
+    // the input pattern is an empty string
+    if (numCompletions == 0 || pattern == "" || this->root == NIL) {
+        return vecReturn;
+    }
+
+    vector<pair<string, int>> heap;
+    // DFS stack of (node, position in the pattern)
+    vector<pair<uint32_t, unsigned int>> traverseStack;
+    traverseStack.push_back(make_pair(this->root, 0));
+    // word[i] is the character matched at position i on the current path
+    string word = pattern;
+    unsigned int last = pattern.length() - 1;
+    size_t visited = 0;
+    while (!traverseStack.empty()) {
+        const TrieNode* curr = &nodes[traverseStack.back().first];
+        unsigned int index = traverseStack.back().second;
+        traverseStack.pop_back();
+        visited++;
 
-    // copy each string into a vector string called vecReturn
-    pair<string, int>* element;
-    for (int i = 0; i < numCompletions; i++) {
-        element = pq.top();
-        pq.pop();
-        pushString = element->first;
-        delete element;
-        pushString = addPrefix + pushString;
-        vecReturn.push_back(pushString);
+        if (heap.size() == numCompletions &&
+            (int)curr->highestFq < heap.front().second) {
+            continue;
+        }
+
+        char c = pattern[index];
+        bool wildcard = c == '_';
+        if (curr->left != NIL && (wildcard || charLess(c, curr->data))) {
+            traverseStack.push_back(make_pair(curr->left, index));
+        }
+        if (curr->right != NIL && (wildcard || charLess(curr->data, c))) {
+            traverseStack.push_back(make_pair(curr->right, index));
+        }
+        if (wildcard ? !matchesUnderscore(curr->data) : c != curr->data) {
+            continue;
+        }
+        word[index] = curr->data;
+        if (index == last) {  // the whole pattern is matched
+            if (curr->freq != 0) {
+                pd_fixed(heap, numCompletions, word, curr->freq);
+            }
+        } else if (curr->middle != NIL) {
+            // pushed last, so the subtree is done before word[index]
+            // is overwritten by a sibling
+            traverseStack.push_back(make_pair(curr->middle, index + 1));
+        }
+    }
+    if (stats != nullptr) {
+        stats->nodesVisited += visited;
     }
 
-    // Since the priority_queue is a min-heap, we need
-    // to swap the resulting vecReturn
-    string temp;
-    for (int i = 0; i < vecReturn.size() / TWO; i++) {
-        temp = vecReturn[i];
-        vecReturn[i] = vecReturn[vecReturn.size() - 1 - i];
-        vecReturn[vecReturn.size() - i - 1] = temp;
+    // sort the heap from the best word to the worst
+    sort(heap.begin(), heap.end(), compare());
+    for (pair<string, int>& element : heap) {
+        vecReturn.push_back(move(element.first));
     }
     return vecReturn;
 }
 
 /**
- * Helper method used in backtrack() to check if the input string
- * does exist in the DictionaryTrie. It will return a pointer
- * to a pair with a TrieNode pointer as the first part and a
- * boolean as the second part. If the string does exist, the
- * boolean part will be true. Otherwise, it will be false.
- * */
-pair<DictionaryTrie::TrieNode*, bool> DictionaryTrie::existed(
-    string curString) {
-    bool check = false;
-    // Initialize a TrieNode pointer pointing to the root
-    TrieNode* curr = this->root;
-    int index = 0;
-    // while loop until the index is greater or equal to
-    // the length of the input string
-    while (index < curString.length()) {
-        // if the current char in curString is less than
-        // the corresponding char in the DictionaryTrie
-        if (curString[index] < curr->data) {
-            // if the left of the current TrieNode does not
-            // exist, then the curString does not exist
-            // in the DictionaryTrie
-            if (curr->left == nullptr) {
-                check = false;
-                break;
+ * Return the most frequent words starting within maxEdits edits of
+ * prefix. The TST is walked with one row of the Levenshtein table per
+ * layer: rows[d][j] is the edit distance between the first j
+ * characters of prefix and the d characters on the path. A node
+ * computes the row of its layer plus one from the row above it, which
+ * its siblings share. Once the last entry of a row is within maxEdits,
+ * every word below the node matches, and the rest of the middle
+ * subtree is searched like in predictCompletions. A middle subtree is
+ * skipped when no entry of the row is within maxEdits, since the
+ * entries never shrink further down, and any subtree is skipped when
+ * its highestFq cannot enter the top-k heap.
+ */
+vector<string> DictionaryTrie::predictFuzzy(const string& prefix,
+                                            unsigned int maxEdits,
+                                            unsigned int numCompletions) const {
+    if (art) {
+        return art->predictFuzzy(prefix, maxEdits, numCompletions);
+    }
+    vector<string> vecReturn;
+    if (prefix.length() == 0 || numCompletions == 0 || this->root == NIL) {
+        return vecReturn;
+    }
+
+    // one row of width + 1 entries per layer, entries above maxEdits
+    // are all stored as maxEdits + 1
+    const unsigned int width = prefix.length();
+    const unsigned int over = maxEdits + 1;
+    vector<unsigned int> rows(width + 1);
+    for (unsigned int j = 0; j <= width; j++) {
+        rows[j] = min(j, over);
+    }
+
+    vector<pair<string, int>> heap;
+    // DFS stack of (node, length of the word above the node, whether
+    // every word below the node matches, whether only the siblings
+    // labeled with a character of the band can continue)
+    struct Entry {
+        uint32_t node;
+        unsigned int len;
+        bool matched;
+        bool steer;
+    };
+    vector<Entry> traverseStack;
+    traverseStack.push_back(Entry{this->root, 0, width <= maxEdits, false});
+    string word;
+    while (!traverseStack.empty()) {
+        Entry top = traverseStack.back();
+        traverseStack.pop_back();
+        const TrieNode& curr = nodes[top.node];
+
+        if (heap.size() == numCompletions &&
+            (int)curr.highestFq < heap.front().second) {
+            continue;
+        }
+
+        unsigned int depth = top.len + 1;
+        const unsigned int* above = &rows[top.len * (width + 1)];
+        unsigned int first = depth > maxEdits ? depth - maxEdits : 0;
+        unsigned int last = min(depth + maxEdits, width);
+        if (top.steer) {
+            // Every entry of the row above is maxEdits or more, so a
+            // label matching no prefix character at such an entry
+            // pushes the whole row over maxEdits. Only those labels can
+            // continue, and the siblings are searched for them like in
+            // a BST instead of being walked.
+            bool useful = false;
+            unsigned char lowChar = UCHAR_MAX;
+            unsigned char highChar = 0;
+            for (unsigned int j = max(first, 1u); j <= last; j++) {
+                if (above[j - 1] <= maxEdits) {
+                    unsigned char c = prefix[j - 1];
+                    lowChar = min(lowChar, c);
+                    highChar = max(highChar, c);
+                    useful = useful || prefix[j - 1] == curr.data;
+                }
             }
-            curr = curr->left;
-            // if the current char in curString is the same
-            // as the corresponding char in the DictionaryTrie
-        } else if (curString[index] == curr->data) {
-            // if the curString exist in the DictionaryTrie
-            if (index == curString.length() - 1) {
-                check = true;
-                break;
+            if (curr.right != NIL && charLess(curr.data, highChar)) {
+                traverseStack.push_back(
+                    Entry{curr.right, top.len, false, true});
             }
-            // if the middle of the current TrieNode does not
-            // exist, then the curString does not exist
-            // in the DictionaryTrie
-            if (curr->middle == nullptr) {
-                check = false;
-                break;
+            if (curr.left != NIL && charLess(lowChar, curr.data)) {
+                traverseStack.push_back(
+                    Entry{curr.left, top.len, false, true});
             }
-            curr = curr->middle;
-            index++;
-            // if the current char in curString is greater
-            // than the corresponding char in the DictionaryTrie
-        } else if (curString[index] > curr->data) {
-            // if the right of the current TrieNode does not
-            // exist, then the curString does not exist
-            // in the DictionaryTrie
-            if (curr->right == nullptr) {
-                check = false;
-                break;
+            if (!useful) {
+                continue;
+            }
+        } else {
+            if (curr.right != NIL) {
+                traverseStack.push_back(
+                    Entry{curr.right, top.len, top.matched, false});
             }
-            curr = curr->right;
+            if (curr.left != NIL) {
+                traverseStack.push_back(
+                    Entry{curr.left, top.len, top.matched, false});
+            }
+        }
+
+        word.resize(top.len);
+        word.push_back(curr.data);
+        bool matched = top.matched;
+        unsigned int lowest = 0;
+        if (!matched) {
+            // the row of the path through this node, of which only the
+            // band of entries j with |j - depth| <= maxEdits can be
+            // within maxEdits, the rest keep the value over
+            if (rows.size() < (depth + 1) * (width + 1)) {
+                rows.resize((depth + 1) * (width + 1), over);
+                above = &rows[top.len * (width + 1)];
+            }
+            unsigned int* row = &rows[depth * (width + 1)];
+            lowest = over;
+            if (first == 0) {
+                row[0] = min(depth, over);
+                lowest = row[0];
+                first = 1;
+            }
+            for (unsigned int j = first; j <= last; j++) {
+                unsigned int cost = above[j - 1] + (prefix[j - 1] != curr.data);
+                cost = min(cost, min(above[j], row[j - 1]) + 1);
+                row[j] = min(cost, over);
+                lowest = min(lowest, row[j]);
+            }
+            matched = row[width] <= maxEdits;
         }
+
+        if (matched && curr.freq != 0) {
+            pd_fixed(heap, numCompletions, word, curr.freq);
+        }
+        if (lowest <= maxEdits && curr.middle != NIL) {
+            // pushed last, so the subtree is done before a sibling
+            // overwrites the row of the next layer
+            traverseStack.push_back(Entry{curr.middle, depth, matched,
+                                          !matched && lowest == maxEdits});
+        }
+    }
+
+    // sort the heap from the best word to the worst
+    sort(heap.begin(), heap.end(), compare());
+    for (pair<string, int>& element : heap) {
+        vecReturn.push_back(move(element.first));
     }
-    pair<TrieNode*, bool> Rtpair = make_pair(curr, check);
-    return Rtpair;
+    return vecReturn;
 }
 
 /**
- * Helper method for predictUnderscore method.
- * This method find valid strings to the input PatternVP
- * by trying all possible combinations recursively.
- * It will populate the result with all valid strings.
- * */
-void DictionaryTrie::backtrack(vector<pair<string, unsigned int>>& result,
-                               int curIndex, int maxLen, string curString,
-                               vector<pair<int, char>> PatternVP) {
-    pair<string, unsigned int> makePair;
-    // base case when we read the maxLen
-    if (curIndex == maxLen) {
-        // call the helper method existed to check if the
-        // curString is a string in the DictionaryTrie
-        pair<TrieNode*, bool> exist = existed(curString);
-        // check if the curString is valid
-        if (exist.first->freq > 0 && exist.second == true) {
-            // if so, then push the curString and corresponding
-            // frequency into the result vector
-            makePair = make_pair(curString, exist.first->freq);
-            result.push_back(makePair);
-        }
-        return;
+ * Precompute the completion lists of every node of the first maxDepth
+ * layers. The lists are built bottom-up in one pass over the TST: the
+ * completions of a node are the node itself and its middle subtree, so
+ * its list is merged from the node and the list of the middle subtree,
+ * and every list is cut to cacheSize entries on the way up.
+ */
+bool DictionaryTrie::buildCompletionCache(unsigned int cacheSize,
+                                          unsigned int maxDepth) {
+    clearCompletionCache();
+    if (art) {
+        return false;
     }
-    // check if the curIndex in the second part of
-    // PatternVP is not an underscore
-    if (PatternVP[curIndex].second != '_') {
-        // if so, then add the corresponding char into the
-        // curString
-        curString = curString + PatternVP[curIndex].second;
-        // call the helper method existed()
-        pair<TrieNode*, bool> exist = existed(curString);
-        if (exist.second == true) {
-            // call backtrack() with curIndex+1
-            backtrack(result, curIndex + 1, maxLen, curString, PatternVP);
-        }
-        // if the curIndex in the second part of PatternVP
-        // is an underscore, then we will try different char
-        // from A to ~ through ASCII code except '_' itself
-    } else {
-        // check all chars from A up to '^' by ascii code
-        for (int i = A; i < UNDERSCORE; i++) {
-            curString = curString + char(i);
-            pair<TrieNode*, bool> exist = existed(curString);
-            if (exist.second == true) {
-                // if the curString with the symbol does exist in the
-                // DictionaryTrie, then call backtrack
-                backtrack(result, curIndex + 1, maxLen, curString, PatternVP);
-            }
-            curString.pop_back();
-        }
+    if (cacheSize == 0 || this->root == NIL) {
+        return true;
+    }
+    this->cacheSize = cacheSize;
+    cacheBegin.push_back(0);
 
-        // check all chars from '`' to '-' by ascii code
-        for (int i = BACKQUOTE; i < DELETE; i++) {
-            curString = curString + char(i);
-            pair<TrieNode*, bool> exist = existed(curString);
-            if (exist.second == true) {
-                // if the curString with the symbol does exist in the
-                // DictionaryTrie, then call backtrack
-                backtrack(result, curIndex + 1, maxLen, curString, PatternVP);
-            }
-            curString.pop_back();
+    // lists first hold ranks, which are replaced by word ids below
+    string word;
+    vector<string> wordOf;
+    buildCacheAt(this->root, maxDepth, word, wordOf);
+
+    // keep only the words that are in some list
+    vector<unsigned int> idOf(wordOf.size(), NO_CACHE);
+    for (unsigned int& id : cacheIds) {
+        if (idOf[id] == NO_CACHE) {
+            idOf[id] = cacheWords.size();
+            cacheWords.push_back(wordOf[id]);
         }
+        id = idOf[id];
     }
+    cacheWords.shrink_to_fit();
+    cacheIds.shrink_to_fit();
+    cacheBegin.shrink_to_fit();
+    return true;
 }
+
 /**
- * predictUnderscores() will return a vector holding up to
- * the most frequent numCompletions of valid completions of
- * pattern, which contains one or more '_'.
+ * Helper method for buildCompletionCache. An in-order walk (left, node,
+ * middle, right) meets the words in alphabetical order, so the rank of
+ * a word is the number of words met before it, and equal frequencies
+ * are ordered by rank exactly like predictCompletions orders them.
  */
-std::vector<string> DictionaryTrie::predictUnderscores(
-    string pattern, unsigned int numCompletions) {
-    // vector<string> to be returned
-    vector<string> vecReturn;
-    // a vector holding (string, unsigned int) pairs
-    // to be sorted later
-    vector<pair<string, unsigned int>> highFreqPair;
-    // edge cases if the numCompletions are 0 or the
-    // the input pattern is an empty string
-    if (numCompletions == 0 || pattern == "") {
-        return vecReturn;
+vector<DictionaryTrie::RankedWord> DictionaryTrie::buildCacheAt(
+    uint32_t node, unsigned int maxDepth, string& word,
+    vector<string>& wordOf) {
+    TrieNode& n = nodes[node];
+    vector<RankedWord> leftTop;
+    if (n.left != NIL) {
+        leftTop = buildCacheAt(n.left, maxDepth, word, wordOf);
     }
 
-    // decompose the input pattern into a vector
-    // with each char's corresponding position
-    vector<pair<int, char>> PatternVP;
-    pair<int, char> makePair;
-    for (int i = 0; i < pattern.length(); i++) {
-        makePair = make_pair(i, pattern[i]);
-        PatternVP.push_back(makePair);
+    word.push_back(n.data);
+    vector<RankedWord> completions;
+    if (n.freq != 0) {  // the node ends a word
+        completions.push_back(RankedWord{n.freq, (unsigned int)wordOf.size()});
+        wordOf.push_back(word);
     }
+    if (n.middle != NIL) {
+        completions = mergeRanked(
+            completions, buildCacheAt(n.middle, maxDepth, word, wordOf));
+    }
+    word.pop_back();
 
-    // call the helper method backtrack to push all valid
-    // strings into highFreqPair vector
-    backtrack(highFreqPair, 0, pattern.length(), "", PatternVP);
+    vector<RankedWord> rightTop;
+    if (n.right != NIL) {
+        rightTop = buildCacheAt(n.right, maxDepth, word, wordOf);
+    }
 
-    // sort the highFreqPair with overloaded comparator
-    // called sortComp
-    sort(highFreqPair.begin(), highFreqPair.end(), sortComp);
+    // record the completion list of the node, its layer is the length
+    // of the prefix above it
+    n.cacheSlot = NO_CACHE;
+    if (word.length() < maxDepth) {
+        n.cacheSlot = cacheBegin.size() - 1;
+        for (const RankedWord& w : completions) {
+            cacheIds.push_back(w.rank);
+        }
+        cacheBegin.push_back(cacheIds.size());
+    }
+    return mergeRanked(mergeRanked(leftTop, completions), rightTop);
+}
 
-    // check if the resulting highFreqPair has smaller length
-    // than the expected numCompletions
-    if (highFreqPair.size() < numCompletions) {
-        numCompletions = highFreqPair.size();
+/**
+ * Helper method for buildCacheAt to merge two sorted lists of words
+ */
+vector<DictionaryTrie::RankedWord> DictionaryTrie::mergeRanked(
+    const vector<RankedWord>& a, const vector<RankedWord>& b) const {
+    vector<RankedWord> merged;
+    merged.reserve(min<size_t>(a.size() + b.size(), cacheSize));
+    size_t i = 0;
+    size_t j = 0;
+    while (merged.size() < cacheSize && (i < a.size() || j < b.size())) {
+        // take from a if b is used up or a comes first
+        if (j == b.size() ||
+            (i < a.size() &&
+             (a[i].freq > b[j].freq ||
+              (a[i].freq == b[j].freq && a[i].rank < b[j].rank)))) {
+            merged.push_back(a[i++]);
+        } else {
+            merged.push_back(b[j++]);
+        }
     }
+    return merged;
+}
 
-    // push all most frequenct strings into the vecReturn
-    // string vector
-    for (int i = 0; i < numCompletions; i++) {
-        vecReturn.push_back(highFreqPair[i].first);
+/**
+ * Helper method for insert, updateFrequency and remove, called once
+ * word has changed: the completion cache is dropped, and so are the
+ * QueryCache answers for the prefixes of word.
+ */
+void DictionaryTrie::wordChanged(string_view word) {
+    clearCompletionCache();
+    if (resultCache) {
+        resultCache->invalidate(word);
     }
+}
 
-    return vecReturn;
+/**
+ * Keep up to capacity query answers, starting from an empty cache
+ */
+void DictionaryTrie::enableQueryCache(size_t capacity,
+                                      unsigned int numShards) {
+    resultCache.reset(new QueryCache(capacity, numShards));
 }
 
 /**
- * Helper method for the DictionaryTrie destructor
- * to delete all TrieNodes in the heap
- * */
-void DictionaryTrie::deleteAll(TrieNode* n) {
-    // base case
-    if (n == nullptr) {
+ * Release the QueryCache
+ */
+void DictionaryTrie::disableQueryCache() { resultCache.reset(); }
+
+/**
+ * Drop the completion cache and release its memory. The cacheSlot of
+ * the nodes is left stale, it is only read while cacheSize is not 0.
+ */
+void DictionaryTrie::clearCompletionCache() {
+    if (cacheSize == 0) {
         return;
     }
-    // if its left child is not a nullptr,then
-    // recurse to the left
-    if (n->left != nullptr) {
-        deleteAll(n->left);
-    }
-    // if its middle child is not a nullptr,then
-    // recurse to the middle
-    if (n->middle != nullptr) {
-        deleteAll(n->middle);
+    cacheSize = 0;
+    vector<string>().swap(cacheWords);
+    vector<unsigned int>().swap(cacheIds);
+    vector<unsigned int>().swap(cacheBegin);
+}
+
+/**
+ * Return the number of heap bytes used by the completion cache
+ */
+size_t DictionaryTrie::completionCacheMemory() const {
+    size_t bytes = cacheWords.capacity() * sizeof(string) +
+                   (cacheIds.capacity() + cacheBegin.capacity()) *
+                       sizeof(unsigned int);
+    for (const string& w : cacheWords) {
+        // short strings live inside the string object itself
+        const char* chars = w.data();
+        const char* object = reinterpret_cast<const char*>(&w);
+        if (chars < object || chars >= object + sizeof(string)) {
+            bytes += w.capacity() + 1;
+        }
     }
-    // if its right child is not a nullptr, then
-    // recurve to the right
-    if (n->right != nullptr) {
-        deleteAll(n->right);
+    return bytes;
+}
+
+/**
+ * Write the header and the node pool as it is, free slots included, so
+ * load gets back the same pool
+ */
+bool DictionaryTrie::save(const string& path) const {
+    if (art) {
+        return false;
     }
-    delete n;
-    return;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.nodeSize = sizeof(TrieNode);
+    header.numNodes = nodes.size();
+    header.numFree = numFree;
+    header.root = this->root;
+    header.freeList = freeList;
+
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(nodes.data()),
+              nodes.size() * sizeof(TrieNode));
+    return out.good();
 }
+
 /**
- * Destructor of DiectionaryTrie
- * Called deleteAll(TrieNode* n) helper method
- * and passed in the root
+ * The file size must match the header exactly, so a truncated file is
+ * caught before the pool is allocated. The nodes are read straight into
+ * a new pool, which replaces the old one once every link is checked:
+ * each must stay inside the pool, and no node may be reached twice
+ * from the root or the free list, which a cycle or a slot both in use
+ * and free would be. The free list must hold numFree slots.
  */
-DictionaryTrie::~DictionaryTrie() { deleteAll(this->root); }
\ No newline at end of file
+bool DictionaryTrie::load(const string& path) {
+    if (art) {
+        return false;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    SnapshotHeader header;
+    struct stat info;
+    bool valid = fstat(fd, &info) == 0 &&
+                 readAll(fd, &header, sizeof(header)) &&
+                 memcmp(header.magic, SNAPSHOT_MAGIC,
+                        sizeof(SNAPSHOT_MAGIC)) == 0 &&
+                 header.version == SNAPSHOT_VERSION &&
+                 header.nodeSize == sizeof(TrieNode) &&
+                 header.numNodes < NIL && header.numFree <= header.numNodes &&
+                 (uint64_t)info.st_size ==
+                     sizeof(header) + header.numNodes * sizeof(TrieNode);
+    vector<TrieNode> pool;
+    if (valid) {
+        pool.assign(header.numNodes, TrieNode(0));
+        valid = readAll(fd, pool.data(), pool.size() * sizeof(TrieNode));
+    }
+    ::close(fd);
+
+    auto inside = [&](uint32_t link) {
+        return link == NIL || link < pool.size();
+    };
+    valid = valid && inside(header.root) && inside(header.freeList);
+    for (size_t i = 0; valid && i < pool.size(); i++) {
+        valid = inside(pool[i].left) && inside(pool[i].middle) &&
+                inside(pool[i].right);
+        // the cache lists of the saved TST are not in the file
+        pool[i].cacheSlot = NO_CACHE;
+        memset(pool[i].pad, 0, sizeof(pool[i].pad));
+    }
+    vector<bool> seen(valid ? pool.size() : 0);
+    vector<uint32_t> stack;
+    if (valid && header.root != NIL) {
+        stack.push_back(header.root);
+    }
+    while (valid && !stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+        if (seen[node]) {
+            valid = false;
+            break;
+        }
+        seen[node] = true;
+        for (uint32_t child :
+             {pool[node].left, pool[node].middle, pool[node].right}) {
+            if (child != NIL) {
+                stack.push_back(child);
+            }
+        }
+    }
+    uint64_t freeSlots = 0;
+    for (uint32_t slot = header.freeList; valid && slot != NIL;
+         slot = pool[slot].middle) {
+        valid = !seen[slot];
+        seen[slot] = true;
+        freeSlots++;
+    }
+    valid = valid && freeSlots == header.numFree;
+    if (!valid) {
+        return false;
+    }
+    nodes.swap(pool);
+    this->root = header.root;
+    freeList = header.freeList;
+    numFree = header.numFree;
+    clearCompletionCache();
+    if (resultCache) {
+        resultCache->clear();
+    }
+    return true;
+}
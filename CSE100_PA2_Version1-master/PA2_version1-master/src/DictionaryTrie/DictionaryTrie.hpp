@@ -7,146 +7,518 @@
 #ifndef DICTIONARY_TRIE_HPP
 #define DICTIONARY_TRIE_HPP
 
+#include <cstdint>
+#include <memory>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
+#include "QueryCache.hpp"
+#include "ThreadPool.hpp"
 
 using namespace std;
 
+class ArtTrie;
+
 /**
  * The class for a dictionary ADT, implemented as either
  * a mulit-way trie or a ternary search tree.
+ * The engine chosen at construction keeps the words in the ternary
+ * search tree below (TST) or in an adaptive radix tree (ART).
  */
 class DictionaryTrie {
     // private:
     // TODO: add private members and helper methods here
   public:
+    // index of no node, used for missing children and an empty TST
+    static const uint32_t NIL = 0xFFFFFFFF;
+
     // create an inner class called TrieNode to be used
     // to construct a DictionaryTrie
+    // The nodes live in one pool owned by the DictionaryTrie and link to
+    // each other by their index in the pool, so a node is 28 bytes
+    // instead of 56 and the whole TST is freed at once.
     class TrieNode {
       public:
-        char data;
-        TrieNode* left;
-        TrieNode* middle;
-        TrieNode* right;
+        uint32_t left;
+        uint32_t middle;
+        uint32_t right;
         unsigned int freq;
         unsigned int highestFq;
-        bool visited;
-        // check if the current TrieNode is a
-        // middle child of its parent TrieNode
-        bool notmd;
-        bool md;
-        int layer;  // to record the layer of each TrieNode in a DictionaryTrie
+        // index of the completion cache list of this node, or NO_CACHE
+        unsigned int cacheSlot;
+        char data;
+        // the padding up to 28 bytes, zeroed so that save writes no
+        // stray bytes
+        char pad[3];
         TrieNode(char c);
     };
 
-    /* A constructor that only sets root to nullptr */
-    DictionaryTrie();
+    /**
+     * A node reached by the completion search, in the order the search
+     * reaches them, which is the alphabetical order of their words. The
+     * word of an entry is the word of entry up followed by the
+     * character of node, and entry 0 is the prefix itself.
+     */
+    struct TrailEntry {
+        uint32_t node;
+        uint32_t up;
+    };
+
+    /* A word of the top-k heap, known by its frequency and its entry in
+     * the trail, so a lower entry is an alphabetically smaller word */
+    struct Candidate {
+        unsigned int freq;
+        uint32_t rank;
+    };
+
+    /* A DFS step of the completion search: visit node, or with emit
+     * set, reach its word and descend into its middle child */
+    struct SearchStep {
+        uint32_t node;
+        uint32_t up;
+        bool emit;
+    };
+
+    /* A subtree the best-first search has yet to enter, or with word
+     * set, a word it has reached, known by its trail entry. bound is
+     * the highestFq of the subtree, or the frequency of the word. */
+    struct FrontierEntry {
+        unsigned int bound;
+        uint32_t node;
+        uint32_t up;
+        bool word;
+    };
+
+    /**
+     * Reusable buffers of one predictCompletions search. A thread that
+     * answers many queries keeps one, so the buffers keep their capacity
+     * from query to query instead of being allocated for every query.
+     */
+    struct SearchScratch {
+        // DFS stack of the search
+        vector<SearchStep> stack;
+        // the nodes reached so far
+        vector<TrailEntry> trail;
+        // top-k heap when numCompletions is above STACK_HEAP
+        vector<Candidate> heap;
+        // DFS stack of the ART engine
+        vector<uint32_t> refs;
+        // frontier heap of the best-first search
+        vector<FrontierEntry> frontier;
+    };
+
+    /**
+     * Counters of the work done by the searches that are handed one.
+     * They add up over calls until the caller resets them.
+     */
+    struct SearchStats {
+        // TST nodes looked at, including the walk down to a prefix
+        size_t nodesVisited = 0;
+        // subtrees the completion search did not enter because they
+        // could not hold a better word, counted once per subtree
+        size_t nodesPruned = 0;
+    };
+
+    /**
+     * A word and its frequency, as parsed from a dictionary file. The
+     * word points into memory owned by whoever parsed it.
+     */
+    struct Record {
+        string_view word;
+        unsigned int freq;
+    };
+
+    /* The structures a DictionaryTrie can keep its words in */
+    enum Engine { TST, ART };
+
+    /* The orders the TST completion search can walk the subtree of a
+     * prefix in */
+    enum SearchOrder { DEPTH_FIRST, BEST_FIRST };
+
+    /**
+     * A constructor that only sets root to NIL
+     * With engine ART the words are kept in an ArtTrie instead, and
+     * insert, bulkBuild, updateFrequency, remove, find, frequency,
+     * listWords, the searches and numNodes go to it. The completion
+     * cache and the snapshots only exist for the TST: with engine ART
+     * buildCompletionCache, save and load do nothing and return false.
+     */
+    DictionaryTrie(Engine engine = TST);
+
+    ~DictionaryTrie();
+    DictionaryTrie(DictionaryTrie&& other) noexcept;
+    DictionaryTrie& operator=(DictionaryTrie&& other) noexcept;
+
+    /* Return the engine chosen at construction */
+    Engine engine() const { return art ? ART : TST; }
+
+    /**
+     * Choose how predictCompletions searches the TST. DEPTH_FIRST, the
+     * default, walks the subtree of the prefix in alphabetical order and
+     * skips the subtrees whose highestFq cannot beat the worst word of
+     * its top-k heap. BEST_FIRST always enters the subtree of highest
+     * highestFq next, so words come out most frequent first and the
+     * search stops at the k-th word. The answers are the same. It is
+     * not changed while queries run, and the ART engine ignores it.
+     */
+    void setSearchOrder(SearchOrder order) { walkOrder = order; }
+
+    /* Return the order chosen with setSearchOrder */
+    SearchOrder searchOrder() const { return walkOrder; }
 
     /* Given a string and an unsigned int
      * Insert a copy of the string in the TST
      * Return true if the item was successfully added to this TST,
-     * false if the call does not input any word into this TST. */
-    bool insert(string word, unsigned int freq);
+     * false if the call does not input any word into this TST.
+     * The nodes passed are counted in stats if it is given.
+     * Like find, updateFrequency and remove, it reads the bytes of word
+     * where they are and copies nothing but the new nodes. */
+    bool insert(string_view word, unsigned int freq,
+                SearchStats* stats = nullptr);
+
+    /**
+     * Add records to this TST, sorting records on the way. Of the
+     * records of one word the first one wins, like with insert, and
+     * records with an empty word or frequency 0 are skipped. An empty
+     * TST is built directly from the sorted words, one character level
+     * at a time, with the median character of every sibling range as
+     * the root of its sibling BST, so the TST comes out balanced
+     * whatever the order of records. A TST that already holds words
+     * gets the records inserted medians first.
+     */
+    void bulkBuild(vector<Record>& records);
+
+    /**
+     * Set the frequency of word to freq, keeping the highestFq of every
+     * node up to date in O(depth). Return false if word is not in this
+     * TST. A frequency of 0 removes the word.
+     */
+    bool updateFrequency(string_view word, unsigned int freq);
+
+    /**
+     * Remove word from this TST, deleting the nodes that no longer lead
+     * to a word and keeping highestFq up to date in O(depth). Return
+     * false if word is not in this TST.
+     */
+    bool remove(string_view word);
 
     /**
      * Given a string word
      * Find the word in the TST.
      * Return true if the word is in the TST
      * Return false if the word is not in the TST
+     * The nodes passed are counted in stats if it is given.
+     * It allocates nothing.
      */
-    bool find(string word) const;
+    bool find(string_view word, SearchStats* stats = nullptr) const;
+
+    /* Return the frequency of word, or 0 if it is not in the TST */
+    unsigned int frequency(string_view word) const;
+
+    /**
+     * Return every word of the TST with its frequency, in alphabetical
+     * order, as records that bulkBuild takes. The words are spelled one
+     * after the other into text, which the records point into.
+     */
+    vector<Record> listWords(string& text) const;
 
     /**
      * Given a string "prefix" and an integer "numCompletions".
      * Return a vector that include the "numCompletions" most frequenct
      * words which start with string "prefix".
+     * The search keeps all of its state on its own stack, so any number
+     * of threads may call it at the same time while nobody inserts.
      */
     vector<string> predictCompletions(string prefix,
-                                      unsigned int numCompletions);
+                                      unsigned int numCompletions) const;
+
+    /* predictCompletions searching with the buffers in scratch, and
+     * counting the nodes visited in stats if it is given */
+    vector<string> predictCompletions(const string& prefix,
+                                      unsigned int numCompletions,
+                                      SearchScratch& scratch,
+                                      SearchStats* stats = nullptr) const;
+
+    /**
+     * predictCompletions writing the words into out instead of a new
+     * vector, and returning their number. out only grows: the first
+     * words are the answer and any entries after them are left over
+     * from earlier calls. The top-k heap holds frequencies and trail
+     * entries and lives on the stack for up to STACK_HEAP completions,
+     * and only the winning words are spelled out, into the strings
+     * already in out. Once out and scratch have grown to the size of
+     * the queries, a query allocates nothing.
+     */
+    size_t predictCompletions(const string& prefix,
+                              unsigned int numCompletions,
+                              SearchScratch& scratch, vector<string>& out,
+                              SearchStats* stats = nullptr) const;
+
+    /**
+     * Answer predictCompletions for every prefix in prefixes, spreading
+     * the queries over the workers of pool. The workers share the trie
+     * and each searches with its own SearchScratch, so nothing may
+     * insert while the batch runs. The i-th answer is for the i-th
+     * prefix.
+     */
+    vector<vector<string>> predictCompletionsBatch(
+        const vector<string>& prefixes, unsigned int numCompletions,
+        ThreadPool& pool) const;
+
+    /* The batch above on a pool of numThreads threads started for this
+     * call, one per hardware thread if numThreads is 0 */
+    vector<vector<string>> predictCompletionsBatch(
+        const vector<string>& prefixes, unsigned int numCompletions,
+        unsigned int numThreads = 0) const;
 
     /**
      * predictUnderscores() will return a vector holding up to
      * the most frequent numCompletions of valid completions of
      * pattern, which contains one or more '_'.
+     * A '_' matches any printable character other than '_' itself.
+     * The nodes visited are counted in stats if it is given.
      */
     vector<string> predictUnderscores(string pattern,
-                                      unsigned int numCompletions);
+                                      unsigned int numCompletions,
+                                      SearchStats* stats = nullptr) const;
 
     /**
-     * Destructor of DiectionaryTrie
-     * Called deleteAll(TrieNode* n) helper method
-     * and passed in the root
+     * Return the numCompletions most frequent words that start with a
+     * string within maxEdits edits (insertions, deletions and
+     * substitutions of one character) of prefix, ordered like
+     * predictCompletions. A word matching prefix exactly is only one of
+     * them and gets no priority.
      */
-    ~DictionaryTrie();
-
-    // instrance variable to DictionaryTrie
-    TrieNode* root;
-    int A = 32;
-    int DELETE = 127;
-    int UNDERSCORE = 95;
-    int BACKQUOTE = 96;
-    int TWO = 2;
+    vector<string> predictFuzzy(const string& prefix, unsigned int maxEdits,
+                                unsigned int numCompletions) const;
 
     /**
-     * Helper method for the DictionaryTrie destructor
-     * to delete all TrieNodes in the heap
-     * */
-    static void deleteAll(TrieNode* n);
+     * Precompute, at every node of the first maxDepth layers, the
+     * cacheSize most frequent words completing the prefix that ends at
+     * the node. predictCompletions then answers a prefix of at most
+     * maxDepth characters with a prefix walk and a copy of the cached
+     * list, as long as numCompletions is at most cacheSize. Lists hold
+     * word ids, and only the words that appear in some list are kept.
+     * The next successful insert drops the cache. Return false, building
+     * nothing, with engine ART, which has no TST nodes to keep the
+     * lists at; enableQueryCache works with both engines.
+     */
+    bool buildCompletionCache(unsigned int cacheSize, unsigned int maxDepth);
+
+    /* Drop the completion cache and release its memory */
+    void clearCompletionCache();
+
+    /* Return the number of heap bytes used by the completion cache */
+    size_t completionCacheMemory() const;
 
     /**
-     * help method of "predictCompletions"
-     * set the visited value of all nodes of the TST false
+     * Keep the answers of up to capacity recent predictCompletions
+     * queries in a QueryCache of numShards shards, which the queries
+     * look in before searching. Unlike the completion cache it works
+     * with both engines, fills up with the prefixes that are actually
+     * asked for, and survives changes: insert, updateFrequency and
+     * remove only drop the answers for the prefixes of their word, and
+     * bulkBuild drops all of them. Enabling it again starts empty.
+     * A query the cache misses allocates to store its answer.
      */
-    void cleanVisited();
+    void enableQueryCache(size_t capacity, unsigned int numShards = 16);
+
+    /* Stop caching query answers and release the QueryCache */
+    void disableQueryCache();
+
+    /* Return the QueryCache, or nullptr if it is not enabled */
+    const QueryCache* queryCache() const { return resultCache.get(); }
 
     /**
-     * Helper method used in backtrack() to check if the input string
-     * does exist in the DictionaryTrie. It will return a pointer
-     * to a pair with a TrieNode pointer as the first part and a
-     * boolean as the second part. If the string does exist, the
-     * boolean part will be true. Otherwise, it will be false.
-     * */
-    pair<TrieNode*, bool> existed(string curString);
+     * Write the node pool to the file at path as a snapshot: a header
+     * with a magic string, SNAPSHOT_VERSION, the size of a node, the
+     * root and the free list, followed by the nodes as they are in
+     * memory, frequencies and highestFq included. The byte order is the
+     * one of this machine. Return false if the file cannot be written,
+     * or with engine ART, which has no node pool to write.
+     */
+    bool save(const string& path) const;
 
     /**
-     * Helper method for predictUnderscore method.
-     * This method find valid strings to the input PatternVP
-     * by trying all possible combinations recursively.
-     * It will populate the result with all valid strings.
-     * */
-    void backtrack(vector<pair<string, unsigned int>>& result, int curIndex,
-                   int maxLen, string curString,
-                   vector<pair<int, char>> PatternVP);
+     * Replace the words of this TST with the snapshot at path, reading
+     * the nodes into the pool with one read and no rebuilding. The
+     * caches are dropped. Return false, leaving the TST as it was, if
+     * the file is not a snapshot of this version and node size, if a
+     * link of a node points outside the pool, or with engine ART.
+     */
+    bool load(const string& path);
+
+    // version of the snapshot format of save and load
+    static const uint32_t SNAPSHOT_VERSION = 1;
+
+    /* Return the node at index i of the pool */
+    const TrieNode& getNode(uint32_t i) const { return nodes[i]; }
+
+    /* Return the number of nodes in the TST, or of inner nodes and
+     * leaves in the ArtTrie with engine ART */
+    size_t numNodes() const;
+
+    /* Return the number of heap bytes reserved by the node pool, or by
+     * the ArtTrie with engine ART */
+    size_t nodeMemory() const;
+
+    // largest numCompletions whose top-k heap is kept on the stack
+    static const unsigned int STACK_HEAP = 32;
+
+    // instrance variable to DictionaryTrie, the index of the root node
+    uint32_t root;
+    static const int A = 32;
+    static const int DELETE = 127;
+    static const int UNDERSCORE = 95;
+    static const int BACKQUOTE = 96;
+    static const int TWO = 2;
+
+    /* Return true if a '_' in a pattern matches the character c */
+    static bool matchesUnderscore(char c);
+
+    /* The order of the characters of sibling nodes: bytes compared as
+     * unsigned, like std::string compares them, so an in-order walk of
+     * the TST lists the words alphabetically */
+    static bool charLess(char a, char b) {
+        return (unsigned char)a < (unsigned char)b;
+    }
 
     /**
      * helper method of main to set the highestFq of each node
+     * insert, updateFrequency and remove keep highestFq up to date, so
+     * this full pass is only needed to check or rebuild it.
      */
-    void highestFreq(TrieNode* node);
+    void highestFreq(uint32_t node);
     struct compare {
-        bool operator()(pair<string, int>* a, pair<string, int>* b) const {
-            if (a->second != b->second) {
-                return (a->second > b->second);
+        bool operator()(const pair<string, int>& a,
+                        const pair<string, int>& b) const {
+            if (a.second != b.second) {
+                return (a.second > b.second);
             } else {
-                return (a->first < b->first);
+                return (a.first < b.first);
             }
         }
     };
 
     /**
-     * helper method to control the size of the priority_queue
+     * helper method to control the size of the top-k heap
      */
-    void pd_fixed(priority_queue<pair<string, int>*, vector<pair<string, int>*>,
-                                 compare>& pq,
-                  int numCompletions, pair<string, int>* currPair);
+    static void pd_fixed(vector<pair<string, int>>& heap,
+                         unsigned int numCompletions, const string& word,
+                         int freq);
 
     /**
      * Helper method for predictCompletion to find the last index of
-     * the prefix in the DictionaryTrie and return the corresponding
-     * TrieNode* to predictCompletion.
+     * the prefix in the DictionaryTrie and return the index of the
+     * corresponding TrieNode to predictCompletion, or NIL.
      * */
-    TrieNode* findPrefix(string prefix);
+    uint32_t findPrefix(string_view prefix,
+                        SearchStats* stats = nullptr) const;
+
+  private:
+    // the ART engine, nullptr with engine TST
+    unique_ptr<ArtTrie> art;
+
+    // recent query answers, nullptr unless enableQueryCache was called
+    unique_ptr<QueryCache> resultCache;
+
+    // how searchCompletions walks the TST
+    SearchOrder walkOrder;
+
+    /* predictCompletions into out without looking at resultCache */
+    size_t searchCompletions(const string& prefix,
+                             unsigned int numCompletions,
+                             SearchScratch& scratch, vector<string>& out,
+                             SearchStats* stats) const;
+
+    /* searchCompletions in BEST_FIRST order, below the node found for
+     * prefix */
+    size_t searchBestFirst(const string& prefix, uint32_t found,
+                           unsigned int numCompletions,
+                           SearchScratch& scratch, vector<string>& out,
+                           SearchStats* stats) const;
+
+    /* Drop what the caches know about word after it changed */
+    void wordChanged(string_view word);
+
+    // the node pool, node i is nodes[i]
+    vector<TrieNode> nodes;
+
+    // head of the list of removed node slots, linked through 'middle'
+    uint32_t freeList;
+
+    // number of slots in the free list
+    size_t numFree;
+
+    /* Take a slot from the free list or the end of the pool, store a
+     * node for c in it and return its index. The pool may move. */
+    uint32_t newNode(char c);
+
+    /* Fill path with the nodes from the root to the last character of
+     * word and return that node, or NIL if word is not a word */
+    uint32_t findPath(string_view word, vector<uint32_t>& path) const;
+
+    /* Raise the highestFq of every node from the root to the last
+     * character of word, which is in the TST, to at least freq */
+    void raiseHighestFq(string_view word, unsigned int freq);
+
+    /* Recompute the highestFq of every node of path, bottom up */
+    void repairHighestFq(const vector<uint32_t>& path);
+
+    /* Build the sibling BST of the records [lo, hi), which are sorted,
+     * share their first depth characters and are longer than that, and
+     * return its root */
+    uint32_t buildLevel(const vector<Record>& records, size_t lo, size_t hi,
+                        size_t depth);
+
+    /* Build the sibling BST of the character groups [first, last) of
+     * buildLevel, the records of group g being [starts[g],
+     * starts[g + 1]), and return its root */
+    uint32_t buildSiblings(const vector<Record>& records,
+                           const vector<size_t>& starts, size_t first,
+                           size_t last, size_t depth);
+
+    /* Insert the records [start, end), the median of every range before
+     * the two halves around it */
+    void insertMedians(const vector<Record>& records, size_t start,
+                       size_t end);
+
+    // cacheSlot of a node that has no completion cache list
+    static const unsigned int NO_CACHE = 0xFFFFFFFF;
+
+    /* A word known by its frequency and its rank in alphabetical order */
+    struct RankedWord {
+        unsigned int freq;
+        unsigned int rank;
+    };
+
+    // number of completions kept per cached node, 0 if there is no cache
+    unsigned int cacheSize;
+
+    // the words referenced by the cache, indexed by word id
+    vector<string> cacheWords;
+
+    // the list of cache slot s is cacheIds[cacheBegin[s], cacheBegin[s+1])
+    vector<unsigned int> cacheIds;
+    vector<unsigned int> cacheBegin;
+
+    /**
+     * Helper method for buildCompletionCache. Rank the words of the
+     * subtree of node in alphabetical order, record the completion list
+     * of every node above maxDepth and return the cacheSize most
+     * frequent words of the whole subtree. word holds the prefix spelled
+     * by the path to node, so its length is the layer of node, and
+     * wordOf collects every word by rank.
+     */
+    vector<RankedWord> buildCacheAt(uint32_t node, unsigned int maxDepth,
+                                    string& word, vector<string>& wordOf);
+
+    /* Merge two lists ordered by decreasing frequency, then by rank, and
+     * keep the first cacheSize entries */
+    vector<RankedWord> mergeRanked(const vector<RankedWord>& a,
+                                   const vector<RankedWord>& b) const;
 };
 
 #endif  // DICTIONARY_TRIE_HPP
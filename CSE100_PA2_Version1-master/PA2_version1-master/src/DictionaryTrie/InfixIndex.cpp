@@ -0,0 +1,241 @@
+/**
+ * This file implements the substring index declared in InfixIndex.hpp.
+ */
+#include "InfixIndex.hpp"
+#include <algorithm>
+#include <queue>
+
+/**
+ * Create an empty index
+ */
+InfixIndex::InfixIndex() { starts.push_back(0); }
+
+/**
+ * Sort and dedupe the records, lay the phrases out in text, sort every
+ * position of text by its suffix, then key the suffixes and build the
+ * sparse table over their blocks.
+ */
+void InfixIndex::build(vector<DictionaryTrie::Record>& records) {
+    records.erase(remove_if(records.begin(), records.end(),
+                            [](const DictionaryTrie::Record& r) {
+                                return r.word.empty() || r.freq == 0 ||
+                                       r.word.find('\n') != string::npos;
+                            }),
+                  records.end());
+    stable_sort(records.begin(), records.end(),
+                [](const DictionaryTrie::Record& a,
+                   const DictionaryTrie::Record& b) {
+                    return a.word < b.word;
+                });
+    records.erase(unique(records.begin(), records.end(),
+                         [](const DictionaryTrie::Record& a,
+                            const DictionaryTrie::Record& b) {
+                             return a.word == b.word;
+                         }),
+                  records.end());
+
+    text.clear();
+    starts.assign(1, 0);
+    freqs.clear();
+    for (const DictionaryTrie::Record& r : records) {
+        text.append(r.word.data(), r.word.size());
+        text += '\n';
+        starts.push_back(text.size());
+        freqs.push_back(r.freq);
+    }
+
+    // every position but the '\n' ending its phrase, with its phrase
+    vector<uint32_t> phraseAt(text.size());
+    suffixes.clear();
+    suffixes.reserve(text.size() - freqs.size());
+    for (uint32_t p = 0; p < freqs.size(); p++) {
+        for (uint32_t at = starts[p]; at + 1 < starts[p + 1]; at++) {
+            suffixes.push_back(at);
+            phraseAt[at] = p;
+        }
+    }
+
+    // a suffix ends at its '\n', which sorts before every other byte
+    const char* chars = text.data();
+    sort(suffixes.begin(), suffixes.end(), [chars](uint32_t a, uint32_t b) {
+        while (chars[a] == chars[b]) {
+            if (chars[a] == '\n') {
+                return false;
+            }
+            a++;
+            b++;
+        }
+        if (chars[a] == '\n' || chars[b] == '\n') {
+            return chars[a] == '\n';
+        }
+        return (unsigned char)chars[a] < (unsigned char)chars[b];
+    });
+
+    keys.resize(suffixes.size());
+    for (size_t i = 0; i < suffixes.size(); i++) {
+        uint32_t p = phraseAt[suffixes[i]];
+        keys[i] = (uint64_t(freqs[p]) << 32) | (0xFFFFFFFF - p);
+    }
+
+    size_t numBlocks = (keys.size() + BLOCK - 1) / BLOCK;
+    table.assign(1, vector<uint32_t>(numBlocks));
+    for (size_t b = 0; b < numBlocks; b++) {
+        table[0][b] = scan(b * BLOCK, min(keys.size(), (b + 1) * BLOCK));
+    }
+    for (size_t j = 1; (size_t(1) << j) <= numBlocks; j++) {
+        const vector<uint32_t>& half = table[j - 1];
+        size_t width = size_t(1) << j;
+        vector<uint32_t> level(numBlocks - width + 1);
+        for (size_t b = 0; b < level.size(); b++) {
+            uint32_t a = half[b];
+            uint32_t c = half[b + width / 2];
+            level[b] = keys[a] >= keys[c] ? a : c;
+        }
+        table.push_back(move(level));
+    }
+}
+
+/**
+ * Helper method for bestIn, a plain scan
+ */
+uint32_t InfixIndex::scan(size_t lo, size_t hi) const {
+    size_t best = lo;
+    for (size_t i = lo + 1; i < hi; i++) {
+        if (keys[i] > keys[best]) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * The partial blocks at both ends are scanned and the whole blocks in
+ * between are covered by two overlapping entries of the sparse table
+ */
+uint32_t InfixIndex::bestIn(size_t lo, size_t hi) const {
+    size_t first = lo / BLOCK;
+    size_t last = (hi - 1) / BLOCK;
+    if (first == last) {
+        return scan(lo, hi);
+    }
+    uint32_t best = scan(lo, (first + 1) * BLOCK);
+    uint32_t right = scan(last * BLOCK, hi);
+    if (keys[right] > keys[best]) {
+        best = right;
+    }
+    if (first + 1 < last) {
+        size_t count = last - first - 1;
+        size_t j = 63 - __builtin_clzll(count);
+        uint32_t a = table[j][first + 1];
+        uint32_t b = table[j][last - (size_t(1) << j)];
+        if (keys[a] > keys[best]) {
+            best = a;
+        }
+        if (keys[b] > keys[best]) {
+            best = b;
+        }
+    }
+    return best;
+}
+
+/**
+ * Binary search for the suffixes whose first substring.size() bytes
+ * are substring. A suffix reaching the end of its phrase before that
+ * is below substring, like a shorter string.
+ */
+pair<size_t, size_t> InfixIndex::range(string_view substring) const {
+    const char* chars = text.data();
+    auto compare = [&](uint32_t at) {
+        for (size_t i = 0; i < substring.size(); i++) {
+            char c = chars[at + i];
+            if (c == '\n') {
+                return -1;
+            }
+            if (c != substring[i]) {
+                return (unsigned char)c < (unsigned char)substring[i] ? -1
+                                                                       : 1;
+            }
+        }
+        return 0;
+    };
+    size_t lo = partition_point(suffixes.begin(), suffixes.end(),
+                                [&](uint32_t at) { return compare(at) < 0; }) -
+                suffixes.begin();
+    size_t hi = partition_point(suffixes.begin() + lo, suffixes.end(),
+                                [&](uint32_t at) { return compare(at) == 0; }) -
+                suffixes.begin();
+    return {lo, hi};
+}
+
+/**
+ * Pop the part of the range with the best key, report the phrase of
+ * that key and push the parts on both sides of it. Keys only go down
+ * from pop to pop and a phrase has one key, so the places of a phrase
+ * holding the substring more than once pop one after another.
+ */
+vector<string> InfixIndex::predictInfix(const string& substring,
+                                        unsigned int numCompletions) const {
+    vector<string> found;
+    if (substring.empty() || numCompletions == 0) {
+        return found;
+    }
+    pair<size_t, size_t> all = range(substring);
+    if (all.first == all.second) {
+        return found;
+    }
+
+    struct Part {
+        uint64_t key;
+        uint32_t lo;
+        uint32_t hi;
+        uint32_t best;
+        bool operator<(const Part& other) const { return key < other.key; }
+    };
+    priority_queue<Part> parts;
+    auto push = [&](size_t lo, size_t hi) {
+        if (lo < hi) {
+            uint32_t best = bestIn(lo, hi);
+            parts.push({keys[best], uint32_t(lo), uint32_t(hi), best});
+        }
+    };
+    push(all.first, all.second);
+    uint32_t last = 0xFFFFFFFF;
+    while (!parts.empty() && found.size() < numCompletions) {
+        Part part = parts.top();
+        parts.pop();
+        uint32_t p = phraseOf(part.key);
+        if (p != last) {
+            found.emplace_back(text, starts[p], starts[p + 1] - starts[p] - 1);
+            last = p;
+        }
+        push(part.lo, part.best);
+        push(part.best + 1, part.hi);
+    }
+    return found;
+}
+
+/**
+ * Return the size of the range of substring
+ */
+size_t InfixIndex::countOccurrences(const string& substring) const {
+    if (substring.empty()) {
+        return 0;
+    }
+    pair<size_t, size_t> all = range(substring);
+    return all.second - all.first;
+}
+
+/**
+ * Return the bytes of the text, the arrays and the sparse table
+ */
+size_t InfixIndex::memoryUsage() const {
+    size_t bytes = text.capacity() +
+                   (starts.capacity() + suffixes.capacity()) *
+                       sizeof(uint32_t) +
+                   freqs.capacity() * sizeof(unsigned int) +
+                   keys.capacity() * sizeof(uint64_t);
+    for (const vector<uint32_t>& level : table) {
+        bytes += level.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,104 @@
+/**
+ * This file defines a suffix array index over dictionary phrases that
+ * answers the most frequent phrases containing a substring, next to
+ * DictionaryTrie, which only answers prefixes.
+ */
+#ifndef INFIX_INDEX_HPP
+#define INFIX_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DictionaryTrie.hpp"
+
+using namespace std;
+
+/**
+ * The phrases are kept back to back in one string, each ended by a
+ * '\n', and the suffix array lists every position inside a phrase in
+ * the order of the suffix starting there, read up to the end of its
+ * phrase. The phrases containing a substring are then the phrases of
+ * one range of the suffix array, found by binary search.
+ *
+ * Phrases are numbered in alphabetical order, and every position of the
+ * suffix array has a key made of the frequency and the number of its
+ * phrase, so the best key of a range is the phrase predictCompletions
+ * would list first. A range maximum query structure finds it without
+ * looking at the range: a sparse table over the best key of every block
+ * of BLOCK positions, plus a scan of the partial blocks at both ends.
+ * The top k are taken by splitting the range around each best position,
+ * best part first, so a query costs O(k log k) range queries and never
+ * lists all matches. A phrase holding the substring twice is reported
+ * once.
+ */
+class InfixIndex {
+  public:
+    /* Create an empty index */
+    InfixIndex();
+
+    /**
+     * Index records, replacing what was indexed before. Like
+     * DictionaryTrie::bulkBuild, records is sorted, the first record of
+     * a phrase wins and records with an empty phrase or frequency 0 are
+     * skipped. A phrase holding a '\n' is skipped too. The phrases are
+     * copied.
+     */
+    void build(vector<DictionaryTrie::Record>& records);
+
+    /**
+     * Return the numCompletions most frequent phrases that contain
+     * substring, ordered like predictCompletions orders them. An empty
+     * substring matches nothing.
+     */
+    vector<string> predictInfix(const string& substring,
+                                unsigned int numCompletions) const;
+
+    /* Return the number of places substring occurs at in all phrases */
+    size_t countOccurrences(const string& substring) const;
+
+    /* Return the number of phrases */
+    size_t numPhrases() const { return freqs.size(); }
+
+    /* Return the number of heap bytes reserved by the index */
+    size_t memoryUsage() const;
+
+  private:
+    // positions per block of the range maximum query
+    static const size_t BLOCK = 32;
+
+    // the phrases, each followed by '\n'
+    string text;
+
+    // phrase i is text[starts[i], starts[i + 1] - 1)
+    vector<uint32_t> starts;
+    vector<unsigned int> freqs;
+
+    // positions of text in the order of their suffixes
+    vector<uint32_t> suffixes;
+
+    // key of every position of suffixes: the frequency of its phrase in
+    // the high half, and the complement of the phrase number below
+    vector<uint64_t> keys;
+
+    // table[j][b] is the position of the best key of blocks [b, b + 2^j)
+    vector<vector<uint32_t>> table;
+
+    /* Return the number of the phrase of a key */
+    uint32_t phraseOf(uint64_t key) const {
+        return 0xFFFFFFFF - uint32_t(key);
+    }
+
+    /* Return the position of the best key in [lo, hi) of one block or
+     * less */
+    uint32_t scan(size_t lo, size_t hi) const;
+
+    /* Return the position of the best key in [lo, hi), not empty */
+    uint32_t bestIn(size_t lo, size_t hi) const;
+
+    /* Return the range of suffixes starting with substring */
+    pair<size_t, size_t> range(string_view substring) const;
+};
+
+#endif  // INFIX_INDEX_HPP
@@ -0,0 +1,317 @@
+/**
+ * This file implements the layered dictionary declared in
+ * LayeredDictionary.hpp.
+ */
+#include "LayeredDictionary.hpp"
+#include <algorithm>
+#include <climits>
+#include <mutex>
+#include <utility>
+
+/**
+ * Make base the bottom layer, under an empty active delta
+ */
+LayeredDictionary::LayeredDictionary(DictionaryTrie base,
+                                     size_t compactThreshold)
+    : base(make_shared<const DictionaryTrie>(move(base))),
+      compactThreshold(compactThreshold),
+      compactions(0) {}
+
+/**
+ * Join the compaction thread, which needs the dictionary until it has
+ * swapped in its base
+ */
+LayeredDictionary::~LayeredDictionary() { waitForCompaction(); }
+
+/**
+ * Look for word in the deltas from the top, then in the base. A removal
+ * decides as much as a frequency does.
+ */
+unsigned int LayeredDictionary::resolve(string_view word, int& owner,
+                                        int top) const {
+    const Delta* deltas[] = {&active, frozen.get()};
+    for (int layer = top; layer < BASE; layer++) {
+        const Delta* delta = deltas[layer];
+        if (delta == nullptr) {
+            continue;
+        }
+        if (delta->removed.find(word) != delta->removed.end()) {
+            owner = -1;
+            return 0;
+        }
+        unsigned int freq = delta->words.frequency(word);
+        if (freq != 0) {
+            owner = layer;
+            return freq;
+        }
+    }
+    unsigned int freq = base->frequency(word);
+    owner = freq != 0 ? BASE : -1;
+    return freq;
+}
+
+/**
+ * Add word to the active delta if no layer holds it, taking back a
+ * removal of it
+ */
+bool LayeredDictionary::insert(string_view word, unsigned int freq) {
+    lock_guard<mutex> queue(turnstile);
+    unique_lock<shared_mutex> guard(lock);
+    int owner;
+    if (word.empty() || freq == 0 || resolve(word, owner) != 0) {
+        return false;
+    }
+    auto removal = active.removed.find(word);
+    if (removal != active.removed.end()) {
+        active.removed.erase(removal);
+    }
+    active.words.insert(word, freq);
+    active.numWords++;
+    if (compactThreshold != 0 &&
+        active.numWords + active.removed.size() >= compactThreshold) {
+        freezeAndCompact();
+    }
+    return true;
+}
+
+/**
+ * Give word its new frequency in the active delta, where it shadows
+ * the frequency of the layers below
+ */
+bool LayeredDictionary::updateFrequency(string_view word,
+                                        unsigned int freq) {
+    lock_guard<mutex> queue(turnstile);
+    unique_lock<shared_mutex> guard(lock);
+    int owner;
+    if (resolve(word, owner) == 0) {
+        return false;
+    }
+    if (freq == 0) {
+        return removeLocked(word);
+    }
+    if (owner == ACTIVE) {
+        active.words.updateFrequency(word, freq);
+        return true;
+    }
+    active.words.insert(word, freq);
+    active.numWords++;
+    if (compactThreshold != 0 &&
+        active.numWords + active.removed.size() >= compactThreshold) {
+        freezeAndCompact();
+    }
+    return true;
+}
+
+/**
+ * Remove word with the lock held exclusively
+ */
+bool LayeredDictionary::remove(string_view word) {
+    lock_guard<mutex> queue(turnstile);
+    unique_lock<shared_mutex> guard(lock);
+    return removeLocked(word);
+}
+
+/**
+ * Drop word from the active delta, and record its removal if a layer
+ * below still holds it
+ */
+bool LayeredDictionary::removeLocked(string_view word) {
+    int owner;
+    if (resolve(word, owner) == 0) {
+        return false;
+    }
+    if (owner == ACTIVE) {
+        active.words.remove(word);
+        active.numWords--;
+    }
+    if (resolve(word, owner, FROZEN) != 0) {
+        active.removed.emplace(word);
+        if (compactThreshold != 0 &&
+            active.numWords + active.removed.size() >= compactThreshold) {
+            freezeAndCompact();
+        }
+    }
+    return true;
+}
+
+/**
+ * Return true if the layer that decides word holds it
+ */
+bool LayeredDictionary::find(string_view word) const {
+    return frequency(word) != 0;
+}
+
+/**
+ * Return the frequency of word in the layer that decides it
+ */
+unsigned int LayeredDictionary::frequency(string_view word) const {
+    shared_lock<shared_mutex> guard = readLock();
+    int owner;
+    return resolve(word, owner);
+}
+
+/**
+ * Merge the best completions of every layer
+ */
+vector<string> LayeredDictionary::predictCompletions(
+    const string& prefix, unsigned int numCompletions) const {
+    shared_lock<shared_mutex> guard = readLock();
+    return merge(
+        [&](const DictionaryTrie& trie, unsigned int num) {
+            return trie.predictCompletions(prefix, num);
+        },
+        numCompletions);
+}
+
+/**
+ * Merge the best matches of every layer
+ */
+vector<string> LayeredDictionary::predictUnderscores(
+    const string& pattern, unsigned int numCompletions) const {
+    shared_lock<shared_mutex> guard = readLock();
+    return merge(
+        [&](const DictionaryTrie& trie, unsigned int num) {
+            return trie.predictUnderscores(pattern, num);
+        },
+        numCompletions);
+}
+
+/**
+ * The words a layer decides are in the order of its answer, so the
+ * first numCompletions of them are its share of the answer. They are
+ * sorted together with the shares of the other layers like
+ * predictCompletions sorts its words.
+ */
+vector<string> LayeredDictionary::merge(
+    const function<vector<string>(const DictionaryTrie&, unsigned int)>& ask,
+    unsigned int numCompletions) const {
+    const DictionaryTrie* layers[] = {
+        &active.words, frozen ? &frozen->words : nullptr, base.get()};
+    vector<pair<unsigned int, string>> all;
+    for (int layer = ACTIVE; layer <= BASE; layer++) {
+        if (layers[layer] == nullptr || numCompletions == 0) {
+            continue;
+        }
+        unsigned int num = numCompletions;
+        while (true) {
+            vector<string> words = ask(*layers[layer], num);
+            size_t start = all.size();
+            for (string& word : words) {
+                int owner;
+                unsigned int freq = resolve(word, owner);
+                if (owner == layer &&
+                    all.size() - start < numCompletions) {
+                    all.push_back(make_pair(freq, move(word)));
+                }
+            }
+            if (all.size() - start == numCompletions ||
+                words.size() < num || num == UINT_MAX) {
+                break;
+            }
+            // too many of the words were decided above, ask for more
+            all.resize(start);
+            num = num > UINT_MAX / 2 ? UINT_MAX : 2 * num;
+        }
+    }
+    size_t count = min<size_t>(numCompletions, all.size());
+    partial_sort(all.begin(), all.begin() + count, all.end(),
+                 [](const pair<unsigned int, string>& a,
+                    const pair<unsigned int, string>& b) {
+                     if (a.first != b.first) {
+                         return a.first > b.first;
+                     }
+                     return a.second < b.second;
+                 });
+    vector<string> merged;
+    for (size_t i = 0; i < count; i++) {
+        merged.push_back(move(all[i].second));
+    }
+    return merged;
+}
+
+/**
+ * Start a compaction with the lock held
+ */
+bool LayeredDictionary::startCompaction() {
+    lock_guard<mutex> queue(turnstile);
+    unique_lock<shared_mutex> guard(lock);
+    return freezeAndCompact();
+}
+
+/**
+ * The active delta becomes the frozen one and an empty delta takes its
+ * place, so queries see the same words before and after
+ */
+bool LayeredDictionary::freezeAndCompact() {
+    if (frozen || (active.numWords == 0 && active.removed.empty())) {
+        return false;
+    }
+    if (compactor.joinable()) {
+        compactor.detach();
+    }
+    frozen = make_shared<const Delta>(move(active));
+    active = Delta();
+    compactor = thread(&LayeredDictionary::compact, this, base, frozen);
+    return true;
+}
+
+/**
+ * Take the thread of the last compaction out under the lock, and join
+ * it without the lock, which it needs to swap in its base
+ */
+void LayeredDictionary::waitForCompaction() {
+    thread last;
+    {
+        lock_guard<mutex> queue(turnstile);
+        unique_lock<shared_mutex> guard(lock);
+        last = move(compactor);
+    }
+    if (last.joinable()) {
+        last.join();
+    }
+}
+
+/**
+ * Run on the compaction thread. The words of the delta come first in
+ * the records, so bulkBuild keeps them over the base words they
+ * shadow, and the base words the delta removed are left out. The next
+ * base uses the engine of the old one. Only the swap takes the lock;
+ * the old base is freed after it, when the last reference goes.
+ */
+void LayeredDictionary::compact(shared_ptr<const DictionaryTrie> oldBase,
+                                shared_ptr<const Delta> delta) {
+    string deltaText;
+    string baseText;
+    vector<DictionaryTrie::Record> records =
+        delta->words.listWords(deltaText);
+    for (const DictionaryTrie::Record& r : oldBase->listWords(baseText)) {
+        if (delta->removed.find(r.word) == delta->removed.end()) {
+            records.push_back(r);
+        }
+    }
+    shared_ptr<DictionaryTrie> next =
+        make_shared<DictionaryTrie>(oldBase->engine());
+    next->bulkBuild(records);
+
+    lock_guard<mutex> queue(turnstile);
+    unique_lock<shared_mutex> guard(lock);
+    base = move(next);
+    frozen.reset();
+    compactions++;
+}
+
+/**
+ * Return the size of the active delta
+ */
+size_t LayeredDictionary::deltaSize() const {
+    shared_lock<shared_mutex> guard = readLock();
+    return active.numWords + active.removed.size();
+}
+
+/**
+ * Return the number of finished compactions
+ */
+size_t LayeredDictionary::numCompactions() const {
+    shared_lock<shared_mutex> guard = readLock();
+    return compactions;
+}
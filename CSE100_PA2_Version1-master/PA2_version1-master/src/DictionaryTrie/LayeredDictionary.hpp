@@ -0,0 +1,174 @@
+/**
+ * This file defines a dictionary made of a large read-only base
+ * DictionaryTrie and a small mutable delta on top of it, which is
+ * folded into a new base in the background.
+ */
+#ifndef LAYERED_DICTIONARY_HPP
+#define LAYERED_DICTIONARY_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "DictionaryTrie.hpp"
+
+using namespace std;
+
+/**
+ * The words are kept in layers. The base is a DictionaryTrie that never
+ * changes once it is a base, so it can be bulk built or loaded from a
+ * snapshot. Updates go to the active delta: a small DictionaryTrie of
+ * the words added or given a new frequency since the base was built,
+ * and the set of words removed from the layers below it. The layer
+ * nearest the top that knows a word decides its frequency.
+ *
+ * A compaction freezes the active delta, starts an empty one above it,
+ * and builds the next base from the old base and the frozen delta on a
+ * thread of its own. Queries and updates go on meanwhile with the
+ * frozen delta as a third layer, and only wait for the new base to be
+ * swapped in. A compaction starts by itself when the active delta
+ * holds compactThreshold words and removals, unless that is 0.
+ *
+ * Queries may run concurrently with each other and with one updating
+ * thread: they take a shared lock, and updates an exclusive one for
+ * the time of one change to the delta. An update waiting for the lock
+ * holds new queries back, so a steady stream of queries cannot starve
+ * it.
+ */
+class LayeredDictionary {
+  public:
+    /* Create a dictionary whose base is base, with compaction started
+     * by hand if compactThreshold is 0. Every later base uses the
+     * engine of base. */
+    explicit LayeredDictionary(DictionaryTrie base = DictionaryTrie(),
+                               size_t compactThreshold = 0);
+
+    /* Wait for a running compaction */
+    ~LayeredDictionary();
+
+    LayeredDictionary(const LayeredDictionary&) = delete;
+    LayeredDictionary& operator=(const LayeredDictionary&) = delete;
+
+    /* Same as DictionaryTrie::insert, into the active delta. A word of
+     * frequency 0 is not added. */
+    bool insert(string_view word, unsigned int freq);
+
+    /* Same as DictionaryTrie::updateFrequency, recording the new
+     * frequency in the active delta */
+    bool updateFrequency(string_view word, unsigned int freq);
+
+    /* Same as DictionaryTrie::remove, recording the removal in the
+     * active delta if a layer below holds word */
+    bool remove(string_view word);
+
+    /* Same as DictionaryTrie::find, in the layer that decides */
+    bool find(string_view word) const;
+
+    /* Same as DictionaryTrie::frequency, in the layer that decides */
+    unsigned int frequency(string_view word) const;
+
+    /* Same as DictionaryTrie::predictCompletions, merging the top words
+     * of every layer */
+    vector<string> predictCompletions(const string& prefix,
+                                      unsigned int numCompletions) const;
+
+    /* Same as DictionaryTrie::predictUnderscores, merging the top words
+     * of every layer */
+    vector<string> predictUnderscores(const string& pattern,
+                                      unsigned int numCompletions) const;
+
+    /**
+     * Freeze the active delta and build the next base from it on a
+     * background thread. Return false if the active delta is empty or
+     * the previous compaction is still running.
+     */
+    bool startCompaction();
+
+    /* Wait until no compaction is running */
+    void waitForCompaction();
+
+    /* Return the number of words and removals in the active delta */
+    size_t deltaSize() const;
+
+    /* Return the number of compactions that swapped in a new base */
+    size_t numCompactions() const;
+
+  private:
+    /* The changes made on top of the layers below */
+    struct Delta {
+        // words added or given a new frequency
+        DictionaryTrie words;
+        // number of words in words
+        size_t numWords = 0;
+        // words removed from the layers below, looked up by string_view
+        set<string, less<>> removed;
+    };
+
+    // guards every member below but compactor
+    mutable shared_mutex lock;
+
+    // taken by an update before lock, and by a query on its way to
+    // lock, so queries queue up behind a waiting update
+    mutable mutex turnstile;
+
+    shared_ptr<const DictionaryTrie> base;
+
+    // the delta being compacted, nullptr when no compaction runs
+    shared_ptr<const Delta> frozen;
+
+    Delta active;
+
+    size_t compactThreshold;
+    size_t compactions;
+
+    // the thread of the last compaction. Once frozen is nullptr again
+    // it no longer touches the dictionary and the next one detaches it.
+    thread compactor;
+
+    // numbers of the layers, from the top
+    static const int ACTIVE = 0;
+    static const int FROZEN = 1;
+    static const int BASE = 2;
+
+    /* Return the frequency of word in the layers from number top down,
+     * 0 if it is not there, and set owner to the number of the layer
+     * that decides it, or -1. The lock is held. */
+    unsigned int resolve(string_view word, int& owner,
+                         int top = ACTIVE) const;
+
+    /* Take lock shared once no update is waiting for it */
+    shared_lock<shared_mutex> readLock() const {
+        { lock_guard<mutex> wait(turnstile); }
+        return shared_lock<shared_mutex>(lock);
+    }
+
+    /* remove with the lock held exclusively */
+    bool removeLocked(string_view word);
+
+    /**
+     * Return the numCompletions best words of the layers, asking each
+     * layer for its best words with ask and keeping those the layer
+     * decides. A layer is asked for more while it answers in full and
+     * too many of its words are decided above it. The lock is held.
+     */
+    vector<string> merge(
+        const function<vector<string>(const DictionaryTrie&, unsigned int)>&
+            ask,
+        unsigned int numCompletions) const;
+
+    /* Start a compaction if there is none and the active delta is not
+     * empty. The lock is held exclusively. */
+    bool freezeAndCompact();
+
+    /* Build a base from oldBase with delta on top and swap it in */
+    void compact(shared_ptr<const DictionaryTrie> oldBase,
+                 shared_ptr<const Delta> delta);
+};
+
+#endif  // LAYERED_DICTIONARY_HPP
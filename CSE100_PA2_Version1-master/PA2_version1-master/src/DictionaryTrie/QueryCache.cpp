@@ -0,0 +1,201 @@
+/**
+ * This file implements the cache of predictCompletions answers declared
+ * in QueryCache.hpp.
+ */
+#include "QueryCache.hpp"
+#include <algorithm>
+#include <functional>
+
+/**
+ * Split capacity evenly over the shards
+ */
+QueryCache::QueryCache(size_t capacity, unsigned int numShards)
+    : shards(new Shard[max(1u, numShards)]),
+      numShards(max(1u, numShards)),
+      shardCapacity(max<size_t>(1, capacity / max(1u, numShards))) {}
+
+/**
+ * The entry of prefix answers the query if it was made for at least
+ * numCompletions words, or if it holds fewer words than it was made
+ * for, which means the prefix has no more completions. Entries are
+ * found by the hash of their prefix, so the prefix is compared too.
+ */
+bool QueryCache::lookup(const string& prefix, unsigned int numCompletions,
+                        vector<string>& out, size_t& count) {
+    size_t hash = std::hash<string>()(prefix);
+    Shard& shard = shardOf(hash);
+    lock_guard<mutex> guard(shard.lock);
+    auto it = shard.slots.find(hash);
+    if (it == shard.slots.end()) {
+        shard.counts.misses++;
+        return false;
+    }
+    Entry& entry = shard.entries[it->second];
+    if (entry.prefix != prefix ||
+        (entry.k < numCompletions && entry.words.size() == entry.k)) {
+        shard.counts.misses++;
+        return false;
+    }
+    entry.referenced = true;
+    shard.counts.hits++;
+    count = min<size_t>(numCompletions, entry.words.size());
+    if (out.size() < count) {
+        out.resize(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        out[i] = entry.words[i];
+    }
+    return true;
+}
+
+/**
+ * Overwrite the entry of prefix, or of another prefix with the same
+ * hash, or take a new slot for it
+ */
+void QueryCache::store(const string& prefix, unsigned int numCompletions,
+                       const vector<string>& out, size_t count) {
+    size_t hash = std::hash<string>()(prefix);
+    Shard& shard = shardOf(hash);
+    lock_guard<mutex> guard(shard.lock);
+    uint32_t slot;
+    auto it = shard.slots.find(hash);
+    if (it != shard.slots.end()) {
+        slot = it->second;
+    } else {
+        slot = takeSlot(shard);
+        shard.slots[hash] = slot;
+    }
+    Entry& entry = shard.entries[slot];
+    entry.prefix = prefix;
+    entry.hash = hash;
+    entry.k = numCompletions;
+    entry.words.assign(out.begin(), out.begin() + count);
+    entry.referenced = false;
+}
+
+/**
+ * Reuse an invalidated slot, or add one while the shard has room, or
+ * sweep the CLOCK hand to the first entry not referenced since the
+ * hand last passed it and evict that entry
+ */
+uint32_t QueryCache::takeSlot(Shard& shard) {
+    if (!shard.freeSlots.empty()) {
+        uint32_t slot = shard.freeSlots.back();
+        shard.freeSlots.pop_back();
+        return slot;
+    }
+    if (shard.entries.size() < shardCapacity) {
+        shard.entries.push_back(Entry());
+        return shard.entries.size() - 1;
+    }
+    while (shard.entries[shard.hand].referenced) {
+        shard.entries[shard.hand].referenced = false;
+        shard.hand = (shard.hand + 1) % shard.entries.size();
+    }
+    uint32_t slot = shard.hand;
+    shard.hand = (shard.hand + 1) % shard.entries.size();
+    shard.slots.erase(shard.entries[slot].hash);
+    shard.counts.evictions++;
+    return slot;
+}
+
+/**
+ * Helper method for invalidate. An invalidated slot keeps its strings,
+ * which the next entry to take the slot reuses.
+ */
+bool QueryCache::drop(Shard& shard, string_view prefix, size_t hash) {
+    auto it = shard.slots.find(hash);
+    if (it == shard.slots.end()) {
+        return false;
+    }
+    Entry& entry = shard.entries[it->second];
+    if (entry.prefix != prefix) {
+        return false;
+    }
+    // a free slot is never evicted, and is off the hand's way as long
+    // as it is not referenced
+    entry.referenced = false;
+    shard.freeSlots.push_back(it->second);
+    shard.slots.erase(it);
+    shard.counts.invalidations++;
+    return true;
+}
+
+/**
+ * Every prefix of word is hashed without copying it
+ */
+void QueryCache::invalidate(string_view word) {
+    for (size_t len = 1; len <= word.size(); len++) {
+        string_view prefix = word.substr(0, len);
+        size_t hash = std::hash<string_view>()(prefix);
+        Shard& shard = shardOf(hash);
+        lock_guard<mutex> guard(shard.lock);
+        drop(shard, prefix, hash);
+    }
+}
+
+/**
+ * Drop every entry but keep the counters
+ */
+void QueryCache::clear() {
+    for (unsigned int s = 0; s < numShards; s++) {
+        lock_guard<mutex> guard(shards[s].lock);
+        shards[s].slots.clear();
+        shards[s].entries.clear();
+        shards[s].freeSlots.clear();
+        shards[s].hand = 0;
+    }
+}
+
+/**
+ * Sum the counters of the shards
+ */
+QueryCache::Stats QueryCache::stats() const {
+    Stats total;
+    for (unsigned int s = 0; s < numShards; s++) {
+        lock_guard<mutex> guard(shards[s].lock);
+        total.hits += shards[s].counts.hits;
+        total.misses += shards[s].counts.misses;
+        total.invalidations += shards[s].counts.invalidations;
+        total.evictions += shards[s].counts.evictions;
+    }
+    return total;
+}
+
+/**
+ * Return the number of entries
+ */
+size_t QueryCache::size() const {
+    size_t total = 0;
+    for (unsigned int s = 0; s < numShards; s++) {
+        lock_guard<mutex> guard(shards[s].lock);
+        total += shards[s].slots.size();
+    }
+    return total;
+}
+
+/**
+ * Count the entries, their words and the hash maps, approximating a
+ * map node by its key, its slot and two pointers
+ */
+size_t QueryCache::memoryUsage() const {
+    const size_t MAP_NODE =
+        sizeof(size_t) + sizeof(uint32_t) + 2 * sizeof(void*);
+    size_t total = 0;
+    for (unsigned int s = 0; s < numShards; s++) {
+        const Shard& shard = shards[s];
+        lock_guard<mutex> guard(shard.lock);
+        total += shard.entries.capacity() * sizeof(Entry);
+        total += shard.freeSlots.capacity() * sizeof(uint32_t);
+        total += shard.slots.bucket_count() * sizeof(void*);
+        total += shard.slots.size() * MAP_NODE;
+        for (const Entry& entry : shard.entries) {
+            total += entry.prefix.capacity() + 1;
+            total += entry.words.capacity() * sizeof(string);
+            for (const string& word : entry.words) {
+                total += word.capacity() + 1;
+            }
+        }
+    }
+    return total;
+}
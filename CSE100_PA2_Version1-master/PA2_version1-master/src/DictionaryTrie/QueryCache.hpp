@@ -0,0 +1,127 @@
+/**
+ * This file defines the cache of recent predictCompletions answers that
+ * a DictionaryTrie consults before searching.
+ */
+#ifndef QUERY_CACHE_HPP
+#define QUERY_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A bounded cache of predictCompletions answers, one entry per prefix.
+ * An entry answering the top k of a prefix also answers any smaller
+ * k with its first words, and any k at all if it holds fewer than k
+ * words, since it then holds every completion of the prefix.
+ *
+ * The entries are spread over shards by the hash of the prefix, and
+ * every shard has its own lock, so threads answering queries at the
+ * same time rarely wait for each other. A full shard evicts with the
+ * CLOCK algorithm: a hit marks the entry, and the hand sweeping for a
+ * victim clears marks until it finds an entry that was not used since
+ * its last pass.
+ *
+ * A change to word can only change the answers for the prefixes of
+ * word, so invalidate drops those entries and keeps every other one.
+ */
+class QueryCache {
+  public:
+    /* Counters of what the cache did, summed over the shards */
+    struct Stats {
+        // queries answered from an entry
+        size_t hits = 0;
+        // queries with no entry, or one for a smaller k
+        size_t misses = 0;
+        // entries dropped because a word below their prefix changed
+        size_t invalidations = 0;
+        // entries dropped to make room for another one
+        size_t evictions = 0;
+    };
+
+    /* Create a cache of at most capacity entries in numShards shards,
+     * at least one entry per shard */
+    QueryCache(size_t capacity, unsigned int numShards);
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    /**
+     * Copy the answer for the top numCompletions of prefix into the
+     * first strings of out, growing it if needed, set count to their
+     * number and return true, or return false if no entry answers it.
+     */
+    bool lookup(const string& prefix, unsigned int numCompletions,
+                vector<string>& out, size_t& count);
+
+    /* Keep the count first words of out as the answer for the top
+     * numCompletions of prefix, replacing the entry of prefix */
+    void store(const string& prefix, unsigned int numCompletions,
+               const vector<string>& out, size_t count);
+
+    /* Drop the entries of every prefix of word, word included */
+    void invalidate(string_view word);
+
+    /* Drop every entry */
+    void clear();
+
+    /* Return the counters */
+    Stats stats() const;
+
+    /* Return the number of entries */
+    size_t size() const;
+
+    /* Return the number of heap bytes held by the entries */
+    size_t memoryUsage() const;
+
+  private:
+    // slot of an entry that holds no answer
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+
+    /* The answer for the top k of prefix */
+    struct Entry {
+        string prefix;
+        size_t hash;
+        unsigned int k;
+        vector<string> words;
+        // set by a hit, cleared by the CLOCK hand
+        bool referenced;
+    };
+
+    struct Shard {
+        // guards every member below
+        mutable mutex lock;
+        // the slot in entries of every prefix hash
+        unordered_map<size_t, uint32_t> slots;
+        vector<Entry> entries;
+        // slots of entries that were invalidated
+        vector<uint32_t> freeSlots;
+        // next slot the CLOCK hand looks at
+        size_t hand = 0;
+        Stats counts;
+    };
+
+    unique_ptr<Shard[]> shards;
+    unsigned int numShards;
+    size_t shardCapacity;
+
+    /* Return the shard of a prefix with the given hash */
+    Shard& shardOf(size_t hash) const { return shards[hash % numShards]; }
+
+    /* Drop the entry of prefix, which has the given hash, if it is
+     * there. The lock of its shard must be held. */
+    static bool drop(Shard& shard, string_view prefix, size_t hash);
+
+    /* Return a slot for a new entry of shard, evicting one if the
+     * shard is full. The lock of the shard must be held. */
+    uint32_t takeSlot(Shard& shard);
+};
+
+#endif  // QUERY_CACHE_HPP
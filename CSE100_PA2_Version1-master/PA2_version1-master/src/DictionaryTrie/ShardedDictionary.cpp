@@ -0,0 +1,144 @@
+/**
+ * This file implements the sharded dictionary declared in
+ * ShardedDictionary.hpp.
+ */
+#include "ShardedDictionary.hpp"
+#include <algorithm>
+#include <utility>
+
+/**
+ * Start the pool with every byte in the one shard
+ */
+ShardedDictionary::ShardedDictionary(unsigned int numThreads)
+    : shards(1), pool(numThreads) {
+    fill(shardOfByte, shardOfByte + 256, 0);
+}
+
+/**
+ * Cut the bytes where the running count of records passes the next
+ * multiple of total / numShards, then hand every shard its records and
+ * build the shards on the workers
+ */
+void ShardedDictionary::build(const vector<DictionaryTrie::Record>& records,
+                              unsigned int numShards) {
+    const unsigned int MAX_SHARDS = 256;
+    lock_guard<mutex> guard(poolLock);
+    if (numShards == 0) {
+        numShards = pool.size();
+    }
+    numShards = min(numShards, MAX_SHARDS);
+
+    size_t count[256] = {0};
+    size_t total = 0;
+    for (const DictionaryTrie::Record& r : records) {
+        if (!r.word.empty()) {
+            count[(unsigned char)r.word[0]]++;
+            total++;
+        }
+    }
+    size_t seen = 0;
+    unsigned int s = 0;
+    for (unsigned int b = 0; b < 256; b++) {
+        shardOfByte[b] = s;
+        seen += count[b];
+        if (s + 1 < numShards && seen * numShards >= total * (s + 1)) {
+            s++;
+        }
+    }
+
+    vector<vector<DictionaryTrie::Record>> parts(numShards);
+    for (const DictionaryTrie::Record& r : records) {
+        if (!r.word.empty()) {
+            parts[shardOfByte[(unsigned char)r.word[0]]].push_back(r);
+        }
+    }
+    shards.clear();
+    shards.resize(numShards);
+    pool.run(numShards,
+             [&](size_t i, unsigned int) { shards[i].bulkBuild(parts[i]); });
+}
+
+/**
+ * Insert word in its shard
+ */
+bool ShardedDictionary::insert(string_view word, unsigned int freq) {
+    return !word.empty() && shardOf(word).insert(word, freq);
+}
+
+/**
+ * Update word in its shard
+ */
+bool ShardedDictionary::updateFrequency(string_view word, unsigned int freq) {
+    return !word.empty() && shardOf(word).updateFrequency(word, freq);
+}
+
+/**
+ * Remove word from its shard
+ */
+bool ShardedDictionary::remove(string_view word) {
+    return !word.empty() && shardOf(word).remove(word);
+}
+
+/**
+ * Find word in its shard
+ */
+bool ShardedDictionary::find(string_view word) const {
+    return !word.empty() && shardOf(word).find(word);
+}
+
+/**
+ * Every completion of prefix starts with its first byte
+ */
+vector<string> ShardedDictionary::predictCompletions(
+    const string& prefix, unsigned int numCompletions) const {
+    if (prefix.empty()) {
+        return {};
+    }
+    return shardOf(prefix).predictCompletions(prefix, numCompletions);
+}
+
+/**
+ * A pattern starting with '_' asks every shard for its top
+ * numCompletions on a worker, which also looks up the frequencies of
+ * the words it got. The lists are merged in the order of
+ * predictCompletions: decreasing frequency, then alphabetical.
+ */
+vector<string> ShardedDictionary::predictUnderscores(
+    const string& pattern, unsigned int numCompletions) const {
+    if (pattern.empty()) {
+        return {};
+    }
+    if (pattern[0] != '_') {
+        return shardOf(pattern).predictUnderscores(pattern, numCompletions);
+    }
+
+    vector<vector<pair<unsigned int, string>>> lists(shards.size());
+    {
+        lock_guard<mutex> guard(poolLock);
+        pool.run(shards.size(), [&](size_t i, unsigned int) {
+            for (string& word :
+                 shards[i].predictUnderscores(pattern, numCompletions)) {
+                unsigned int freq = shards[i].frequency(word);
+                lists[i].push_back(make_pair(freq, move(word)));
+            }
+        });
+    }
+    vector<pair<unsigned int, string>> all;
+    for (vector<pair<unsigned int, string>>& list : lists) {
+        move(list.begin(), list.end(), back_inserter(all));
+    }
+    size_t count = min<size_t>(numCompletions, all.size());
+    partial_sort(all.begin(), all.begin() + count, all.end(),
+                 [](const pair<unsigned int, string>& a,
+                    const pair<unsigned int, string>& b) {
+                     if (a.first != b.first) {
+                         return a.first > b.first;
+                     }
+                     return a.second < b.second;
+                 });
+    vector<string> merged;
+    for (size_t i = 0; i < count; i++) {
+        merged.push_back(move(all[i].second));
+    }
+    return merged;
+}
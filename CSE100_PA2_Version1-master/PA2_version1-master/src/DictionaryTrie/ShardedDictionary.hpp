@@ -0,0 +1,101 @@
+/**
+ * This file defines a dictionary split into DictionaryTrie shards by
+ * the first byte of the words, so the shards build in parallel and
+ * queries that cannot be routed to one shard fan out over all of them.
+ */
+#ifndef SHARDED_DICTIONARY_HPP
+#define SHARDED_DICTIONARY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DictionaryTrie.hpp"
+#include "ThreadPool.hpp"
+
+using namespace std;
+
+/**
+ * The first bytes are cut into as many contiguous ranges as there are
+ * shards, with about the same number of words in every range, and the
+ * words of a range live in the DictionaryTrie of its shard. Every word
+ * with a given first byte is in one shard, so find, the updates and
+ * predictCompletions go to that shard alone, and so does a pattern of
+ * predictUnderscores whose first character is not '_'. A pattern
+ * starting with '_' is searched in every shard at once on the workers
+ * of a ThreadPool, and the per-shard top-k lists are merged.
+ *
+ * The answers are the ones a single DictionaryTrie holding every word
+ * would give. Like DictionaryTrie, queries may run concurrently as
+ * long as nothing changes the words; fan-out queries take turns on the
+ * pool.
+ */
+class ShardedDictionary {
+  public:
+    /* Create an empty dictionary of one shard, with numThreads workers,
+     * one per hardware thread if it is 0 */
+    explicit ShardedDictionary(unsigned int numThreads = 0);
+
+    ShardedDictionary(const ShardedDictionary&) = delete;
+    ShardedDictionary& operator=(const ShardedDictionary&) = delete;
+
+    /**
+     * Replace the words with records, split into numShards shards, one
+     * per worker if it is 0. The records are counted by first byte to
+     * choose the ranges, copied to their shards, and every shard is bulk
+     * built on a worker, with the rules of DictionaryTrie::bulkBuild.
+     * There are at most 256 shards.
+     */
+    void build(const vector<DictionaryTrie::Record>& records,
+               unsigned int numShards = 0);
+
+    /* Same as DictionaryTrie::insert, in the shard of word */
+    bool insert(string_view word, unsigned int freq);
+
+    /* Same as DictionaryTrie::updateFrequency, in the shard of word */
+    bool updateFrequency(string_view word, unsigned int freq);
+
+    /* Same as DictionaryTrie::remove, in the shard of word */
+    bool remove(string_view word);
+
+    /* Same as DictionaryTrie::find, in the shard of word */
+    bool find(string_view word) const;
+
+    /* Same as DictionaryTrie::predictCompletions, in the shard of
+     * prefix */
+    vector<string> predictCompletions(const string& prefix,
+                                      unsigned int numCompletions) const;
+
+    /* Same as DictionaryTrie::predictUnderscores, fanning out over
+     * every shard if pattern starts with '_' */
+    vector<string> predictUnderscores(const string& pattern,
+                                      unsigned int numCompletions) const;
+
+    /* Return the number of shards */
+    size_t numShards() const { return shards.size(); }
+
+    /* Return shard i */
+    const DictionaryTrie& shard(size_t i) const { return shards[i]; }
+
+  private:
+    vector<DictionaryTrie> shards;
+
+    // the shard of the words starting with every byte
+    uint8_t shardOfByte[256];
+
+    // guards the pool, which one fan-out or build uses at a time
+    mutable mutex poolLock;
+    mutable ThreadPool pool;
+
+    /* Return the shard of the words starting like word */
+    DictionaryTrie& shardOf(string_view word) {
+        return shards[shardOfByte[(unsigned char)word[0]]];
+    }
+    const DictionaryTrie& shardOf(string_view word) const {
+        return shards[shardOfByte[(unsigned char)word[0]]];
+    }
+};
+
+#endif  // SHARDED_DICTIONARY_HPP
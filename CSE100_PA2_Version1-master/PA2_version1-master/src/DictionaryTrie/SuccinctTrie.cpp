@@ -0,0 +1,549 @@
+/**
+ * This file implements the LOUDS trie declared in SuccinctTrie.hpp: the
+ * conversion from a DictionaryTrie, the file format and the queries.
+ */
+#include "SuccinctTrie.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const char MAGIC[8] = {'S', 'U', 'C', 'T', 'R', 'I', 'E', '\0'};
+const unsigned int WORD_BITS = 64;
+
+/* A growable bit string stored in 64-bit words */
+struct BitWriter {
+    vector<uint64_t> words;
+    uint64_t size = 0;
+
+    void push(bool bit) {
+        if (size % WORD_BITS == 0) {
+            words.push_back(0);
+        }
+        if (bit) {
+            words.back() |= uint64_t(1) << (size % WORD_BITS);
+        }
+        size++;
+    }
+};
+
+/* Pack values into bits-bit entries, with a spare word at the end so
+ * an entry can always be read with two word loads */
+vector<uint64_t> packValues(const vector<unsigned int>& values,
+                            unsigned int bits) {
+    vector<uint64_t> packed((values.size() * bits) / WORD_BITS + 2, 0);
+    for (size_t i = 0; i < values.size(); i++) {
+        uint64_t bit = i * bits;
+        uint64_t word = bit / WORD_BITS;
+        unsigned int offset = bit % WORD_BITS;
+        packed[word] |= uint64_t(values[i]) << offset;
+        if (offset + bits > WORD_BITS) {
+            packed[word + 1] |= uint64_t(values[i]) >> (WORD_BITS - offset);
+        }
+    }
+    return packed;
+}
+
+/* Append the nodes of the sibling BST of dict rooted at node to out,
+ * in order of their characters */
+void siblingsInOrder(const DictionaryTrie& dict, uint32_t node,
+                     vector<uint32_t>& out) {
+    vector<uint32_t> pending;
+    while (node != DictionaryTrie::NIL || !pending.empty()) {
+        while (node != DictionaryTrie::NIL) {
+            pending.push_back(node);
+            node = dict.getNode(node).left;
+        }
+        node = pending.back();
+        pending.pop_back();
+        out.push_back(node);
+        node = dict.getNode(node).right;
+    }
+}
+
+}  // namespace
+
+/**
+ * Create a trie with no file open
+ */
+SuccinctTrie::SuccinctTrie() : mapping(nullptr), mappingSize(0) { close(); }
+
+/**
+ * Unmap the file
+ */
+SuccinctTrie::~SuccinctTrie() { close(); }
+
+/**
+ * Number the trie nodes breadth-first and lay out every section. The
+ * nodes of the multi-way trie are the TST nodes, and the children of a
+ * node are its middle child and the siblings of that child, in the
+ * order of an in-order walk of their BST. The words of an ART are put
+ * in a TST first.
+ */
+bool SuccinctTrie::write(const DictionaryTrie& dict, const string& path) {
+    if (dict.engine() == DictionaryTrie::ART) {
+        string text;
+        vector<DictionaryTrie::Record> records = dict.listWords(text);
+        DictionaryTrie tst;
+        tst.bulkBuild(records);
+        return write(tst, path);
+    }
+    // tst[v] is the TST node of trie node v, NIL for the root
+    vector<uint32_t> tst(1, DictionaryTrie::NIL);
+    vector<uint64_t> firstChild;
+    BitWriter loudsBits;
+    string labelBytes(1, '\0');
+    vector<uint32_t> siblings;
+    for (size_t v = 0; v < tst.size(); v++) {
+        siblings.clear();
+        siblingsInOrder(dict,
+                        tst[v] == DictionaryTrie::NIL
+                            ? dict.root
+                            : dict.getNode(tst[v]).middle,
+                        siblings);
+        firstChild.push_back(tst.size());
+        for (uint32_t child : siblings) {
+            loudsBits.push(true);
+            tst.push_back(child);
+            labelBytes.push_back(dict.getNode(child).data);
+        }
+        loudsBits.push(false);
+    }
+    uint64_t numNodes = tst.size();
+    firstChild.push_back(numNodes);
+
+    // frequencies, and the highest one below every node, computed
+    // children first
+    vector<unsigned int> wordFreqs;
+    vector<unsigned int> maxFreq(numNodes, 0);
+    BitWriter terminalBits;
+    for (uint64_t v = 0; v < numNodes; v++) {
+        unsigned int freq =
+            tst[v] == DictionaryTrie::NIL ? 0 : dict.getNode(tst[v]).freq;
+        terminalBits.push(freq != 0);
+        if (freq != 0) {
+            wordFreqs.push_back(freq);
+        }
+        maxFreq[v] = freq;
+    }
+    for (uint64_t v = numNodes; v-- > 0;) {
+        for (uint64_t c = firstChild[v]; c < firstChild[v + 1]; c++) {
+            maxFreq[v] = max(maxFreq[v], maxFreq[c]);
+        }
+    }
+    unsigned int freqBits = 1;
+    while (freqBits < 32 && (uint64_t(maxFreq[0]) >> freqBits) != 0) {
+        freqBits++;
+    }
+
+    // the position of every SELECT_SAMPLE-th 0 of louds
+    vector<uint32_t> selectIndex;
+    uint64_t zeros = 0;
+    for (uint64_t i = 0; i < loudsBits.size; i++) {
+        if (!((loudsBits.words[i / WORD_BITS] >> (i % WORD_BITS)) & 1)) {
+            if (zeros % SELECT_SAMPLE == 0) {
+                selectIndex.push_back(i);
+            }
+            zeros++;
+        }
+    }
+
+    // the number of 1 bits of terminal before every RANK_BLOCK words
+    vector<uint32_t> rankIndex;
+    uint32_t ones = 0;
+    for (size_t w = 0; w < terminalBits.words.size(); w++) {
+        if (w % RANK_BLOCK == 0) {
+            rankIndex.push_back(ones);
+        }
+        ones += __builtin_popcountll(terminalBits.words[w]);
+    }
+
+    // a spare word after louds lets select scan past its last bit
+    loudsBits.words.push_back(0);
+    vector<uint64_t> packedFreqs = packValues(wordFreqs, freqBits);
+    vector<uint64_t> packedMax = packValues(maxFreq, freqBits);
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.freqBits = freqBits;
+    header.numNodes = numNodes;
+    header.numWords = wordFreqs.size();
+
+    // every section starts on a 64-bit word
+    vector<pair<const void*, uint64_t>> sections;
+    uint64_t at = (sizeof(Header) + 7) / 8;
+    auto place = [&](const void* data, uint64_t bytes, uint64_t& sectionAt,
+                     uint64_t& sectionWords) {
+        sectionAt = at;
+        sectionWords = (bytes + 7) / 8;
+        at += sectionWords;
+        sections.push_back(make_pair(data, bytes));
+    };
+    place(loudsBits.words.data(), loudsBits.words.size() * 8, header.loudsAt,
+          header.loudsWords);
+    place(selectIndex.data(), selectIndex.size() * 4, header.selectAt,
+          header.selectWords);
+    place(labelBytes.data(), labelBytes.size(), header.labelsAt,
+          header.labelsWords);
+    place(terminalBits.words.data(), terminalBits.words.size() * 8,
+          header.terminalAt, header.terminalWords);
+    place(rankIndex.data(), rankIndex.size() * 4, header.rankAt,
+          header.rankWords);
+    place(packedFreqs.data(), packedFreqs.size() * 8, header.freqsAt,
+          header.freqsWords);
+    place(packedMax.data(), packedMax.size() * 8, header.maxFreqsAt,
+          header.maxFreqsWords);
+
+    ofstream out(path, ios::binary | ios::trunc);
+    const char padding[8] = {0};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(padding, (8 - sizeof(header) % 8) % 8);
+    for (const pair<const void*, uint64_t>& section : sections) {
+        out.write(static_cast<const char*>(section.first), section.second);
+        out.write(padding, (8 - section.second % 8) % 8);
+    }
+    return out.good();
+}
+
+/**
+ * Map the file and check that every section lies inside it
+ */
+bool SuccinctTrie::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    mapping = data;
+    mappingSize = info.st_size;
+
+    const Header* h = static_cast<const Header*>(mapping);
+    uint64_t totalWords = mappingSize / 8;
+    uint64_t sections[][2] = {
+        {h->loudsAt, h->loudsWords},       {h->selectAt, h->selectWords},
+        {h->labelsAt, h->labelsWords},     {h->terminalAt, h->terminalWords},
+        {h->rankAt, h->rankWords},         {h->freqsAt, h->freqsWords},
+        {h->maxFreqsAt, h->maxFreqsWords}};
+    bool valid = memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 h->version == VERSION && h->freqBits >= 1 &&
+                 h->freqBits <= 32 && h->numNodes >= 1;
+    for (const uint64_t* section : sections) {
+        valid = valid && section[0] <= totalWords &&
+                section[1] <= totalWords - section[0];
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    const uint64_t* base = static_cast<const uint64_t*>(mapping);
+    header = h;
+    louds = base + h->loudsAt;
+    selectIndex = reinterpret_cast<const uint32_t*>(base + h->selectAt);
+    labels = reinterpret_cast<const char*>(base + h->labelsAt);
+    terminal = base + h->terminalAt;
+    rankIndex = reinterpret_cast<const uint32_t*>(base + h->rankAt);
+    freqs = base + h->freqsAt;
+    maxFreqs = base + h->maxFreqsAt;
+    return true;
+}
+
+/**
+ * Unmap the file, leaving the trie empty
+ */
+void SuccinctTrie::close() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    louds = terminal = freqs = maxFreqs = nullptr;
+    selectIndex = rankIndex = nullptr;
+    labels = nullptr;
+}
+
+/**
+ * Return the position of the k-th 0 of louds: start at the sampled
+ * position of the closest earlier 0 and count 0 bits a word at a time
+ */
+uint64_t SuccinctTrie::select0(uint64_t k) const {
+    uint64_t sample = (k - 1) / SELECT_SAMPLE;
+    uint64_t pos = selectIndex[sample];
+    uint64_t skip = k - 1 - sample * SELECT_SAMPLE;
+    uint64_t w = pos / WORD_BITS;
+    uint64_t zerosLeft = ~louds[w] & (~uint64_t(0) << (pos % WORD_BITS));
+    while (true) {
+        uint64_t count = __builtin_popcountll(zerosLeft);
+        if (skip < count) {
+            for (uint64_t i = 0; i < skip; i++) {
+                zerosLeft &= zerosLeft - 1;  // drop the lowest 0
+            }
+            return w * WORD_BITS + __builtin_ctzll(zerosLeft);
+        }
+        skip -= count;
+        zerosLeft = ~louds[++w];
+    }
+}
+
+/**
+ * Return the number of 1 bits of terminal before position i
+ */
+uint64_t SuccinctTrie::rankTerminal(uint64_t i) const {
+    uint64_t w = i / WORD_BITS;
+    uint64_t block = w / RANK_BLOCK;
+    uint64_t rank = rankIndex[block];
+    for (uint64_t j = block * RANK_BLOCK; j < w; j++) {
+        rank += __builtin_popcountll(terminal[j]);
+    }
+    uint64_t bit = i % WORD_BITS;
+    if (bit != 0) {
+        rank += __builtin_popcountll(terminal[w] << (WORD_BITS - bit));
+    }
+    return rank;
+}
+
+/**
+ * The run of node starts after the node-th 0 and ends at the next 0.
+ * Every node before it has one 0, so the number of 1 bits before the
+ * run, which is the number of nodes with a smaller parent, is the start
+ * minus node, and the first child comes right after those.
+ */
+uint64_t SuccinctTrie::children(uint64_t node, uint64_t& first) const {
+    uint64_t start = node == 0 ? 0 : select0(node) + 1;
+    uint64_t w = start / WORD_BITS;
+    uint64_t zeros = ~louds[w] >> (start % WORD_BITS);
+    uint64_t end;
+    if (zeros != 0) {
+        end = start + __builtin_ctzll(zeros);
+    } else {
+        do {
+            zeros = ~louds[++w];
+        } while (zeros == 0);
+        end = w * WORD_BITS + __builtin_ctzll(zeros);
+    }
+    first = start - node + 1;
+    return end - start;
+}
+
+/**
+ * Binary search the labels of the children of node, which are sorted
+ * like the characters of a TST
+ */
+uint64_t SuccinctTrie::child(uint64_t node, char c) const {
+    uint64_t first;
+    uint64_t count = children(node, first);
+    const char* begin = labels + first;
+    const char* found =
+        lower_bound(begin, begin + count, c, DictionaryTrie::charLess);
+    if (found == begin + count || *found != c) {
+        return 0;
+    }
+    return first + (found - begin);
+}
+
+/**
+ * Return the node spelled by word, or 0 if there is none
+ */
+uint64_t SuccinctTrie::walk(const string& word) const {
+    uint64_t node = 0;
+    for (char c : word) {
+        node = child(node, c);
+        if (node == 0) {
+            return 0;
+        }
+    }
+    return node;
+}
+
+/**
+ * Return true if node ends a word
+ */
+bool SuccinctTrie::isTerminal(uint64_t node) const {
+    return (terminal[node / WORD_BITS] >> (node % WORD_BITS)) & 1;
+}
+
+/**
+ * Return the frequency of the word ending at node, 0 if none
+ */
+unsigned int SuccinctTrie::freqOf(uint64_t node) const {
+    if (!isTerminal(node)) {
+        return 0;
+    }
+    return unpack(freqs, rankTerminal(node));
+}
+
+/**
+ * Return the highest frequency of a word at or below node
+ */
+unsigned int SuccinctTrie::maxFreqOf(uint64_t node) const {
+    return unpack(maxFreqs, node);
+}
+
+/**
+ * Return entry i of a packed array of freqBits-bit entries
+ */
+uint64_t SuccinctTrie::unpack(const uint64_t* packed, uint64_t i) const {
+    uint64_t bits = header->freqBits;
+    uint64_t bit = i * bits;
+    uint64_t word = bit / WORD_BITS;
+    uint64_t offset = bit % WORD_BITS;
+    uint64_t value = packed[word] >> offset;
+    if (offset + bits > WORD_BITS) {
+        value |= packed[word + 1] << (WORD_BITS - offset);
+    }
+    return value & ((uint64_t(1) << bits) - 1);
+}
+
+/**
+ * Same as DictionaryTrie::find
+ */
+bool SuccinctTrie::find(const string& word) const {
+    if (header == nullptr || word.empty()) {
+        return false;
+    }
+    uint64_t node = walk(word);
+    return node != 0 && isTerminal(node);
+}
+
+/**
+ * Same results as DictionaryTrie::predictCompletions: a DFS below the
+ * node of the prefix into the same bounded top-k heap, skipping the
+ * nodes whose highest frequency cannot beat the worst kept word
+ */
+vector<string> SuccinctTrie::predictCompletions(
+    const string& prefix, unsigned int numCompletions) const {
+    vector<string> vecReturn;
+    if (header == nullptr || prefix.empty() || numCompletions == 0) {
+        return vecReturn;
+    }
+    uint64_t start = walk(prefix);
+    if (start == 0) {
+        return vecReturn;
+    }
+
+    vector<pair<string, int>> heap;
+    if (isTerminal(start)) {
+        DictionaryTrie::pd_fixed(heap, numCompletions, prefix,
+                                 freqOf(start));
+    }
+    // DFS stack of (node, length of the word above the node)
+    vector<pair<uint64_t, unsigned int>> traverseStack;
+    uint64_t first;
+    uint64_t count = children(start, first);
+    for (uint64_t c = first; c < first + count; c++) {
+        traverseStack.push_back(make_pair(c, prefix.length()));
+    }
+    string word = prefix;
+    while (!traverseStack.empty()) {
+        uint64_t node = traverseStack.back().first;
+        unsigned int len = traverseStack.back().second;
+        traverseStack.pop_back();
+        if (heap.size() == numCompletions &&
+            (int)maxFreqOf(node) < heap.front().second) {
+            continue;
+        }
+        word.resize(len);
+        word.push_back(labels[node]);
+        if (isTerminal(node)) {
+            DictionaryTrie::pd_fixed(heap, numCompletions, word,
+                                     freqOf(node));
+        }
+        count = children(node, first);
+        for (uint64_t c = first; c < first + count; c++) {
+            traverseStack.push_back(make_pair(c, len + 1));
+        }
+    }
+
+    sort(heap.begin(), heap.end(), DictionaryTrie::compare());
+    for (pair<string, int>& element : heap) {
+        vecReturn.push_back(move(element.first));
+    }
+    return vecReturn;
+}
+
+/**
+ * Same results as DictionaryTrie::predictUnderscores: a fixed character
+ * follows one child, a '_' fans out to every child it matches
+ */
+vector<string> SuccinctTrie::predictUnderscores(
+    const string& pattern, unsigned int numCompletions) const {
+    vector<string> vecReturn;
+    if (header == nullptr || pattern.empty() || numCompletions == 0) {
+        return vecReturn;
+    }
+
+    vector<pair<string, int>> heap;
+    // DFS stack of (node, number of pattern characters matched)
+    vector<pair<uint64_t, unsigned int>> traverseStack;
+    traverseStack.push_back(make_pair(0, 0));
+    string word = pattern;
+    while (!traverseStack.empty()) {
+        uint64_t node = traverseStack.back().first;
+        unsigned int matched = traverseStack.back().second;
+        traverseStack.pop_back();
+        if (heap.size() == numCompletions &&
+            (int)maxFreqOf(node) < heap.front().second) {
+            continue;
+        }
+        if (matched > 0) {
+            word[matched - 1] = labels[node];
+        }
+        if (matched == pattern.length()) {
+            if (isTerminal(node)) {
+                DictionaryTrie::pd_fixed(heap, numCompletions, word,
+                                         freqOf(node));
+            }
+            continue;
+        }
+        if (pattern[matched] != '_') {
+            uint64_t next = child(node, pattern[matched]);
+            if (next != 0) {
+                traverseStack.push_back(make_pair(next, matched + 1));
+            }
+            continue;
+        }
+        uint64_t first;
+        uint64_t count = children(node, first);
+        for (uint64_t c = first; c < first + count; c++) {
+            if (DictionaryTrie::matchesUnderscore(labels[c])) {
+                traverseStack.push_back(make_pair(c, matched + 1));
+            }
+        }
+    }
+
+    sort(heap.begin(), heap.end(), DictionaryTrie::compare());
+    for (pair<string, int>& element : heap) {
+        vecReturn.push_back(move(element.first));
+    }
+    return vecReturn;
+}
+
+/**
+ * Return the number of words
+ */
+size_t SuccinctTrie::numWords() const {
+    return header == nullptr ? 0 : header->numWords;
+}
+
+/**
+ * Return the size of the mapped file in bytes
+ */
+size_t SuccinctTrie::sizeInBytes() const { return mappingSize; }
@@ -0,0 +1,147 @@
+/**
+ * This file defines a compact, read-only form of a DictionaryTrie that
+ * is written to a file once and then served straight from an mmap of
+ * that file, so a process is ready to answer queries as soon as the
+ * file is mapped.
+ */
+#ifndef SUCCINCT_TRIE_HPP
+#define SUCCINCT_TRIE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DictionaryTrie.hpp"
+
+using namespace std;
+
+/**
+ * The words of a DictionaryTrie as a LOUDS trie (level-order unary
+ * degree sequence). The nodes of the multi-way trie are numbered in
+ * breadth-first order, node 0 being the empty prefix. The shape is one
+ * bit string holding, for every node in order, a 1 per child followed
+ * by a 0, so the children of a node are consecutive numbers found with
+ * a select on the 0 bits. Next to it are one label byte per node, a
+ * bit per node marking the ends of words, and the frequencies of the
+ * words and the highest frequency below every node, bit-packed to the
+ * width of the largest frequency.
+ *
+ * A SuccinctTrie is a view of the mapped file and never changes, so
+ * any number of threads may query it at once.
+ */
+class SuccinctTrie {
+  private:
+    // the layout of the file, followed by the sections it points at
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t freqBits;
+        uint64_t numNodes;
+        uint64_t numWords;
+        // offset and length in 64-bit words of every section
+        uint64_t loudsAt, loudsWords;
+        uint64_t selectAt, selectWords;
+        uint64_t labelsAt, labelsWords;
+        uint64_t terminalAt, terminalWords;
+        uint64_t rankAt, rankWords;
+        uint64_t freqsAt, freqsWords;
+        uint64_t maxFreqsAt, maxFreqsWords;
+    };
+
+    static const uint32_t VERSION = 2;
+
+    // one entry of the select index per SELECT_SAMPLE zeros of louds
+    static const uint64_t SELECT_SAMPLE = 256;
+
+    // one entry of the rank index per RANK_BLOCK words of terminal
+    static const uint64_t RANK_BLOCK = 8;
+
+    // the mapping of the file, nullptr if no file is open
+    void* mapping;
+    size_t mappingSize;
+
+    const Header* header;
+
+    // the sections, all inside the mapping
+    const uint64_t* louds;
+    const uint32_t* selectIndex;
+    const char* labels;
+    const uint64_t* terminal;
+    const uint32_t* rankIndex;
+    const uint64_t* freqs;
+    const uint64_t* maxFreqs;
+
+    /* Return the position of the k-th 0 of louds, counting from 1 */
+    uint64_t select0(uint64_t k) const;
+
+    /* Return the number of 1 bits of terminal before position i */
+    uint64_t rankTerminal(uint64_t i) const;
+
+    /* Set first to the first child of node and return the number of
+     * children */
+    uint64_t children(uint64_t node, uint64_t& first) const;
+
+    /* Return the child of node labeled c, or 0 if there is none */
+    uint64_t child(uint64_t node, char c) const;
+
+    /* Return the node spelled by word, or 0 if there is none */
+    uint64_t walk(const string& word) const;
+
+    /* Return true if node ends a word */
+    bool isTerminal(uint64_t node) const;
+
+    /* Return the frequency of the word ending at node, 0 if none */
+    unsigned int freqOf(uint64_t node) const;
+
+    /* Return the highest frequency of a word at or below node */
+    unsigned int maxFreqOf(uint64_t node) const;
+
+    /* Return entry i of a packed array of freqBits-bit entries */
+    uint64_t unpack(const uint64_t* packed, uint64_t i) const;
+
+  public:
+    /* Create a trie with no file open, it holds no words */
+    SuccinctTrie();
+
+    /* Unmap the file */
+    ~SuccinctTrie();
+
+    SuccinctTrie(const SuccinctTrie&) = delete;
+    SuccinctTrie& operator=(const SuccinctTrie&) = delete;
+
+    /**
+     * Convert dict and write it to the file at path. Return false if
+     * the file could not be written. A dict with engine ART is first
+     * copied into a TST.
+     */
+    static bool write(const DictionaryTrie& dict, const string& path);
+
+    /**
+     * Map the file at path, replacing any file open before. Return false
+     * if it cannot be mapped or is not a trie file of this version, and
+     * leave the trie empty.
+     */
+    bool open(const string& path);
+
+    /* Unmap the file, leaving the trie empty */
+    void close();
+
+    /* Same as DictionaryTrie::find */
+    bool find(const string& word) const;
+
+    /* Same results as DictionaryTrie::predictCompletions */
+    vector<string> predictCompletions(const string& prefix,
+                                      unsigned int numCompletions) const;
+
+    /* Same results as DictionaryTrie::predictUnderscores */
+    vector<string> predictUnderscores(const string& pattern,
+                                      unsigned int numCompletions) const;
+
+    /* Return the number of words */
+    size_t numWords() const;
+
+    /* Return the size of the mapped file in bytes */
+    size_t sizeInBytes() const;
+};
+
+#endif  // SUCCINCT_TRIE_HPP
@@ -0,0 +1,108 @@
+/**
+ * This file implements the worker pool declared in ThreadPool.hpp.
+ */
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+/**
+ * Start numThreads workers, or one per hardware thread if it is 0
+ */
+ThreadPool::ThreadPool(unsigned int numThreads)
+    : task(nullptr),
+      numTasks(0),
+      nextTask(0),
+      jobNumber(0),
+      busyWorkers(0),
+      stopping(false) {
+    if (numThreads == 0) {
+        numThreads = max(1u, thread::hardware_concurrency());
+    }
+    for (unsigned int id = 0; id < numThreads; id++) {
+        workers.push_back(thread(&ThreadPool::work, this, id));
+    }
+}
+
+/**
+ * Wait for the workers to finish and stop them
+ */
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * Return the number of worker threads
+ */
+unsigned int ThreadPool::size() const { return workers.size(); }
+
+/**
+ * Publish the job, wake the workers and wait until every worker has
+ * run out of tasks, then pass on the exception of a failed task
+ */
+void ThreadPool::run(size_t count,
+                     const function<void(size_t, unsigned int)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    unique_lock<mutex> guard(lock);
+    task = &fn;
+    numTasks = count;
+    nextTask = 0;
+    busyWorkers = workers.size();
+    jobNumber++;
+    jobReady.notify_all();
+    jobDone.wait(guard, [this]() { return busyWorkers == 0; });
+    task = nullptr;
+    if (failure) {
+        exception_ptr thrown = failure;
+        failure = nullptr;
+        rethrow_exception(thrown);
+    }
+}
+
+/**
+ * The loop run by worker number id: wait for a job, take tasks until
+ * there are none left, report and wait for the next job. An exception
+ * is kept for run, and the remaining tasks are taken away so the job
+ * ends soon.
+ */
+void ThreadPool::work(unsigned int id) {
+    unsigned long long lastJob = 0;
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        jobReady.wait(guard,
+                      [&]() { return stopping || jobNumber != lastJob; });
+        if (stopping) {
+            return;
+        }
+        lastJob = jobNumber;
+        const function<void(size_t, unsigned int)>& fn = *task;
+        size_t count = numTasks;
+        guard.unlock();
+
+        try {
+            for (size_t i = nextTask++; i < count; i = nextTask++) {
+                fn(i, id);
+            }
+        } catch (...) {
+            nextTask = count;
+            guard.lock();
+            if (!failure) {
+                failure = current_exception();
+            }
+            guard.unlock();
+        }
+
+        guard.lock();
+        busyWorkers--;
+        if (busyWorkers == 0) {
+            jobDone.notify_one();
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ * This file defines a fixed pool of worker threads that DictionaryTrie
+ * uses to answer batches of queries in parallel.
+ */
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A pool of worker threads that runs one job at a time. A job is a
+ * number of tasks and a function called once per task; the workers take
+ * task numbers from a shared counter until none are left, so uneven
+ * tasks balance out. The threads are started once and wait for the next
+ * job in between, so a job costs no thread creation. A task that throws
+ * ends its job early, and run rethrows the exception to its caller.
+ */
+class ThreadPool {
+  private:
+    vector<thread> workers;
+
+    // guards every member below except nextTask
+    mutex lock;
+    condition_variable jobReady;
+    condition_variable jobDone;
+
+    // the current job, called as task(taskNumber, workerNumber)
+    const function<void(size_t, unsigned int)>* task;
+    size_t numTasks;
+    atomic<size_t> nextTask;
+
+    // number of the current job, so workers notice a new one
+    unsigned long long jobNumber;
+
+    // number of workers still working on the current job
+    unsigned int busyWorkers;
+
+    // the first exception thrown by a task of the current job
+    exception_ptr failure;
+
+    bool stopping;
+
+    /* The loop run by worker number id */
+    void work(unsigned int id);
+
+  public:
+    /* Start numThreads workers, or one per hardware thread if it is 0 */
+    explicit ThreadPool(unsigned int numThreads = 0);
+
+    /* Wait for the workers to finish and stop them */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /* Return the number of worker threads */
+    unsigned int size() const;
+
+    /**
+     * Call fn(i, worker) for every i in [0, count) on the workers and
+     * return once all calls are done. worker is the number of the
+     * calling worker, in [0, size()), so fn can use per-worker state.
+     * If a call throws, the tasks not yet started are skipped and run
+     * rethrows the first exception once the workers are idle again.
+     * Only one thread may call run at a time.
+     */
+    void run(size_t count, const function<void(size_t, unsigned int)>& fn);
+};
+
+#endif  // THREAD_POOL_HPP
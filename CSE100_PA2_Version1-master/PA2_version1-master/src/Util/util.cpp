@@ -3,8 +3,15 @@
  * benchmarking DictionaryTrie
  */
 #include "util.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <string_view>
 
 /* Starts the timer. Saves the current time. */
 void Timer::begin_timer() { start = std::chrono::high_resolution_clock::now(); }
@@ -21,93 +28,255 @@ long long Timer::end_timer() {
         .count();
 }
 
+namespace {
+
+/* Return true for the characters operator>> skips between words */
+inline bool isBlank(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+/**
+ * Parse the line [begin, end) into record. Return false if it has no
+ * frequency, a frequency above UINT_MAX or no phrase. Like the old
+ * stream loader, the phrase ends before a "." word. The runs of
+ * whitespace inside the phrase become single spaces, written in place
+ * only where the line differs, so a line already in that form is not
+ * written to at all.
+ */
+bool parseLine(char* begin, char* end, DictionaryTrie::Record& record) {
+    char* p = begin;
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
+    }
+    unsigned int freq = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        unsigned int digit = *p - '0';
+        if (freq > (UINT_MAX - digit) / 10) {
+            return false;
+        }
+        freq = freq * 10 + digit;
+        p++;
+    }
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+
+    // p is at the start of a word, or at end once the words are done
+    char* phrase = p;
+    char* out = p;
+    while (p < end) {
+        char* word = p;
+        while (p < end && !isBlank(*p)) {
+            p++;
+        }
+        size_t length = p - word;
+        if (length == 1 && *word == '.') {
+            break;
+        }
+        if (out != phrase) {
+            if (*out != ' ') {
+                *out = ' ';
+            }
+            out++;
+        }
+        if (out != word) {
+            memmove(out, word, length);
+        }
+        out += length;
+        while (p < end && isBlank(*p)) {
+            p++;
+        }
+    }
+    if (out == phrase) {
+        return false;
+    }
+    record.word = string_view(phrase, out - phrase);
+    record.freq = freq;
+    return true;
+}
+
+/* Return the end of the line starting at p, not past end */
+inline char* lineEnd(char* p, char* end) {
+    char* newline = static_cast<char*>(memchr(p, '\n', end - p));
+    return newline == nullptr ? end : newline;
+}
+
+/* Append the records of the lines of [begin, end) to records */
+void parseLines(char* begin, char* end,
+                vector<DictionaryTrie::Record>& records) {
+    DictionaryTrie::Record record;
+    for (char* p = begin; p < end;) {
+        char* eol = lineEnd(p, end);
+        if (parseLine(p, eol, record)) {
+            records.push_back(record);
+        }
+        p = eol == end ? end : eol + 1;
+    }
+}
+
+}  // namespace
+
+/* Create a MappedFile with no file mapped */
+MappedFile::MappedFile() : data(nullptr), length(0) {}
+
+/* Unmap the file */
+MappedFile::~MappedFile() { close(); }
+
+/* Map the file at path privately, readable and writable */
+bool MappedFile::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (info.st_size == 0) {  // mmap cannot map an empty file
+        ::close(fd);
+        return true;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+    data = static_cast<char*>(mapping);
+    length = info.st_size;
+    return true;
+}
+
+/* Unmap the file */
+void MappedFile::close() {
+    if (data != nullptr) {
+        munmap(data, length);
+    }
+    data = nullptr;
+    length = 0;
+}
+
 /* Load all the words in word stream into the dictionary trie */
 void Utils::loadDict(DictionaryTrie& dict, istream& words) {
-    unsigned int freq;
-    string data = "";
-    string tempWord;
-    string word;
-    vector<string> wordString;
-    unsigned int i;
+    string data;
+    DictionaryTrie::Record record;
     while (getline(words, data)) {
-        tempWord = "";
-        word = "";
-        data = data + " .";
-        istringstream iss(data);
-        iss >> freq;
-        while (1) {
-            iss >> tempWord;
-            if (tempWord == ".") break;
-            if (tempWord.length() > 0) wordString.push_back(tempWord);
+        if (parseLine(&data[0], &data[0] + data.size(), record)) {
+            dict.insert(record.word, record.freq);
         }
-        for (i = 0; i < wordString.size(); i++) {
-            if (i > 0) word = word + " ";
-            word = word + wordString[i];
-        }
-        dict.insert(word, freq);
-        wordString.clear();
-        if (words.eof()) break;
     }
 }
 
 /* Load numWords from words stream into the dictionary trie */
 void Utils::loadDict(DictionaryTrie& dict, istream& words,
                      unsigned int numWords) {
-    unsigned int freq;
-    string data = "";
-    string tempWord;
-    string word;
-    vector<string> wordString;
-    unsigned int i;
-    unsigned int j = 0;
-    for (; j < numWords; j++) {
-        getline(words, data);
-        tempWord = "";
-        word = "";
-        data = data + " .";
-        istringstream iss(data);
-        iss >> freq;
-        while (1) {
-            iss >> tempWord;
-            if (tempWord == ".") break;
-            if (tempWord.length() > 0) wordString.push_back(tempWord);
-        }
-        for (i = 0; i < wordString.size(); i++) {
-            if (i > 0) word = word + " ";
-            word = word + wordString[i];
+    string data;
+    DictionaryTrie::Record record;
+    for (unsigned int j = 0; j < numWords && getline(words, data); j++) {
+        if (parseLine(&data[0], &data[0] + data.size(), record)) {
+            dict.insert(record.word, record.freq);
         }
-        dict.insert(word, freq);
-        wordString.clear();
-        if (words.eof()) break;
     }
 }
 
 /* Load all the words in word stream into a vector */
 void Utils::loadDict(vector<string>& dict, istream& words) {
-    unsigned int junk;
-    string data = "";
-    string tempWord;
-    string word;
-    vector<string> wordString;
-    unsigned int i;
-
+    string data;
+    DictionaryTrie::Record record;
     while (getline(words, data)) {
-        tempWord = "";
-        word = "";
-        data = data + " .";
-        istringstream iss(data);
-        iss >> junk;
-        while (1) {
-            iss >> tempWord;
-            if (tempWord == ".") break;
-            if (tempWord.length() > 0) wordString.push_back(tempWord);
+        if (parseLine(&data[0], &data[0] + data.size(), record)) {
+            dict.push_back(string(record.word));
         }
-        for (i = 0; i < wordString.size(); i++) {
-            if (i > 0) word = word + " ";
-            word = word + wordString[i];
+    }
+}
+
+/* Load the file at fileName into the dictionary, in file order */
+bool Utils::loadDictFile(DictionaryTrie& dict, const string& fileName) {
+    MappedFile file;
+    if (!file.open(fileName)) {
+        return false;
+    }
+    DictionaryTrie::Record record;
+    for (char* p = file.begin(); p < file.end();) {
+        char* eol = lineEnd(p, file.end());
+        if (parseLine(p, eol, record)) {
+            dict.insert(record.word, record.freq);
         }
-        dict.push_back(word);
-        wordString.clear();
-        if (words.eof()) break;
+        p = eol == file.end() ? eol : eol + 1;
+    }
+    return true;
+}
+
+/* Load the file at fileName with a parallel parse and a bulk build */
+bool Utils::loadDictFileBalanced(DictionaryTrie& dict,
+                                 const string& fileName,
+                                 unsigned int numThreads) {
+    MappedFile file;
+    if (!file.open(fileName)) {
+        return false;
+    }
+    vector<DictionaryTrie::Record> records =
+        parseRecords(file.begin(), file.end(), numThreads);
+    dict.bulkBuild(records);
+    return true;
+}
+
+/* Load the file at fileName into a substring index */
+bool Utils::loadInfixIndex(InfixIndex& index, const string& fileName,
+                           unsigned int numThreads) {
+    MappedFile file;
+    if (!file.open(fileName)) {
+        return false;
+    }
+    vector<DictionaryTrie::Record> records =
+        parseRecords(file.begin(), file.end(), numThreads);
+    index.build(records);
+    return true;
+}
+
+/**
+ * Parse the lines of [begin, end) into records. Each worker parses a
+ * few pieces that start and stop at line ends, and the pieces are
+ * joined in file order.
+ */
+vector<DictionaryTrie::Record> Utils::parseRecords(char* begin, char* end,
+                                                   unsigned int numThreads) {
+    const size_t PIECES_PER_THREAD = 4;
+    const size_t MIN_PIECE = 1 << 16;
+
+    vector<DictionaryTrie::Record> records;
+    if (numThreads == 1 || end - begin < (ptrdiff_t)(2 * MIN_PIECE)) {
+        parseLines(begin, end, records);
+        return records;
+    }
+
+    ThreadPool pool(numThreads);
+    size_t numPieces = min<size_t>(pool.size() * PIECES_PER_THREAD,
+                                   (end - begin) / MIN_PIECE);
+    vector<char*> cuts(1, begin);
+    for (size_t i = 1; i < numPieces; i++) {
+        char* cut = begin + (end - begin) * i / numPieces;
+        // move the cut past the end of its line
+        char* eol = lineEnd(max(cut, cuts.back()), end);
+        cuts.push_back(eol == end ? end : eol + 1);
+    }
+    cuts.push_back(end);
+
+    vector<vector<DictionaryTrie::Record>> pieces(numPieces);
+    pool.run(numPieces, [&](size_t i, unsigned int) {
+        parseLines(cuts[i], cuts[i + 1], pieces[i]);
+    });
+    size_t total = 0;
+    for (const vector<DictionaryTrie::Record>& piece : pieces) {
+        total += piece.size();
+    }
+    records.reserve(total);
+    for (const vector<DictionaryTrie::Record>& piece : pieces) {
+        records.insert(records.end(), piece.begin(), piece.end());
     }
+    return records;
 }
@@ -7,9 +7,12 @@
 #define UTIL_HPP
 
 #include <chrono>
+#include <cstddef>
 #include <iostream>
+#include <string>
 #include <vector>
 #include "DictionaryTrie.hpp"
+#include "InfixIndex.hpp"
 
 using namespace std;
 
@@ -28,7 +31,43 @@ class Timer {
     long long end_timer();
 };
 
-/** Contains useful functions to parse input file */
+/**
+ * A file mapped into memory privately. The bytes may be written, which
+ * copies the touched pages and never changes the file.
+ */
+class MappedFile {
+  private:
+    char* data;
+    size_t length;
+
+  public:
+    /* Create a MappedFile with no file mapped */
+    MappedFile();
+
+    /* Unmap the file */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /* Map the file at path, replacing any file mapped before. Return
+     * false if it cannot be mapped. */
+    bool open(const string& path);
+
+    /* Unmap the file */
+    void close();
+
+    /* The bytes of the file are [begin(), end()) */
+    char* begin() const { return data; }
+    char* end() const { return data + length; }
+};
+
+/**
+ * Contains useful functions to parse input file
+ * Every line of a dictionary file is a frequency followed by the words
+ * of a phrase. Words are separated by whitespace and joined with single
+ * spaces. Lines without a frequency or a phrase are skipped.
+ */
 class Utils {
   public:
     /* Load the words in the file into the dictionary */
@@ -40,6 +79,42 @@ class Utils {
 
     /* Load all the words in word stream into a vector */
     void static loadDict(vector<string>& dict, istream& words);
+
+    /**
+     * Load the file at fileName into the dictionary, in file order. The
+     * file is mapped and every line is parsed where it lies, so the
+     * only copy of a phrase is the one insert makes. Return false if
+     * the file cannot be mapped.
+     */
+    bool static loadDictFile(DictionaryTrie& dict, const string& fileName);
+
+    /**
+     * Load the file at fileName into the dictionary with
+     * parseRecords on numThreads threads (one per hardware thread if
+     * it is 0) followed by DictionaryTrie::bulkBuild. Return false if
+     * the file cannot be mapped.
+     */
+    bool static loadDictFileBalanced(DictionaryTrie& dict,
+                                     const string& fileName,
+                                     unsigned int numThreads = 0);
+
+    /**
+     * Parse the lines of [begin, end) into records, in file order. The
+     * text is split at line ends into pieces parsed on numThreads
+     * threads, one per hardware thread if it is 0. A phrase that is not
+     * already written with single spaces is compacted in place, so the
+     * words of the records point into [begin, end).
+     */
+    vector<DictionaryTrie::Record> static parseRecords(
+        char* begin, char* end, unsigned int numThreads = 1);
+
+    /**
+     * Index the phrases of the file at fileName for substring search,
+     * parsing it with parseRecords on numThreads threads. Return false
+     * if the file cannot be mapped.
+     */
+    bool static loadInfixIndex(InfixIndex& index, const string& fileName,
+                               unsigned int numThreads = 0);
 };
 
 #endif  // UTIL_HPP
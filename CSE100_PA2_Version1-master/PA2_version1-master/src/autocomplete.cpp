@@ -11,11 +11,19 @@
  * methods to respond and print the most frequent strings
  * in the terminal.
  *
+ * With --serve the program instead loads the dictionary once and
+ * answers "<k> <prefix/pattern>" request lines from stdin, or from
+ * every client of a Unix domain socket if a path follows, with the
+ * responses framed as described in AutocompleteServer.hpp.
+ *
+ * The dictionary may also be a snapshot written by DictionaryTrie::save
+ * (see compacttrie --snapshot), which loads without rebuilding the TST.
  */
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include "AutocompleteServer.hpp"
 #include "DictionaryTrie.hpp"
 #include "util.hpp"
 
@@ -53,35 +61,57 @@ bool fileValid(const char* fileName) {
  * cout << completion << endl;
  * cout << "Continue? (y/n)" << endl;
  *
- * arg 1 - Input file name (in format like freq_dict.txt)
+ * arg 1 - Input file name (in format like freq_dict.txt, or a snapshot)
+ * arg 2 - optional, --serve to answer requests instead of prompting
+ * arg 3 - optional, the path of the socket to serve on
  */
 int main(int argc, char** argv) {
     const int NUM_ARG = 2;
-    if (argc != NUM_ARG) {
+    const int SERVE_ARG = 2;
+    const int SOCKET_ARG = 3;
+    bool serve = argc > SERVE_ARG && string(argv[SERVE_ARG]) == "--serve";
+    if (argc != NUM_ARG && !(serve && argc <= SOCKET_ARG + 1)) {
         cout << "Invalid number of arguments.\n"
-             << "Usage: ./autocomplete <dictionary filename>" << endl;
+             << "Usage: ./autocomplete <dictionary filename>"
+             << " [--serve [socket path]]" << endl;
         return -1;
     }
     if (!fileValid(argv[1])) return -1;
 
+    if (serve) {
+        // stdout carries the responses, so progress goes to stderr
+        DictionaryTrie trie;
+        cerr << "Reading file: " << argv[1] << endl;
+        if (!trie.load(argv[1])) {
+            Utils::loadDictFile(trie, argv[1]);
+        }
+        AutocompleteServer server(trie);
+        if (argc == SERVE_ARG + 1) {
+            server.serve(0, 1);
+            return 0;
+        }
+        cerr << "Serving on " << argv[SOCKET_ARG] << endl;
+        if (!server.listenUnix(argv[SOCKET_ARG])) {
+            cerr << "Cannot listen on " << argv[SOCKET_ARG] << endl;
+            return -1;
+        }
+        return 0;
+    }
+
     DictionaryTrie* dt = new DictionaryTrie();
 
     // Read all the tokens of the file in order to get every word
     cout << "Reading file: " << argv[1] << endl;
 
-    ifstream in;
-    in.open(argv[1], ios::binary);
     string word;
 
-    Utils::loadDict(*dt, in);
-    in.close();
+    if (!dt->load(argv[1])) {
+        Utils::loadDictFile(*dt, argv[1]);
+    }
 
     char cont = 'y';
     unsigned int numberOfCompletions;
     vector<string> returnStr;
-    // pass the highest frequency of the subtree of a node to the
-    // node
-    dt->highestFreq(dt->root);
     while (cont == 'y') {
         // Ask the user to enter a prefix/pattern
         cout << "Enter a prefix/pattern to search for:" << endl;
@@ -90,10 +120,6 @@ int main(int argc, char** argv) {
         cout << "Enter a number of completions:" << endl;
         cin >> numberOfCompletions;
 
-        // Call cleanVisited() to make sure all visited in
-        // each node false to do DFS
-        dt->cleanVisited();
-
         // traverse through the input word to see which
         // method to call
         for (int i = 0; i < word.length(); i++) {
@@ -1,103 +1,1599 @@
 /**
  * Benchmark the autocomplete function in DictionaryTrie
+ *
+ * Usage: ./benchtrie <dictionary filename> [mode]
+ *
+ * Without a mode, run the harness: find, insert, predictCompletions
+ * and predictUnderscores of DictionaryTrie and of a std::map baseline,
+ * on queries drawn from the dictionary frequencies and on random
+ * letters, each timed per call over repeated rounds after a warmup.
+ * The p50, p90 and p99 latency, the queries per second, the nodes
+ * visited per call and the resident memory of both structures are
+ * printed as JSON, and nothing is read from stdin.
+ * Modes:
+ * cache
+ *   Compare predictCompletions with and without the completion cache
+ *   on prefixes of 1 to 4 characters taken from the dictionary, and
+ *   report the memory of the cache next to the memory of the nodes.
+ * prefix
+ *   Report the mean, median and 99th percentile latency of
+ *   predictCompletions for prefixes of 1 to 8 characters.
+ * batch
+ *   Report the throughput of predictCompletionsBatch with 1 thread up
+ *   to twice the number of hardware threads.
+ * underscore
+ *   Report the mean latency of predictUnderscores on patterns with 1
+ *   to 5 wildcards, made from dictionary words like the patterns of
+ *   data/underscore_*.txt.
+ * succinct
+ *   Compare building the trie from text with mapping a SuccinctTrie
+ *   file: time to the first answer, bytes per word and query latency.
+ * memory
+ *   Report the time to build and to destroy the trie, its node count
+ *   and node bytes, the resident set size after the build and the
+ *   latency of predictCompletions for prefixes of 1 to 3 characters.
+ * load
+ *   Compare the loaders: loadDict from a stream, loadDictFile, and
+ *   loadDictFileBalanced with 1 thread and one per hardware thread,
+ *   next to the time of only parsing the mapped file into records.
+ * bulk
+ *   Compare a TST inserted in file order with one made by bulkBuild:
+ *   build time, mean and maximum depth of the words, and the latency
+ *   of find and of predictCompletions.
+ * fuzzy
+ *   Report the mean, median and 99th percentile latency of
+ *   predictFuzzy with 1 and 2 edits, on prefixes of 3 to 8 characters
+ *   of dictionary words with as many random typos.
+ * alloc
+ *   Count the heap allocations per predictCompletions query, once the
+ *   buffers are warm, for the call returning a new vector, the call
+ *   with a SearchScratch, and the call writing into an output buffer,
+ *   next to their mean latency.
+ * art
+ *   Compare the TST engine with the ART engine: build time, node
+ *   bytes, find latency, the p50 and p99 latency of predictCompletions
+ *   for prefixes of 1 to 6 characters, and the mean latency of
+ *   predictUnderscores.
+ * hot
+ *   Replay prefixes of 1 to 4 characters drawn from a zipfian
+ *   distribution, asking for 5 or 10 completions, with no QueryCache
+ *   and with caches of growing capacity, once with queries only and
+ *   once with a frequency update every 100 queries. Report the hit
+ *   rate, the invalidations, the memory of the cache and the mean, p50
+ *   and p99 latency.
+ * infix
+ *   Build an InfixIndex and report its build time and bytes, then the
+ *   mean, p50 and p99 latency of predictInfix for substrings of 1 to
+ *   16 characters taken from inside phrases, next to the number of
+ *   places they occur at and the mean latency of scanning every phrase.
+ * snapshot
+ *   Compare the time to the first answer of a DictionaryTrie loaded
+ *   from text, bulk built from text and loaded from a snapshot written
+ *   by DictionaryTrie::save, best of a few runs, and the size of the
+ *   snapshot against the text.
+ * shards
+ *   Parse the file into records once, then compare bulkBuild of one
+ *   TST with ShardedDictionary::build on 1 thread up to twice the
+ *   number of hardware threads, best of a few runs, and the mean
+ *   latency of predictUnderscores on patterns starting with '_' in
+ *   one TST and fanned out over the shards.
+ * order
+ *   Compare the DEPTH_FIRST and BEST_FIRST completion searches on
+ *   prefixes of 1 to 6 characters, for 1 and 10 completions: mean
+ *   latency, and the nodes visited and subtrees pruned per query.
+ * layered
+ *   Apply batches of frequency updates and new phrases to a
+ *   LayeredDictionary over the whole dictionary, and compare the time
+ *   of a batch with rebuilding the trie for it, the query latency on
+ *   the layers against one trie, and the time of a compaction, with
+ *   queries running on another thread meanwhile.
  */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <random>
 #include <sstream>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
 #include "DictionaryTrie.hpp"
+#include "InfixIndex.hpp"
+#include "LayeredDictionary.hpp"
+#include "ShardedDictionary.hpp"
+#include "SuccinctTrie.hpp"
 #include "util.hpp"
 using namespace std;
 
-/* Test the runtime of autocompelte using different prefix and number of
- * completions
- */
-void testRuntime(string filename) {
-    const unsigned int NUM_COMP = 10;
+/* Number of allocations made by the program, for the alloc mode */
+static atomic<size_t> numAllocs(0);
+
+// The operators are kept out of line. Inlined into a caller, the malloc
+// and free in them would meet an operator delete or an operator new, and
+// g++ would warn that the allocation and deallocation do not match.
+__attribute__((noinline)) void* operator new(size_t size) {
+    numAllocs++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+// std::stable_sort takes its buffer from the nothrow form, and frees it
+// with the operator delete below
+__attribute__((noinline)) void* operator new(size_t size,
+                                             const nothrow_t&) noexcept {
+    numAllocs++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+/* Load the dictionary in filename into trie and its words into words */
+static void loadTrie(const string& filename, DictionaryTrie& trie,
+                     vector<string>& words) {
+    Utils::loadDictFile(trie, filename);
 
     ifstream in;
     in.open(filename, ios::binary);
+    Utils::loadDict(words, in);
+}
 
-    // Testing student's trie
-    cout << "\nLoading dictionary..." << endl;
+/* Return count prefixes of length len of random words */
+static vector<string> samplePrefixes(const vector<string>& words,
+                                     unsigned int len, unsigned int count,
+                                     mt19937& gen) {
+    vector<string> prefixes;
+    while (prefixes.size() < count) {
+        const string& word = words[gen() % words.size()];
+        if (word.length() >= len) {
+            prefixes.push_back(word.substr(0, len));
+        }
+    }
+    return prefixes;
+}
 
-    DictionaryTrie* trie = new DictionaryTrie();
-    Utils::loadDict(*trie, in);
+/* Return the average time in nanoseconds of predictCompletions on the
+ * given prefixes */
+static double timeQueries(const DictionaryTrie& trie,
+                          const vector<string>& prefixes,
+                          unsigned int numCompletions) {
+    Timer timer;
+    long long total = 0;
+    for (const string& prefix : prefixes) {
+        timer.begin_timer();
+        trie.predictCompletions(prefix, numCompletions);
+        total += timer.end_timer();
+    }
+    return double(total) / prefixes.size();
+}
+
+/* Compare the completion cache with the search of predictCompletions */
+void testCompletionCache(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int CACHE_DEPTH = 3;
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MAX_LEN = 4;
+
+    DictionaryTrie trie;
+    vector<string> words;
+    loadTrie(filename, trie, words);
+
+    // prefixes of every length up to MAX_LEN from random words
+    mt19937 gen(100);
+    vector<vector<string>> prefixes(MAX_LEN + 1);
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        prefixes[len] = samplePrefixes(words, len, NUM_QUERIES, gen);
+    }
+
+    cout << "Words: " << words.size() << ", nodes: " << trie.numNodes()
+         << ", node bytes: " << trie.nodeMemory() << endl;
+
+    vector<double> searchTime(MAX_LEN + 1);
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        searchTime[len] = timeQueries(trie, prefixes[len], NUM_COMP);
+    }
 
     Timer timer;
-    vector<string> results;
-    long long time = 0;
+    timer.begin_timer();
+    trie.buildCompletionCache(NUM_COMP, CACHE_DEPTH);
+    long long buildTime = timer.end_timer();
+    size_t cacheBytes = trie.completionCacheMemory();
+    cout << "Cache of " << NUM_COMP << " completions on " << CACHE_DEPTH
+         << " layers" << endl;
+    cout << "\tBuild time: " << buildTime << " nanoseconds." << endl;
+    cout << "\tCache bytes: " << cacheBytes << " ("
+         << double(cacheBytes) / words.size() << " per word)" << endl;
 
-    // Test 1: iterate through alphabet prefix
-    cout << "\nTest 1: prefix = \"iterating through alphabet\", "
-         << "numCompletions = " << NUM_COMP << endl;
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        // beyond CACHE_DEPTH the cache falls back to the search
+        double cachedTime = timeQueries(trie, prefixes[len], NUM_COMP);
+        cout << "Prefix length " << len << endl;
+        cout << "\tSearch: " << searchTime[len] << " nanoseconds." << endl;
+        cout << "\tCache:  " << cachedTime << " nanoseconds." << endl;
+    }
+}
+
+/* Time predictCompletions on prefixes from 1 to MAX_LEN characters.
+ * Short prefixes have large subtrees and lean on the highestFq pruning,
+ * long ones are mostly the walk down to the prefix. */
+void testPrefixLatency(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MAX_LEN = 8;
+    const double P50 = 0.5;
+    const double P99 = 0.99;
+
+    DictionaryTrie trie;
+    vector<string> words;
+    loadTrie(filename, trie, words);
+
+    mt19937 gen(100);
+    Timer timer;
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        vector<string> prefixes =
+            samplePrefixes(words, len, NUM_QUERIES, gen);
+        vector<long long> times;
+        long long total = 0;
+        for (const string& prefix : prefixes) {
+            timer.begin_timer();
+            trie.predictCompletions(prefix, NUM_COMP);
+            times.push_back(timer.end_timer());
+            total += times.back();
+        }
+        sort(times.begin(), times.end());
+        cout << "Prefix length " << len << endl;
+        cout << "\tMean: " << total / NUM_QUERIES << " nanoseconds." << endl;
+        cout << "\tp50:  " << times[NUM_QUERIES * P50] << " nanoseconds."
+             << endl;
+        cout << "\tp99:  " << times[NUM_QUERIES * P99] << " nanoseconds."
+             << endl;
+    }
+}
+
+/* Time predictCompletionsBatch on one batch of random prefixes with a
+ * growing number of threads */
+void testBatch(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 20000;
+    const unsigned int MAX_LEN = 4;
+
+    DictionaryTrie trie;
+    vector<string> words;
+    loadTrie(filename, trie, words);
+
+    // prefixes of 1 to MAX_LEN characters
+    mt19937 gen(100);
+    vector<string> prefixes;
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        vector<string> some =
+            samplePrefixes(words, len, NUM_QUERIES / MAX_LEN, gen);
+        prefixes.insert(prefixes.end(), some.begin(), some.end());
+    }
+    shuffle(prefixes.begin(), prefixes.end(), gen);
+
+    unsigned int cores = max(1u, thread::hardware_concurrency());
+    cout << "Hardware threads: " << cores << endl;
+    Timer timer;
+    double singleQps = 0;
+    for (unsigned int threads = 1; threads <= 2 * cores; threads *= 2) {
+        ThreadPool pool(threads);
+        timer.begin_timer();
+        vector<vector<string>> answers =
+            trie.predictCompletionsBatch(prefixes, NUM_COMP, pool);
+        long long time = timer.end_timer();
+        double qps = prefixes.size() / (time / 1e9);
+        if (threads == 1) {
+            singleQps = qps;
+        }
+        cout << "Threads: " << threads << endl;
+        cout << "\tTime taken: " << time << " nanoseconds." << endl;
+        cout << "\tQueries per second: " << qps << endl;
+        cout << "\tSpeedup: " << qps / singleQps << endl;
+    }
+}
+
+/* Time predictUnderscores on patterns with a growing number of '_' */
+void testUnderscores(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 200;
+    const unsigned int MAX_WILDCARDS = 5;
+
+    DictionaryTrie trie;
+    vector<string> words;
+    loadTrie(filename, trie, words);
+
+    mt19937 gen(100);
+    Timer timer;
+    for (unsigned int wild = 1; wild <= MAX_WILDCARDS; wild++) {
+        // replace wild random characters of random words by '_'
+        vector<string> patterns;
+        while (patterns.size() < NUM_QUERIES) {
+            string word = words[gen() % words.size()];
+            if (word.length() <= wild) {
+                continue;
+            }
+            for (unsigned int i = 0; i < wild;) {
+                size_t pos = gen() % word.length();
+                if (word[pos] != '_') {
+                    word[pos] = '_';
+                    i++;
+                }
+            }
+            patterns.push_back(word);
+        }
+
+        long long total = 0;
+        unsigned int found = 0;
+        for (const string& pattern : patterns) {
+            timer.begin_timer();
+            vector<string> results =
+                trie.predictUnderscores(pattern, NUM_COMP);
+            total += timer.end_timer();
+            found += results.size();
+        }
+        cout << "Wildcards: " << wild << endl;
+        cout << "\tMean: " << total / NUM_QUERIES << " nanoseconds." << endl;
+        cout << "\tResults found: " << found << endl;
+    }
+}
+
+/* Time predictFuzzy on mistyped prefixes, with as many typos as edits
+ * allowed */
+void testFuzzy(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MIN_LEN = 3;
+    const unsigned int MAX_LEN = 8;
+    const unsigned int MAX_EDITS = 2;
+    const double P50 = 0.5;
+    const double P99 = 0.99;
+
+    DictionaryTrie trie;
+    vector<string> words;
+    loadTrie(filename, trie, words);
+
+    mt19937 gen(100);
+    Timer timer;
+    for (unsigned int edits = 1; edits <= MAX_EDITS; edits++) {
+        // substitute, insert or delete a random letter edits times
+        vector<string> prefixes;
+        while (prefixes.size() < NUM_QUERIES) {
+            unsigned int len = MIN_LEN + gen() % (MAX_LEN - MIN_LEN + 1);
+            string prefix = samplePrefixes(words, len, 1, gen)[0];
+            for (unsigned int i = 0; i < edits; i++) {
+                size_t pos = gen() % prefix.length();
+                char letter = 'a' + gen() % 26;
+                switch (gen() % 3) {
+                    case 0:
+                        prefix[pos] = letter;
+                        break;
+                    case 1:
+                        prefix.insert(prefix.begin() + pos, letter);
+                        break;
+                    default:
+                        prefix.erase(pos, 1);
+                }
+            }
+            if (!prefix.empty()) {
+                prefixes.push_back(prefix);
+            }
+        }
+
+        vector<long long> times;
+        long long total = 0;
+        unsigned int found = 0;
+        for (const string& prefix : prefixes) {
+            timer.begin_timer();
+            found += trie.predictFuzzy(prefix, edits, NUM_COMP).size();
+            times.push_back(timer.end_timer());
+            total += times.back();
+        }
+        sort(times.begin(), times.end());
+        cout << "Edits: " << edits << endl;
+        cout << "\tMean: " << total / NUM_QUERIES << " nanoseconds." << endl;
+        cout << "\tp50:  " << times[NUM_QUERIES * P50] << " nanoseconds."
+             << endl;
+        cout << "\tp99:  " << times[NUM_QUERIES * P99] << " nanoseconds."
+             << endl;
+        cout << "\tResults found: " << found << endl;
+    }
+}
+
+/* Return the average time in nanoseconds of predictCompletions of trie
+ * on the given prefixes, for any trie type */
+template <typename Trie>
+static double timeTrie(const Trie& trie, const vector<string>& prefixes,
+                       unsigned int numCompletions) {
+    Timer timer;
     timer.begin_timer();
-    unsigned int count = 0;
-    for (char c = 'a'; c <= 'z'; c++) {
-        results = trie->predictCompletions(string(1, c), NUM_COMP);
-        count += results.size();
+    size_t found = 0;
+    for (const string& prefix : prefixes) {
+        found += trie.predictCompletions(prefix, numCompletions).size();
     }
-    time = timer.end_timer();
-    cout << "\tTime taken: " << time << " nanoseconds." << endl;
-    cout << "\tResults found: " << count << endl;
+    return double(timer.end_timer()) / prefixes.size();
+}
+
+/* Compare a DictionaryTrie built from text with a mapped SuccinctTrie */
+void testSuccinct(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MAX_LEN = 4;
+    const string trieFile = "benchtrie.trie";
 
-    // Test 2: "a" as prefix
-    cout << "\nTest 2: prefix = \"a\", numCompletions = " << NUM_COMP << endl;
+    // cold start from text: load and answer one query
+    Timer timer;
     timer.begin_timer();
-    results = trie->predictCompletions("a", NUM_COMP);
-    time = timer.end_timer();
-    cout << "\tTime taken: " << time << " nanoseconds." << endl;
-    cout << "\tResults found: " << results.size() << endl;
+    DictionaryTrie dict;
+    Utils::loadDictFile(dict, filename);
+    dict.predictCompletions("a", NUM_COMP);
+    long long textStart = timer.end_timer();
 
-    // Test 3: "the" as prefix
-    cout << "\nTest 3: prefix= \"the\", numCompletions = " << NUM_COMP << endl;
+    // the offline step
     timer.begin_timer();
-    results = trie->predictCompletions("the", NUM_COMP);
-    time = timer.end_timer();
-    cout << "\tTime taken: " << time << " nanoseconds." << endl;
-    cout << "\tResults found: " << results.size() << endl;
+    if (!SuccinctTrie::write(dict, trieFile)) {
+        cout << "Could not write " << trieFile << endl;
+        return;
+    }
+    long long writeTime = timer.end_timer();
 
-    // Test 4: "app" as prefix
-    cout << "\nTest 4: prefix= \"app\", numCompletions = " << NUM_COMP << endl;
+    // cold start from the file: map it and answer one query
     timer.begin_timer();
-    results = trie->predictCompletions("app", NUM_COMP);
-    time = timer.end_timer();
-    cout << "\tTime taken: " << time << " nanoseconds." << endl;
-    cout << "\tResults found: " << results.size() << endl;
+    SuccinctTrie trie;
+    trie.open(trieFile);
+    trie.predictCompletions("a", NUM_COMP);
+    long long mapStart = timer.end_timer();
+
+    size_t words = trie.numWords();
+    size_t nodeBytes = dict.nodeMemory();
+    cout << "Words: " << words << endl;
+    cout << "DictionaryTrie from text" << endl;
+    cout << "\tTime to first answer: " << textStart << " nanoseconds."
+         << endl;
+    cout << "\tNode bytes per word: " << double(nodeBytes) / words << endl;
+    cout << "SuccinctTrie file" << endl;
+    cout << "\tWrite time: " << writeTime << " nanoseconds." << endl;
+    cout << "\tTime to first answer: " << mapStart << " nanoseconds." << endl;
+    cout << "\tFile bytes per word: " << double(trie.sizeInBytes()) / words
+         << endl;
+
+    vector<string> all;
+    ifstream in;
+    in.open(filename, ios::binary);
+    Utils::loadDict(all, in);
+    mt19937 gen(100);
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        vector<string> prefixes = samplePrefixes(all, len, NUM_QUERIES, gen);
+        cout << "Prefix length " << len << endl;
+        cout << "\tDictionaryTrie: " << timeTrie(dict, prefixes, NUM_COMP)
+             << " nanoseconds." << endl;
+        cout << "\tSuccinctTrie:   " << timeTrie(trie, prefixes, NUM_COMP)
+             << " nanoseconds." << endl;
+    }
+    trie.close();
+    remove(trieFile.c_str());
+}
+
+/* Return the resident set size of the process in kilobytes, or 0 if
+ * /proc/self/status cannot be read */
+static size_t residentKilobytes() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            return stoul(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+/* Report the cost of building, holding and destroying the trie */
+void testMemory(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MAX_LEN = 3;
+
+    vector<string> words;
+    ifstream in;
+    in.open(filename, ios::binary);
+    Utils::loadDict(words, in);
 
-    // Test 5: "man" as prefix
-    cout << "\nTest 5: prefix= \"man\", numCompletions = " << NUM_COMP << endl;
+    size_t rssBefore = residentKilobytes();
+    Timer timer;
     timer.begin_timer();
-    results = trie->predictCompletions("man", NUM_COMP);
-    time = timer.end_timer();
-    cout << "\tTime taken: " << time << " nanoseconds." << endl;
-    cout << "\tResults found: " << results.size() << endl;
+    DictionaryTrie* trie = new DictionaryTrie();
+    Utils::loadDictFile(*trie, filename);
+    long long buildTime = timer.end_timer();
+    size_t rssAfter = residentKilobytes();
 
-    // Addtional tests
-    cout << "\nWould you like to run additional tests? (y/n) ";
-    string response;
-    getline(cin, response);
+    cout << "Words: " << words.size() << ", nodes: " << trie->numNodes()
+         << endl;
+    cout << "\tNode size: " << sizeof(DictionaryTrie::TrieNode)
+         << " bytes, node bytes per word: "
+         << double(trie->nodeMemory()) / words.size() << endl;
+    cout << "\tBuild time: " << buildTime << " nanoseconds." << endl;
+    cout << "\tRSS of the trie: " << rssAfter - rssBefore << " kB" << endl;
 
-    if (response.compare("y") == 0) {
-        string prefix;
-        string ws;
+    mt19937 gen(100);
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        vector<string> prefixes = samplePrefixes(words, len, NUM_QUERIES, gen);
+        cout << "\tPrefix length " << len << ": "
+             << timeQueries(*trie, prefixes, NUM_COMP) << " nanoseconds."
+             << endl;
+    }
 
-        cout << "\nEnter prefix: ";
+    timer.begin_timer();
+    delete trie;
+    long long teardownTime = timer.end_timer();
+    cout << "\tTeardown time: " << teardownTime << " nanoseconds." << endl;
+}
 
-        while (getline(cin, prefix)) {
-            cout << "Enter numCompletions: ";
-            getline(cin, ws);
-            int numCompletions = stoi(ws);
+/* Report the time of every way to load the dictionary */
+void testLoad(string filename) {
+    const int ROUNDS = 5;
+    unsigned int hardware = thread::hardware_concurrency();
 
-            cout << "\nUser Test: prefix = \"" << prefix
-                 << "\", numCompletions = " << numCompletions << endl;
+    // every loader is timed ROUNDS times and the best time is kept
+    auto best = [&](const string& name, const function<void()>& load) {
+        long long fastest = 0;
+        for (int r = 0; r < ROUNDS; r++) {
+            Timer timer;
             timer.begin_timer();
-            results = trie->predictCompletions(prefix, numCompletions);
-            time = timer.end_timer();
-            cout << "\tTime taken: " << time << " nanoseconds." << endl;
-            cout << "\tResults found: " << results.size() << "\n\n";
-            cout << "Enter prefix: ";
+            load();
+            long long time = timer.end_timer();
+            if (r == 0 || time < fastest) {
+                fastest = time;
+            }
         }
+        cout << name << ": " << fastest / 1000000.0 << " ms" << endl;
+    };
+
+    best("loadDict from a stream", [&]() {
+        DictionaryTrie dict;
+        ifstream in;
+        in.open(filename, ios::binary);
+        Utils::loadDict(dict, in);
+    });
+    best("loadDictFile", [&]() {
+        DictionaryTrie dict;
+        Utils::loadDictFile(dict, filename);
+    });
+    vector<unsigned int> threadCounts = {1};
+    if (hardware > 1) {
+        threadCounts.push_back(hardware);
+    }
+    for (unsigned int threads : threadCounts) {
+        best("parseRecords, " + to_string(threads) + " threads", [&]() {
+            MappedFile file;
+            file.open(filename);
+            Utils::parseRecords(file.begin(), file.end(), threads);
+        });
+        best("loadDictFileBalanced, " + to_string(threads) + " threads",
+             [&]() {
+                 DictionaryTrie dict;
+                 Utils::loadDictFileBalanced(dict, filename, threads);
+             });
+    }
+}
+
+/* Print the mean and maximum number of nodes on the path to a word of
+ * trie, which is what find walks through */
+static void printDepths(const DictionaryTrie& trie) {
+    // DFS stack of (node, number of nodes on the path to it)
+    vector<pair<uint32_t, unsigned int>> toVisit;
+    if (trie.root != DictionaryTrie::NIL) {
+        toVisit.push_back(make_pair(trie.root, 1));
+    }
+    size_t words = 0;
+    size_t totalDepth = 0;
+    unsigned int maxDepth = 0;
+    while (!toVisit.empty()) {
+        const DictionaryTrie::TrieNode& node =
+            trie.getNode(toVisit.back().first);
+        unsigned int depth = toVisit.back().second;
+        toVisit.pop_back();
+        if (node.freq != 0) {
+            words++;
+            totalDepth += depth;
+            maxDepth = max(maxDepth, depth);
+        }
+        for (uint32_t child : {node.left, node.middle, node.right}) {
+            if (child != DictionaryTrie::NIL) {
+                toVisit.push_back(make_pair(child, depth + 1));
+            }
+        }
+    }
+    cout << "\tWord depth: mean " << double(totalDepth) / words << ", max "
+         << maxDepth << endl;
+}
+
+/* Compare a TST built in file order with a bulk built one */
+void testBulkBuild(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MAX_LEN = 3;
+
+    vector<string> words;
+    ifstream in;
+    in.open(filename, ios::binary);
+    Utils::loadDict(words, in);
+    vector<string> lookups = words;
+    mt19937 gen(100);
+    shuffle(lookups.begin(), lookups.end(), gen);
+    vector<vector<string>> prefixes(MAX_LEN + 1);
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        prefixes[len] = samplePrefixes(words, len, NUM_QUERIES, gen);
+    }
+
+    for (int bulk = 0; bulk < 2; bulk++) {
+        Timer timer;
+        timer.begin_timer();
+        DictionaryTrie trie;
+        if (bulk) {
+            Utils::loadDictFileBalanced(trie, filename, 1);
+        } else {
+            Utils::loadDictFile(trie, filename);
+        }
+        long long buildTime = timer.end_timer();
+
+        cout << (bulk ? "bulkBuild" : "insert in file order") << endl;
+        cout << "\tBuild time: " << buildTime << " nanoseconds." << endl;
+        printDepths(trie);
+
+        unsigned int found = 0;
+        timer.begin_timer();
+        for (const string& word : lookups) {
+            found += trie.find(word);
+        }
+        long long findTime = timer.end_timer();
+        cout << "\tfind: " << double(findTime) / lookups.size()
+             << " nanoseconds, " << found << " found." << endl;
+        for (unsigned int len = 1; len <= MAX_LEN; len++) {
+            cout << "\tPrefix length " << len << ": "
+                 << timeQueries(trie, prefixes[len], NUM_COMP)
+                 << " nanoseconds." << endl;
+        }
+    }
+}
+
+/**
+ * Run query on every prefix once to warm the buffers, then once more
+ * counting allocations, and print allocations per query and the mean
+ * latency.
+ */
+template <typename Query>
+static void countAllocations(const string& name,
+                             const vector<string>& prefixes, Query query) {
+    for (const string& prefix : prefixes) {
+        query(prefix);
+    }
+    Timer timer;
+    size_t before = numAllocs;
+    size_t found = 0;
+    timer.begin_timer();
+    for (const string& prefix : prefixes) {
+        found += query(prefix);
+    }
+    long long time = timer.end_timer();
+    size_t allocs = numAllocs - before;
+    cout << name << endl;
+    cout << "\tAllocations per query: " << double(allocs) / prefixes.size()
+         << endl;
+    cout << "\tMean: " << time / prefixes.size() << " nanoseconds." << endl;
+    cout << "\tResults found: " << found << endl;
+}
+
+/* Count the allocations of the three ways to call predictCompletions,
+ * with a top-k heap on the stack and one too large for it */
+void testAllocations(string filename) {
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MAX_LEN = 8;
+
+    DictionaryTrie trie;
+    vector<string> words;
+    loadTrie(filename, trie, words);
+
+    mt19937 gen(100);
+    vector<string> prefixes;
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        vector<string> some =
+            samplePrefixes(words, len, NUM_QUERIES / MAX_LEN, gen);
+        prefixes.insert(prefixes.end(), some.begin(), some.end());
+    }
+    shuffle(prefixes.begin(), prefixes.end(), gen);
+
+    for (unsigned int numComp : {10u, 4 * DictionaryTrie::STACK_HEAP}) {
+        cout << "numCompletions = " << numComp << endl;
+        DictionaryTrie::SearchScratch scratch;
+        vector<string> out;
+        countAllocations("new vector", prefixes, [&](const string& prefix) {
+            return trie.predictCompletions(prefix, numComp).size();
+        });
+        countAllocations("SearchScratch", prefixes, [&](const string& prefix) {
+            return trie.predictCompletions(prefix, numComp, scratch).size();
+        });
+        countAllocations("output buffer", prefixes, [&](const string& prefix) {
+            return trie.predictCompletions(prefix, numComp, scratch, out);
+        });
+    }
+}
+
+/* Compare the TST and the ART engines of DictionaryTrie on the same
+ * words and queries */
+void testArt(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MAX_LEN = 6;
+    const double P50 = 0.5;
+    const double P99 = 0.99;
+
+    vector<string> words;
+    ifstream in;
+    in.open(filename, ios::binary);
+    Utils::loadDict(words, in);
+    vector<string> lookups = words;
+    mt19937 gen(100);
+    shuffle(lookups.begin(), lookups.end(), gen);
+    vector<vector<string>> prefixes(MAX_LEN + 1);
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        prefixes[len] = samplePrefixes(words, len, NUM_QUERIES, gen);
+    }
+    // words with two of their characters replaced by '_'
+    vector<string> patterns;
+    while (patterns.size() < NUM_QUERIES / 10) {
+        string word = words[gen() % words.size()];
+        if (word.length() > 2) {
+            word[gen() % word.length()] = '_';
+            word[gen() % word.length()] = '_';
+            patterns.push_back(word);
+        }
+    }
+
+    for (DictionaryTrie::Engine engine :
+         {DictionaryTrie::TST, DictionaryTrie::ART}) {
+        Timer timer;
+        timer.begin_timer();
+        DictionaryTrie trie(engine);
+        Utils::loadDictFile(trie, filename);
+        long long buildTime = timer.end_timer();
+
+        cout << (engine == DictionaryTrie::TST ? "TST" : "ART") << endl;
+        cout << "\tBuild time: " << buildTime << " nanoseconds." << endl;
+        cout << "\tNode bytes: " << trie.nodeMemory() << endl;
+
+        unsigned int found = 0;
+        timer.begin_timer();
+        for (const string& word : lookups) {
+            found += trie.find(word);
+        }
+        long long findTime = timer.end_timer();
+        cout << "\tfind: " << double(findTime) / lookups.size()
+             << " nanoseconds, " << found << " found." << endl;
+
+        DictionaryTrie::SearchScratch scratch;
+        vector<string> out;
+        for (unsigned int len = 1; len <= MAX_LEN; len++) {
+            vector<long long> times;
+            for (const string& prefix : prefixes[len]) {
+                timer.begin_timer();
+                trie.predictCompletions(prefix, NUM_COMP, scratch, out);
+                times.push_back(timer.end_timer());
+            }
+            sort(times.begin(), times.end());
+            cout << "\tPrefix length " << len << ": p50 "
+                 << times[NUM_QUERIES * P50] << ", p99 "
+                 << times[NUM_QUERIES * P99] << " nanoseconds." << endl;
+        }
+
+        long long total = 0;
+        for (const string& pattern : patterns) {
+            timer.begin_timer();
+            trie.predictUnderscores(pattern, NUM_COMP);
+            total += timer.end_timer();
+        }
+        cout << "\tpredictUnderscores: " << total / patterns.size()
+             << " nanoseconds." << endl;
+    }
+}
+
+/* Replay zipfian prefixes against QueryCaches of growing capacity */
+void testQueryCache(string filename) {
+    const unsigned int NUM_QUERIES = 50000;
+    const unsigned int NUM_PREFIXES = 20000;
+    const unsigned int MAX_LEN = 4;
+    const unsigned int UPDATE_EVERY = 100;
+    const double ZIPF_S = 1.0;
+    const double P50 = 0.5;
+    const double P99 = 0.99;
+
+    DictionaryTrie trie;
+    vector<string> words;
+    loadTrie(filename, trie, words);
+
+    // distinct prefixes in random order, the first being the hottest
+    mt19937 gen(100);
+    vector<string> prefixes;
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        vector<string> some =
+            samplePrefixes(words, len, NUM_PREFIXES / MAX_LEN, gen);
+        prefixes.insert(prefixes.end(), some.begin(), some.end());
+    }
+    sort(prefixes.begin(), prefixes.end());
+    prefixes.erase(unique(prefixes.begin(), prefixes.end()), prefixes.end());
+    shuffle(prefixes.begin(), prefixes.end(), gen);
+
+    // rank r is drawn with probability proportional to 1 / r^ZIPF_S
+    vector<double> cdf(prefixes.size());
+    double sum = 0;
+    for (size_t r = 0; r < prefixes.size(); r++) {
+        sum += 1 / pow(r + 1, ZIPF_S);
+        cdf[r] = sum;
+    }
+    uniform_real_distribution<double> uniform(0, sum);
+    vector<string> replay;
+    vector<unsigned int> numComps;
+    for (unsigned int i = 0; i < NUM_QUERIES; i++) {
+        size_t r = lower_bound(cdf.begin(), cdf.end(), uniform(gen)) -
+                   cdf.begin();
+        replay.push_back(prefixes[min(r, prefixes.size() - 1)]);
+        numComps.push_back(gen() % 2 == 0 ? 5 : 10);
+    }
+    cout << "Distinct prefixes: " << prefixes.size() << endl;
+
+    Timer timer;
+    DictionaryTrie::SearchScratch scratch;
+    vector<string> out;
+    for (int updates = 0; updates < 2; updates++) {
+        cout << (updates ? "With updates" : "Queries only") << endl;
+        for (size_t capacity : {0, 256, 1024, 4096}) {
+            if (capacity == 0) {
+                trie.disableQueryCache();
+            } else {
+                trie.enableQueryCache(capacity);
+            }
+            vector<long long> times;
+            long long total = 0;
+            for (unsigned int i = 0; i < NUM_QUERIES; i++) {
+                if (updates && i % UPDATE_EVERY == 0) {
+                    trie.updateFrequency(words[gen() % words.size()],
+                                         1 + gen() % 1000);
+                }
+                timer.begin_timer();
+                trie.predictCompletions(replay[i], numComps[i], scratch,
+                                        out);
+                times.push_back(timer.end_timer());
+                total += times.back();
+            }
+            sort(times.begin(), times.end());
+            cout << "\tCapacity " << capacity << endl;
+            if (capacity != 0) {
+                QueryCache::Stats stats = trie.queryCache()->stats();
+                cout << "\t\tHit rate: "
+                     << double(stats.hits) / (stats.hits + stats.misses)
+                     << ", invalidations: " << stats.invalidations
+                     << ", evictions: " << stats.evictions << endl;
+                cout << "\t\tCache bytes: "
+                     << trie.queryCache()->memoryUsage() << endl;
+            }
+            cout << "\t\tMean: " << total / NUM_QUERIES << ", p50: "
+                 << times[NUM_QUERIES * P50]
+                 << ", p99: " << times[NUM_QUERIES * P99]
+                 << " nanoseconds." << endl;
+        }
+    }
+    trie.disableQueryCache();
+}
+
+/* Time predictInfix on short and long substrings against a scan */
+void testInfix(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 1000;
+    const unsigned int NUM_SCANS = 20;
+    const double P50 = 0.5;
+    const double P99 = 0.99;
+
+    vector<string> words;
+    ifstream in;
+    in.open(filename, ios::binary);
+    Utils::loadDict(words, in);
+
+    Timer timer;
+    timer.begin_timer();
+    InfixIndex index;
+    Utils::loadInfixIndex(index, filename);
+    long long buildTime = timer.end_timer();
+    cout << "Build time: " << buildTime << " nanoseconds." << endl;
+    cout << "Phrases: " << index.numPhrases()
+         << ", bytes: " << index.memoryUsage() << endl;
+
+    mt19937 gen(100);
+    for (unsigned int len : {1u, 2u, 3u, 5u, 8u, 16u}) {
+        // substrings starting anywhere in a phrase
+        vector<string> substrings;
+        while (substrings.size() < NUM_QUERIES) {
+            const string& word = words[gen() % words.size()];
+            if (word.length() >= len) {
+                size_t at = gen() % (word.length() - len + 1);
+                substrings.push_back(word.substr(at, len));
+            }
+        }
+
+        vector<long long> times;
+        long long total = 0;
+        size_t places = 0;
+        for (const string& substring : substrings) {
+            timer.begin_timer();
+            index.predictInfix(substring, NUM_COMP);
+            times.push_back(timer.end_timer());
+            total += times.back();
+            places += index.countOccurrences(substring);
+        }
+        sort(times.begin(), times.end());
+
+        long long scanTotal = 0;
+        size_t scanned = 0;
+        for (unsigned int i = 0; i < NUM_SCANS; i++) {
+            timer.begin_timer();
+            for (const string& word : words) {
+                scanned += word.find(substrings[i]) != string::npos;
+            }
+            scanTotal += timer.end_timer();
+        }
+
+        cout << "Substring length " << len << endl;
+        cout << "\tPlaces per substring: " << places / NUM_QUERIES << endl;
+        cout << "\tMean: " << total / NUM_QUERIES << ", p50: "
+             << times[NUM_QUERIES * P50]
+             << ", p99: " << times[NUM_QUERIES * P99] << " nanoseconds."
+             << endl;
+        cout << "\tScan: " << scanTotal / NUM_SCANS << " nanoseconds, "
+             << scanned / NUM_SCANS << " phrases matched." << endl;
+    }
+}
+
+/* Compare the time to the first answer from text and from a snapshot */
+void testSnapshot(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_RUNS = 3;
+    const string snapshotFile = "benchtrie.snapshot";
+
+    DictionaryTrie built;
+    Utils::loadDictFile(built, filename);
+    Timer timer;
+    timer.begin_timer();
+    if (!built.save(snapshotFile)) {
+        cout << "Could not write " << snapshotFile << endl;
+        return;
+    }
+    long long saveTime = timer.end_timer();
+    vector<string> expected = built.predictCompletions("a", NUM_COMP);
+
+    // each way of starting, timed up to and including the first answer
+    vector<pair<string, function<void(DictionaryTrie&)>>> starts = {
+        {"loadDictFile",
+         [&](DictionaryTrie& trie) { Utils::loadDictFile(trie, filename); }},
+        {"loadDictFileBalanced",
+         [&](DictionaryTrie& trie) {
+             Utils::loadDictFileBalanced(trie, filename);
+         }},
+        {"snapshot load",
+         [&](DictionaryTrie& trie) { trie.load(snapshotFile); }}};
+    for (const auto& start : starts) {
+        long long best = 0;
+        for (unsigned int run = 0; run < NUM_RUNS; run++) {
+            timer.begin_timer();
+            DictionaryTrie trie;
+            start.second(trie);
+            vector<string> answer = trie.predictCompletions("a", NUM_COMP);
+            long long time = timer.end_timer();
+            if (run == 0 || time < best) {
+                best = time;
+            }
+            if (answer != expected) {
+                cout << start.first << " gave another answer!" << endl;
+            }
+        }
+        cout << start.first << endl;
+        cout << "\tTime to first answer: " << best << " nanoseconds."
+             << endl;
+    }
+
+    ifstream text(filename, ios::binary | ios::ate);
+    ifstream snapshot(snapshotFile, ios::binary | ios::ate);
+    cout << "Save time: " << saveTime << " nanoseconds." << endl;
+    cout << "Text bytes: " << text.tellg()
+         << ", snapshot bytes: " << snapshot.tellg() << endl;
+    remove(snapshotFile.c_str());
+}
+
+/* Time building one TST and a ShardedDictionary from the same records,
+ * then the underscore patterns only the sharded one fans out */
+void testShards(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 200;
+    const int ROUNDS = 3;
+    unsigned int hardware = max(1u, thread::hardware_concurrency());
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        cout << "Cannot map " << filename << endl;
+        return;
+    }
+    vector<DictionaryTrie::Record> records =
+        Utils::parseRecords(file.begin(), file.end(), hardware);
+
+    // every build is timed ROUNDS times on a fresh copy and the best
+    // time is kept
+    auto best = [&](const string& name, const function<void()>& build) {
+        long long fastest = 0;
+        for (int r = 0; r < ROUNDS; r++) {
+            Timer timer;
+            timer.begin_timer();
+            build();
+            long long time = timer.end_timer();
+            if (r == 0 || time < fastest) {
+                fastest = time;
+            }
+        }
+        cout << name << ": " << fastest / 1000000.0 << " ms" << endl;
+    };
+    best("bulkBuild, one TST", [&]() {
+        vector<DictionaryTrie::Record> copy = records;
+        DictionaryTrie trie;
+        trie.bulkBuild(copy);
+    });
+    for (unsigned int threads = 1; threads <= 2 * hardware; threads *= 2) {
+        best("ShardedDictionary::build, " + to_string(threads) + " threads",
+             [&]() {
+                 ShardedDictionary dict(threads);
+                 dict.build(records);
+             });
+    }
+
+    vector<DictionaryTrie::Record> copy = records;
+    DictionaryTrie single;
+    single.bulkBuild(copy);
+    ShardedDictionary sharded;
+    sharded.build(records);
+
+    // the first character and one more of random phrases become '_'
+    mt19937 gen(100);
+    vector<string> patterns;
+    while (patterns.size() < NUM_QUERIES) {
+        string word(records[gen() % records.size()].word);
+        if (word.length() < 3 || word.find('_') != string::npos) {
+            continue;
+        }
+        word[0] = '_';
+        word[1 + gen() % (word.length() - 1)] = '_';
+        patterns.push_back(word);
+    }
+    long long singleTime = 0;
+    long long shardedTime = 0;
+    Timer timer;
+    for (const string& pattern : patterns) {
+        timer.begin_timer();
+        vector<string> expected = single.predictUnderscores(pattern, NUM_COMP);
+        singleTime += timer.end_timer();
+        timer.begin_timer();
+        vector<string> results = sharded.predictUnderscores(pattern, NUM_COMP);
+        shardedTime += timer.end_timer();
+        if (results != expected) {
+            cout << "The shards gave another answer for " << pattern << endl;
+        }
+    }
+    cout << "Shards: " << sharded.numShards() << endl;
+    cout << "predictUnderscores, leading '_'" << endl;
+    cout << "\tOne TST: " << singleTime / NUM_QUERIES << " nanoseconds."
+         << endl;
+    cout << "\tSharded: " << shardedTime / NUM_QUERIES << " nanoseconds."
+         << endl;
+}
+
+/* Run both completion search orders on the same prefixes and report
+ * their latency and node counts */
+void testSearchOrder(string filename) {
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int MAX_LEN = 6;
+
+    DictionaryTrie trie;
+    vector<string> words;
+    loadTrie(filename, trie, words);
+
+    mt19937 gen(100);
+    Timer timer;
+    DictionaryTrie::SearchScratch scratch;
+    vector<string> out;
+    const pair<DictionaryTrie::SearchOrder, string> orders[] = {
+        {DictionaryTrie::DEPTH_FIRST, "Depth-first"},
+        {DictionaryTrie::BEST_FIRST, "Best-first"}};
+    for (unsigned int len = 1; len <= MAX_LEN; len++) {
+        vector<string> prefixes =
+            samplePrefixes(words, len, NUM_QUERIES, gen);
+        for (unsigned int numComp : {1u, 10u}) {
+            cout << "Prefix length " << len << ", " << numComp
+                 << " completions" << endl;
+            for (const auto& order : orders) {
+                trie.setSearchOrder(order.first);
+                DictionaryTrie::SearchStats stats;
+                long long total = 0;
+                for (const string& prefix : prefixes) {
+                    timer.begin_timer();
+                    trie.predictCompletions(prefix, numComp, scratch, out,
+                                            &stats);
+                    total += timer.end_timer();
+                }
+                cout << "\t" << order.second << ": "
+                     << total / NUM_QUERIES << " nanoseconds, "
+                     << double(stats.nodesVisited) / NUM_QUERIES
+                     << " visited, "
+                     << double(stats.nodesPruned) / NUM_QUERIES
+                     << " pruned" << endl;
+            }
+        }
+    }
+}
+
+/* Time updates, queries and a compaction of a LayeredDictionary
+ * against rebuilding one trie */
+void testLayered(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const unsigned int NUM_QUERIES = 2000;
+    const unsigned int BATCH = 1000;
+    const unsigned int NUM_BATCHES = 5;
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        cout << "Cannot map " << filename << endl;
+        return;
+    }
+    vector<DictionaryTrie::Record> records =
+        Utils::parseRecords(file.begin(), file.end());
+    vector<DictionaryTrie::Record> copy = records;
+    DictionaryTrie single;
+    single.bulkBuild(copy);
+    copy = records;
+    DictionaryTrie base;
+    base.bulkBuild(copy);
+    LayeredDictionary layered(move(base));
+
+    // half of every batch updates a phrase, half adds a new one
+    mt19937 gen(100);
+    Timer timer;
+    long long updateTime = 0;
+    long long rebuildTime = 0;
+    for (unsigned int b = 0; b < NUM_BATCHES; b++) {
+        vector<pair<string, unsigned int>> batch;
+        for (unsigned int i = 0; i < BATCH; i++) {
+            unsigned int freq = 1 + gen() % 1000000;
+            if (i % 2 == 0) {
+                const DictionaryTrie::Record& r =
+                    records[gen() % records.size()];
+                batch.push_back(make_pair(string(r.word), freq));
+            } else {
+                string phrase;
+                for (int c = 0; c < 8; c++) {
+                    phrase.push_back('a' + gen() % 26);
+                }
+                batch.push_back(make_pair(phrase, freq));
+            }
+        }
+        timer.begin_timer();
+        for (const pair<string, unsigned int>& change : batch) {
+            if (!layered.updateFrequency(change.first, change.second)) {
+                layered.insert(change.first, change.second);
+            }
+        }
+        updateTime += timer.end_timer();
+
+        // the rebuild takes the changed records first, so they win
+        timer.begin_timer();
+        vector<DictionaryTrie::Record> rebuilt;
+        for (const pair<string, unsigned int>& change : batch) {
+            rebuilt.push_back({change.first, change.second});
+        }
+        rebuilt.insert(rebuilt.end(), records.begin(), records.end());
+        DictionaryTrie trie;
+        trie.bulkBuild(rebuilt);
+        rebuildTime += timer.end_timer();
+        for (const pair<string, unsigned int>& change : batch) {
+            if (!single.updateFrequency(change.first, change.second)) {
+                single.insert(change.first, change.second);
+            }
+        }
+    }
+    cout << "Batch of " << BATCH << " changes" << endl;
+    cout << "\tLayered: " << updateTime / NUM_BATCHES / 1000000.0 << " ms"
+         << endl;
+    cout << "\tRebuild: " << rebuildTime / NUM_BATCHES / 1000000.0 << " ms"
+         << endl;
+    cout << "Delta size: " << layered.deltaSize() << endl;
+
+    vector<string> words;
+    for (const DictionaryTrie::Record& r : records) {
+        words.push_back(string(r.word));
+    }
+    vector<string> prefixes;
+    for (unsigned int len = 1; len <= 4; len++) {
+        vector<string> some =
+            samplePrefixes(words, len, NUM_QUERIES / 4, gen);
+        prefixes.insert(prefixes.end(), some.begin(), some.end());
+    }
+    long long singleTime = 0;
+    long long layeredTime = 0;
+    for (const string& prefix : prefixes) {
+        timer.begin_timer();
+        vector<string> expected = single.predictCompletions(prefix, NUM_COMP);
+        singleTime += timer.end_timer();
+        timer.begin_timer();
+        vector<string> results = layered.predictCompletions(prefix, NUM_COMP);
+        layeredTime += timer.end_timer();
+        if (results != expected) {
+            cout << "The layers gave another answer for " << prefix << endl;
+        }
+    }
+    cout << "predictCompletions, prefixes of 1 to 4 characters" << endl;
+    cout << "\tOne trie: " << singleTime / prefixes.size()
+         << " nanoseconds." << endl;
+    cout << "\tLayered:  " << layeredTime / prefixes.size()
+         << " nanoseconds." << endl;
+
+    // a reader keeps querying while the compaction runs
+    atomic<bool> done(false);
+    vector<long long> times;
+    thread reader([&]() {
+        Timer readTimer;
+        for (size_t i = 0; !done; i = (i + 1) % prefixes.size()) {
+            readTimer.begin_timer();
+            layered.predictCompletions(prefixes[i], NUM_COMP);
+            times.push_back(readTimer.end_timer());
+        }
+    });
+    timer.begin_timer();
+    layered.startCompaction();
+    layered.waitForCompaction();
+    long long compactTime = timer.end_timer();
+    done = true;
+    reader.join();
+    sort(times.begin(), times.end());
+    cout << "Compaction: " << compactTime / 1000000.0 << " ms" << endl;
+    if (!times.empty()) {
+        cout << "\tQueries meanwhile: " << times.size()
+             << ", p50: " << times[times.size() / 2]
+             << " nanoseconds, max: " << times.back() << " nanoseconds."
+             << endl;
     }
-    delete trie;
+}
+
+/* The work done by one structure for one operation on one workload */
+struct Measurement {
+    string structure;
+    string operation;
+    string workload;
+    // nanoseconds of every timed call, over all rounds
+    vector<long long> times;
+    // answers found in the last round
+    size_t results = 0;
+    // nodes visited per call, -1 if the structure does not count them
+    double nodesVisited = -1;
+};
+
+/**
+ * Run query(i) for every i < numQueries, first WARMUP_ROUNDS times
+ * untimed and then ROUNDS times timing every call, with reset() run
+ * before each round. query returns the number of answers it found. If
+ * stats is given, the queries count their nodes in it.
+ */
+template <typename Reset, typename Query>
+static void measure(Measurement& m, size_t numQueries, Reset reset,
+                    Query query, DictionaryTrie::SearchStats* stats) {
+    const unsigned int WARMUP_ROUNDS = 1;
+    const unsigned int ROUNDS = 5;
+
+    Timer timer;
+    m.times.clear();
+    m.times.reserve(numQueries * ROUNDS);
+    for (unsigned int round = 0; round < WARMUP_ROUNDS + ROUNDS; round++) {
+        reset();
+        if (stats != nullptr) {
+            *stats = DictionaryTrie::SearchStats();
+        }
+        m.results = 0;
+        bool timed = round >= WARMUP_ROUNDS;
+        for (size_t i = 0; i < numQueries; i++) {
+            timer.begin_timer();
+            m.results += query(i);
+            long long time = timer.end_timer();
+            if (timed) {
+                m.times.push_back(time);
+            }
+        }
+    }
+    if (stats != nullptr) {
+        m.nodesVisited = double(stats->nodesVisited) / numQueries;
+    }
+}
+
+/* Print m as one JSON object */
+static void printMeasurement(const Measurement& m) {
+    const double P50 = 0.5;
+    const double P90 = 0.9;
+    const double P99 = 0.99;
+
+    vector<long long> times = m.times;
+    sort(times.begin(), times.end());
+    long long total = 0;
+    for (long long time : times) {
+        total += time;
+    }
+    cout << "    {\"structure\": \"" << m.structure << "\", \"operation\": \""
+         << m.operation << "\", \"workload\": \"" << m.workload << "\",\n"
+         << "     \"calls\": " << times.size()
+         << ", \"p50_ns\": " << times[times.size() * P50]
+         << ", \"p90_ns\": " << times[times.size() * P90]
+         << ", \"p99_ns\": " << times[times.size() * P99]
+         << ", \"qps\": " << (long long)(times.size() / (total / 1e9))
+         << ",\n     \"nodes_visited\": ";
+    if (m.nodesVisited < 0) {
+        cout << "null";
+    } else {
+        cout << m.nodesVisited;
+    }
+    cout << ", \"results\": " << m.results << "}";
+}
+
+/* Return a string of len random lowercase letters */
+static string randomLetters(unsigned int len, mt19937& gen) {
+    string s;
+    for (unsigned int i = 0; i < len; i++) {
+        s.push_back('a' + gen() % 26);
+    }
+    return s;
+}
+
+/* Replace one or two characters of word after the first by '_', and
+ * return the pattern */
+static string underscorePattern(string word, mt19937& gen) {
+    unsigned int wild = 1 + gen() % 2;
+    for (unsigned int i = 0; i < wild; i++) {
+        word[1 + gen() % (word.length() - 1)] = '_';
+    }
+    return word;
+}
+
+/**
+ * The queries of one workload. "real" draws words with the dictionary
+ * frequencies as weights, and completes prefixes of 1 to 8 of their
+ * characters, like a user typing. "random" is made of random letters,
+ * so most words miss and prefixes stay short.
+ */
+struct Workload {
+    string name;
+    vector<string> words;
+    vector<string> prefixes;
+    vector<string> patterns;
+};
+
+/* Build the real and the random workload of count queries each */
+static vector<Workload> makeWorkloads(
+    const vector<DictionaryTrie::Record>& records, size_t count) {
+    const unsigned int MAX_PREFIX = 8;
+    const unsigned int MIN_RANDOM = 3;
+    const unsigned int MAX_RANDOM = 10;
+    const unsigned int MAX_RANDOM_PREFIX = 4;
+
+    // words drawn with the dictionary frequencies as weights
+    vector<double> weights;
+    for (const DictionaryTrie::Record& r : records) {
+        weights.push_back(r.freq);
+    }
+    discrete_distribution<size_t> pick(weights.begin(), weights.end());
+    mt19937 gen(100);
+    auto draw = [&]() { return string(records[pick(gen)].word); };
+
+    vector<Workload> workloads(2);
+    Workload& real = workloads[0];
+    real.name = "real";
+    for (size_t i = 0; i < count; i++) {
+        string word = draw();
+        unsigned int len = min<size_t>(word.length(), MAX_PREFIX);
+        real.prefixes.push_back(word.substr(0, 1 + gen() % len));
+        real.words.push_back(word);
+    }
+    while (real.patterns.size() < count) {
+        string word = draw();
+        if (word.length() > 1) {
+            real.patterns.push_back(underscorePattern(word, gen));
+        }
+    }
+
+    Workload& random = workloads[1];
+    random.name = "random";
+    for (size_t i = 0; i < count; i++) {
+        unsigned int len = MIN_RANDOM + gen() % (MAX_RANDOM - MIN_RANDOM + 1);
+        random.words.push_back(randomLetters(len, gen));
+        random.prefixes.push_back(
+            randomLetters(1 + gen() % MAX_RANDOM_PREFIX, gen));
+        random.patterns.push_back(
+            underscorePattern(randomLetters(len, gen), gen));
+    }
+    return workloads;
+}
+
+/* The numCompletions most frequent words of dict starting with prefix,
+ * found by scanning the range of the prefix */
+static size_t mapCompletions(const map<string, unsigned int>& dict,
+                             const string& prefix,
+                             unsigned int numCompletions,
+                             vector<pair<string, int>>& heap) {
+    heap.clear();
+    for (auto it = dict.lower_bound(prefix);
+         it != dict.end() && it->first.compare(0, prefix.length(), prefix) == 0;
+         it++) {
+        DictionaryTrie::pd_fixed(heap, numCompletions, it->first, it->second);
+    }
+    return heap.size();
+}
+
+/* The numCompletions most frequent words of dict matching pattern,
+ * found by scanning the range of the characters before the first '_' */
+static size_t mapUnderscores(const map<string, unsigned int>& dict,
+                             const string& pattern,
+                             unsigned int numCompletions,
+                             vector<pair<string, int>>& heap) {
+    heap.clear();
+    string head = pattern.substr(0, pattern.find('_'));
+    for (auto it = dict.lower_bound(head);
+         it != dict.end() && it->first.compare(0, head.length(), head) == 0;
+         it++) {
+        const string& word = it->first;
+        if (word.length() != pattern.length()) {
+            continue;
+        }
+        bool matches = true;
+        for (size_t i = head.length(); i < word.length() && matches; i++) {
+            matches = pattern[i] == '_'
+                          ? DictionaryTrie::matchesUnderscore(word[i])
+                          : pattern[i] == word[i];
+        }
+        if (matches) {
+            DictionaryTrie::pd_fixed(heap, numCompletions, word, it->second);
+        }
+    }
+    return heap.size();
+}
+
+/**
+ * Measure find, insert, predictCompletions and predictUnderscores of
+ * DictionaryTrie and of a std::map baseline on every workload, and
+ * print the percentiles, throughput, nodes visited and memory as JSON.
+ */
+void runHarness(string filename) {
+    const unsigned int NUM_COMP = 10;
+    const size_t NUM_QUERIES = 5000;
+
+    MappedFile file;
+    file.open(filename);
+    vector<DictionaryTrie::Record> records =
+        Utils::parseRecords(file.begin(), file.end());
+    vector<Workload> workloads = makeWorkloads(records, NUM_QUERIES);
+    vector<size_t> order(records.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    shuffle(order.begin(), order.end(), mt19937(100));
+
+    size_t rssBefore = residentKilobytes();
+    DictionaryTrie trie;
+    Utils::loadDictFile(trie, filename);
+    size_t rssTrie = residentKilobytes();
+    map<string, unsigned int> dict;
+    for (const DictionaryTrie::Record& r : records) {
+        dict.emplace(string(r.word), r.freq);
+    }
+    size_t rssMap = residentKilobytes();
+
+    DictionaryTrie::SearchStats stats;
+    DictionaryTrie::SearchScratch scratch;
+    vector<pair<string, int>> heap;
+    vector<Measurement> all;
+    auto none = []() {};
+    for (const Workload& w : workloads) {
+        Measurement m;
+        m.workload = w.name;
+
+        m.structure = "DictionaryTrie";
+        m.operation = "find";
+        measure(m, w.words.size(), none,
+                [&](size_t i) { return trie.find(w.words[i], &stats); },
+                &stats);
+        all.push_back(m);
+        m.operation = "predictCompletions";
+        measure(m, w.prefixes.size(), none,
+                [&](size_t i) {
+                    return trie
+                        .predictCompletions(w.prefixes[i], NUM_COMP, scratch,
+                                            &stats)
+                        .size();
+                },
+                &stats);
+        all.push_back(m);
+        m.operation = "predictUnderscores";
+        measure(m, w.patterns.size(), none,
+                [&](size_t i) {
+                    return trie
+                        .predictUnderscores(w.patterns[i], NUM_COMP, &stats)
+                        .size();
+                },
+                &stats);
+        all.push_back(m);
+
+        m.structure = "std::map";
+        m.nodesVisited = -1;
+        m.operation = "find";
+        measure(m, w.words.size(), none,
+                [&](size_t i) { return dict.count(w.words[i]); }, nullptr);
+        all.push_back(m);
+        m.operation = "predictCompletions";
+        measure(m, w.prefixes.size(), none,
+                [&](size_t i) {
+                    return mapCompletions(dict, w.prefixes[i], NUM_COMP, heap);
+                },
+                nullptr);
+        all.push_back(m);
+        m.operation = "predictUnderscores";
+        measure(m, w.patterns.size(), none,
+                [&](size_t i) {
+                    return mapUnderscores(dict, w.patterns[i], NUM_COMP, heap);
+                },
+                nullptr);
+        all.push_back(m);
+    }
+
+    // every word of the dictionary in random order into an empty one
+    Measurement m;
+    m.workload = "shuffled";
+    m.operation = "insert";
+    m.structure = "DictionaryTrie";
+    DictionaryTrie fresh;
+    measure(m, order.size(), [&]() { fresh = DictionaryTrie(); },
+            [&](size_t i) {
+                const DictionaryTrie::Record& r = records[order[i]];
+                return fresh.insert(r.word, r.freq, &stats);
+            },
+            &stats);
+    all.push_back(m);
+    m.structure = "std::map";
+    m.nodesVisited = -1;
+    map<string, unsigned int> freshMap;
+    measure(m, order.size(), [&]() { freshMap.clear(); },
+            [&](size_t i) {
+                const DictionaryTrie::Record& r = records[order[i]];
+                return freshMap.emplace(string(r.word), r.freq).second;
+            },
+            nullptr);
+    all.push_back(m);
+
+    cout << "{\n  \"dictionary\": \"" << filename << "\",\n"
+         << "  \"words\": " << dict.size() << ",\n"
+         << "  \"completions\": " << NUM_COMP << ",\n"
+         << "  \"rss_kb\": {\"before\": " << rssBefore
+         << ", \"trie\": " << rssTrie - rssBefore
+         << ", \"map\": " << rssMap - rssTrie << "},\n"
+         << "  \"measurements\": [\n";
+    for (size_t i = 0; i < all.size(); i++) {
+        printMeasurement(all[i]);
+        cout << (i + 1 < all.size() ? ",\n" : "\n");
+    }
+    cout << "  ]\n}" << endl;
 }
 
 /* Check if a given data file is valid */
@@ -126,12 +1622,54 @@ bool fileValid(const char* fileName) {
 int main(int argc, char* argv[]) {
     const int NUM_ARG = 2;
 
-    if (argc != NUM_ARG) {
+    if (argc != NUM_ARG && argc != NUM_ARG + 1) {
         cout << "Invalid number of arguments.\n"
-             << "Usage: ./benchtrie <dictionary filename>" << endl;
+             << "Usage: ./benchtrie <dictionary filename> [mode]" << endl;
         return -1;
     }
 
     if (!fileValid(argv[1])) return -1;
-    testRuntime(argv[1]);
+    if (argc == NUM_ARG) {
+        runHarness(argv[1]);
+        return 0;
+    }
+    string mode = argv[NUM_ARG];
+    if (mode == "cache") {
+        testCompletionCache(argv[1]);
+    } else if (mode == "prefix") {
+        testPrefixLatency(argv[1]);
+    } else if (mode == "batch") {
+        testBatch(argv[1]);
+    } else if (mode == "underscore") {
+        testUnderscores(argv[1]);
+    } else if (mode == "succinct") {
+        testSuccinct(argv[1]);
+    } else if (mode == "memory") {
+        testMemory(argv[1]);
+    } else if (mode == "load") {
+        testLoad(argv[1]);
+    } else if (mode == "bulk") {
+        testBulkBuild(argv[1]);
+    } else if (mode == "fuzzy") {
+        testFuzzy(argv[1]);
+    } else if (mode == "alloc") {
+        testAllocations(argv[1]);
+    } else if (mode == "art") {
+        testArt(argv[1]);
+    } else if (mode == "hot") {
+        testQueryCache(argv[1]);
+    } else if (mode == "infix") {
+        testInfix(argv[1]);
+    } else if (mode == "snapshot") {
+        testSnapshot(argv[1]);
+    } else if (mode == "shards") {
+        testShards(argv[1]);
+    } else if (mode == "order") {
+        testSearchOrder(argv[1]);
+    } else if (mode == "layered") {
+        testLayered(argv[1]);
+    } else {
+        cout << "Unknown mode: " << mode << endl;
+        return -1;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+/**
+ * This program is the offline build step of the compact dictionary
+ * format: it loads a dictionary file into a DictionaryTrie and writes it
+ * as a SuccinctTrie file, which servers then map instead of rebuilding
+ * the trie from text.
+ *
+ * With --snapshot it writes a DictionaryTrie snapshot instead, which
+ * DictionaryTrie::load reads back into a TST without rebuilding it.
+ *
+ * Usage: ./compacttrie <dictionary filename> <output filename> [--snapshot]
+ */
+#include <iostream>
+#include "DictionaryTrie.hpp"
+#include "SuccinctTrie.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    const int NUM_ARG = 3;
+    const int SNAPSHOT_ARG = 3;
+    bool snapshot =
+        argc == NUM_ARG + 1 && string(argv[SNAPSHOT_ARG]) == "--snapshot";
+    if (argc != NUM_ARG && !snapshot) {
+        cout << "Invalid number of arguments.\n"
+             << "Usage: ./compacttrie <dictionary filename> <output filename>"
+             << " [--snapshot]" << endl;
+        return -1;
+    }
+
+    DictionaryTrie dict;
+    if (!Utils::loadDictFile(dict, argv[1])) {
+        cout << "Invalid input file. No file was opened. Please try again.\n";
+        return -1;
+    }
+
+    if (snapshot) {
+        DictionaryTrie loaded;
+        if (!dict.save(argv[2]) || !loaded.load(argv[2])) {
+            cout << "Could not write " << argv[2] << endl;
+            return -1;
+        }
+        cout << "Nodes: " << loaded.numNodes() << endl;
+        cout << "Node bytes: " << loaded.nodeMemory() << endl;
+        return 0;
+    }
+
+    if (!SuccinctTrie::write(dict, argv[2])) {
+        cout << "Could not write " << argv[2] << endl;
+        return -1;
+    }
+    SuccinctTrie trie;
+    if (!trie.open(argv[2])) {
+        cout << "Could not read back " << argv[2] << endl;
+        return -1;
+    }
+    cout << "Words: " << trie.numWords() << endl;
+    cout << "File size: " << trie.sizeInBytes() << " bytes ("
+         << double(trie.sizeInBytes()) / trie.numWords() << " per word)"
+         << endl;
+    return 0;
+}
@@ -0,0 +1,266 @@
+/**
+ * This program is a load generator for the autocomplete server: it
+ * opens connections to the Unix domain socket of
+ * "./autocomplete <dictionary> --serve <socket path>", sends requests
+ * made from the words of the dictionary, keeping up to a number of them
+ * in flight per connection, and reports the throughput and the latency
+ * percentiles of the responses.
+ *
+ * Usage: ./loadgen <socket path> <dictionary filename>
+ *            [connections] [requests per connection] [pipeline depth]
+ *
+ * Requests ask for 10 completions of prefixes of 1 to 4 characters,
+ * and every tenth one is a pattern with a '_'.
+ */
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "util.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+/* Lines read from a file descriptor through a buffer */
+class LineReader {
+  private:
+    int fd;
+    string buffer;
+    size_t start = 0;
+
+  public:
+    explicit LineReader(int fd) : fd(fd) {}
+
+    /* Read the next line into line, without its newline. Return false
+     * at the end of the input. */
+    bool next(string& line) {
+        while (true) {
+            size_t end = buffer.find('\n', start);
+            if (end != string::npos) {
+                line.assign(buffer, start, end - start);
+                start = end + 1;
+                return true;
+            }
+            buffer.erase(0, start);
+            start = 0;
+            char chunk[1 << 14];
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, n);
+        }
+    }
+};
+
+/* What one connection saw */
+struct ConnectionResult {
+    vector<long long> latencies;
+    size_t errors = 0;
+    size_t words = 0;
+    bool failed = false;
+};
+
+/* Connect to the Unix domain socket at path, or return -1 */
+static int connectTo(const string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Write all of data to fd */
+static bool writeAll(int fd, const string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+/**
+ * Send requests over one connection, keeping depth of them in flight:
+ * a first window is sent at once, then one more request for every
+ * response read. Responses come in the order of the requests, so the
+ * latency of request i is from its send to the end of response i.
+ */
+static void runConnection(const string& path, const vector<string>& requests,
+                          unsigned int depth, ConnectionResult& result) {
+    int fd = connectTo(path);
+    if (fd < 0) {
+        result.failed = true;
+        return;
+    }
+    vector<Clock::time_point> sent(requests.size());
+    size_t numSent = 0;
+    string out;
+    auto sendUpTo = [&](size_t limit) {
+        out.clear();
+        Clock::time_point now = Clock::now();
+        for (; numSent < limit && numSent < requests.size(); numSent++) {
+            out += requests[numSent];
+            out += '\n';
+            sent[numSent] = now;
+        }
+        return out.empty() || writeAll(fd, out);
+    };
+
+    LineReader reader(fd);
+    string line;
+    if (!sendUpTo(depth)) {
+        result.failed = true;
+    }
+    for (size_t i = 0; i < requests.size() && !result.failed; i++) {
+        if (!reader.next(line)) {
+            result.failed = true;
+            break;
+        }
+        if (line.compare(0, 4, "ERR ") == 0) {
+            result.errors++;
+        } else {
+            size_t count = stoul(line);
+            for (size_t j = 0; j < count; j++) {
+                if (!reader.next(line)) {
+                    result.failed = true;
+                    break;
+                }
+            }
+            result.words += count;
+        }
+        result.latencies.push_back(
+            chrono::duration_cast<chrono::nanoseconds>(Clock::now() -
+                                                       sent[i])
+                .count());
+        if (!sendUpTo(i + 1 + depth)) {
+            result.failed = true;
+        }
+    }
+    close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    const int MIN_ARG = 3;
+    const int MAX_ARG = 6;
+    const unsigned int NUM_COMP = 10;
+    const unsigned int MAX_LEN = 4;
+    const unsigned int PATTERN_EVERY = 10;
+    if (argc < MIN_ARG || argc > MAX_ARG) {
+        cout << "Invalid number of arguments.\n"
+             << "Usage: ./loadgen <socket path> <dictionary filename>"
+             << " [connections] [requests per connection]"
+             << " [pipeline depth]" << endl;
+        return -1;
+    }
+    string path = argv[1];
+    unsigned int connections = argc > 3 ? stoul(argv[3]) : 4;
+    unsigned int perConnection = argc > 4 ? stoul(argv[4]) : 20000;
+    unsigned int depth = argc > 5 ? max(1ul, stoul(argv[5])) : 16;
+    // the latency percentiles need at least one request
+    if (connections == 0 || perConnection == 0) {
+        cout << "The numbers of connections and of requests per connection"
+             << " must be above 0." << endl;
+        return -1;
+    }
+
+    vector<string> words;
+    ifstream in;
+    in.open(argv[2], ios::binary);
+    if (!in.is_open()) {
+        cout << "Invalid input file. No file was opened. Please try again.\n";
+        return -1;
+    }
+    Utils::loadDict(words, in);
+    if (words.empty()) {
+        cout << "The file is empty. \n";
+        return -1;
+    }
+
+    // the requests of every connection, drawn from the dictionary
+    mt19937 gen(100);
+    vector<vector<string>> requests(connections);
+    for (vector<string>& some : requests) {
+        while (some.size() < perConnection) {
+            string query = words[gen() % words.size()];
+            query.resize(min<size_t>(query.size(), 1 + gen() % MAX_LEN));
+            if (some.size() % PATTERN_EVERY == PATTERN_EVERY - 1) {
+                query[gen() % query.size()] = '_';
+            }
+            some.push_back(to_string(NUM_COMP) + " " + query);
+        }
+    }
+
+    vector<ConnectionResult> results(connections);
+    vector<thread> clients;
+    Clock::time_point begin = Clock::now();
+    for (unsigned int c = 0; c < connections; c++) {
+        clients.push_back(thread(runConnection, cref(path), cref(requests[c]),
+                                 depth, ref(results[c])));
+    }
+    for (thread& client : clients) {
+        client.join();
+    }
+    double seconds =
+        chrono::duration<double>(Clock::now() - begin).count();
+
+    vector<long long> latencies;
+    size_t errors = 0;
+    size_t numWords = 0;
+    for (const ConnectionResult& result : results) {
+        if (result.failed) {
+            cout << "A connection to " << path << " failed." << endl;
+            return -1;
+        }
+        latencies.insert(latencies.end(), result.latencies.begin(),
+                         result.latencies.end());
+        errors += result.errors;
+        numWords += result.words;
+    }
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[min(latencies.size() - 1,
+                             size_t(latencies.size() * p))] /
+               1000.0;
+    };
+    cout << "Connections: " << connections << ", pipeline depth: " << depth
+         << endl;
+    cout << "Requests: " << latencies.size() << " (" << errors
+         << " errors), words returned: " << numWords << endl;
+    cout << "Throughput: " << latencies.size() / seconds
+         << " requests per second" << endl;
+    cout << "Latency p50: " << percentile(0.5)
+         << " us, p90: " << percentile(0.9)
+         << " us, p99: " << percentile(0.99)
+         << " us, p99.9: " << percentile(0.999) << " us" << endl;
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * This file contains tests for the ART engine of DictionaryTrie: it
+ * must answer every query exactly like the TST engine, through node
+ * growth, prefix splits, updates and removals.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "ArtTrie.hpp"
+#include "DictionaryTrie.hpp"
+
+using namespace std;
+using namespace testing;
+
+/**
+ * The same random dictionary in a TST and in an ART. The alphabet has
+ * a space, '_' and a character above 127 so that the order of bytes
+ * and the wildcard rules are exercised, and the words are short so
+ * that many are prefixes of others.
+ * */
+class ArtTrieTest : public ::testing::Test {
+  protected:
+    DictionaryTrie tst;
+    DictionaryTrie art;
+    vector<string> words;
+    vector<string> queries;
+
+  public:
+    ArtTrieTest() : tst(DictionaryTrie::TST), art(DictionaryTrie::ART) {
+        const string alphabet = "abcde _Z\xe9";
+        mt19937 gen(11);
+        for (int i = 0; i < 4000; i++) {
+            string word;
+            int len = 1 + gen() % 7;
+            for (int j = 0; j < len; j++) {
+                word.push_back(alphabet[gen() % 5 == 0
+                                            ? gen() % alphabet.size()
+                                            : gen() % 5]);
+            }
+            unsigned int freq = 1 + gen() % (i % 2 == 0 ? 30 : 5000000);
+            EXPECT_EQ(art.insert(word, freq), tst.insert(word, freq));
+            words.push_back(word);
+            if (i % 10 == 0) {
+                queries.push_back(word);
+                queries.push_back(word.substr(0, 1 + gen() % len));
+            }
+        }
+        queries.push_back("zzz");
+        queries.push_back("");
+    }
+
+    /* Check that both engines give the same answers to every query,
+     * and list the same words */
+    void checkSame() {
+        string artText;
+        string tstText;
+        vector<DictionaryTrie::Record> artWords = art.listWords(artText);
+        vector<DictionaryTrie::Record> tstWords = tst.listWords(tstText);
+        ASSERT_EQ(artWords.size(), tstWords.size());
+        for (size_t i = 0; i < artWords.size(); i++) {
+            ASSERT_EQ(artWords[i].word, tstWords[i].word);
+            ASSERT_EQ(artWords[i].freq, tstWords[i].freq);
+        }
+        for (const string& q : queries) {
+            ASSERT_EQ(art.find(q), tst.find(q)) << q;
+            ASSERT_EQ(art.find(q + "a"), tst.find(q + "a")) << q;
+            for (unsigned int num : {0u, 1u, 4u, 20u, 500u}) {
+                ASSERT_EQ(art.predictCompletions(q, num),
+                          tst.predictCompletions(q, num))
+                    << q << " " << num;
+            }
+        }
+    }
+};
+
+// Both engines hold the same words
+TEST_F(ArtTrieTest, MATCHES_TST_TEST) {
+    ASSERT_EQ(art.engine(), DictionaryTrie::ART);
+    ASSERT_EQ(tst.engine(), DictionaryTrie::TST);
+    checkSame();
+}
+
+// predictUnderscores gives the same answers
+TEST_F(ArtTrieTest, UNDERSCORE_TEST) {
+    mt19937 gen(5);
+    for (string q : queries) {
+        for (char& c : q) {
+            if (gen() % 2 == 0) {
+                c = '_';
+            }
+        }
+        for (unsigned int num : {1u, 5u, 100u}) {
+            ASSERT_EQ(art.predictUnderscores(q, num),
+                      tst.predictUnderscores(q, num))
+                << q << " " << num;
+        }
+    }
+}
+
+// predictFuzzy gives the same answers
+TEST_F(ArtTrieTest, FUZZY_TEST) {
+    for (const string& q : queries) {
+        for (unsigned int edits : {0u, 1u, 2u}) {
+            for (unsigned int num : {1u, 10u, 200u}) {
+                ASSERT_EQ(art.predictFuzzy(q, edits, num),
+                          tst.predictFuzzy(q, edits, num))
+                    << q << " " << edits << " " << num;
+            }
+        }
+    }
+}
+
+// The TST-only features refuse the ART engine instead of doing nothing
+TEST_F(ArtTrieTest, TST_ONLY_TEST) {
+    string text;
+    ASSERT_GE(art.numNodes(), art.listWords(text).size());
+    ASSERT_FALSE(art.buildCompletionCache(10, 2));
+    ASSERT_EQ(art.completionCacheMemory(), 0);
+    ASSERT_FALSE(art.save("test_ArtTrie.snapshot"));
+    ASSERT_FALSE(art.load("test_ArtTrie.snapshot"));
+    ASSERT_TRUE(tst.buildCompletionCache(10, 2));
+}
+
+// Updates and removals keep the highest frequencies right
+TEST_F(ArtTrieTest, UPDATE_REMOVE_TEST) {
+    mt19937 gen(7);
+    for (int i = 0; i < 3000; i++) {
+        const string& word = words[gen() % words.size()];
+        unsigned int freq = gen() % 3 == 0 ? 0 : 1 + gen() % 5000000;
+        if (gen() % 2 == 0) {
+            ASSERT_EQ(art.updateFrequency(word, freq),
+                      tst.updateFrequency(word, freq))
+                << word;
+        } else {
+            ASSERT_EQ(art.remove(word), tst.remove(word)) << word;
+        }
+    }
+    checkSame();
+    // words removed down to nothing can come back
+    for (const string& word : words) {
+        ASSERT_EQ(art.insert(word, 3), tst.insert(word, 3)) << word;
+    }
+    checkSame();
+}
+
+// A node with a child for every byte grows through all four kinds
+TEST(ArtTrieTests, GROWTH_TEST) {
+    DictionaryTrie art(DictionaryTrie::ART);
+    vector<string> expected;
+    for (int b = 255; b >= 1; b--) {
+        string word = string("x") + char(b);
+        ASSERT_TRUE(art.insert(word, b));
+        expected.push_back(word);
+    }
+    ASSERT_FALSE(art.insert("x\x01", 7));
+    for (const string& word : expected) {
+        ASSERT_TRUE(art.find(word));
+    }
+    ASSERT_FALSE(art.find("x"));
+    ASSERT_EQ(art.predictCompletions("x", 300), expected);
+    ASSERT_EQ(art.predictCompletions("x\x7f", 1), vector<string>{"x\x7f"});
+    ASSERT_TRUE(art.remove("x\xff"));
+    expected.erase(expected.begin());
+    ASSERT_EQ(art.predictCompletions("x", 300), expected);
+}
+
+// Skipped bytes are split where a new word leaves them
+TEST(ArtTrieTests, PREFIX_SPLIT_TEST) {
+    ArtTrie art;
+    ASSERT_TRUE(art.insert("abcdefgh", 1));
+    ASSERT_TRUE(art.insert("abcdxyz", 2));
+    ASSERT_TRUE(art.insert("ab", 3));
+    ASSERT_TRUE(art.insert("abcd", 4));
+    ASSERT_FALSE(art.insert("abcd", 5));
+    ASSERT_EQ(art.numWords(), 4);
+    for (const string word : {"abcdefgh", "abcdxyz", "ab", "abcd"}) {
+        ASSERT_TRUE(art.find(word)) << word;
+    }
+    for (const string word : {"a", "abc", "abcde", "abcdx", "abcdefghi"}) {
+        ASSERT_FALSE(art.find(word)) << word;
+    }
+    DictionaryTrie::SearchScratch scratch;
+    vector<string> out;
+    ASSERT_EQ(art.predictCompletions("abc", 10, scratch, out, nullptr), 3);
+    vector<string> expected = {"abcd", "abcdxyz", "abcdefgh"};
+    out.resize(3);
+    ASSERT_EQ(out, expected);
+}
@@ -0,0 +1,139 @@
+/**
+ * This file contains tests for the autocomplete server: the framing of
+ * its responses, its errors and its batches of pipelined requests.
+ */
+
+#include <unistd.h>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "AutocompleteServer.hpp"
+#include "DictionaryTrie.hpp"
+
+using namespace std;
+using namespace testing;
+
+/* Serve the requests in input and return everything written back */
+static string serveAll(AutocompleteServer& server, const string& input,
+                       size_t& answered) {
+    FILE* in = tmpfile();
+    FILE* out = tmpfile();
+    fwrite(input.data(), 1, input.size(), in);
+    fflush(in);
+    rewind(in);
+    answered = server.serve(fileno(in), fileno(out));
+    string written;
+    rewind(out);
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), out)) > 0) {
+        written.append(chunk, n);
+    }
+    fclose(in);
+    fclose(out);
+    return written;
+}
+
+/* Return the framed response for words */
+static string frame(const vector<string>& words) {
+    string response = to_string(words.size()) + "\n";
+    for (const string& word : words) {
+        response += word + "\n";
+    }
+    return response;
+}
+
+/* Every request line gets one response, in order */
+TEST(AutocompleteServerTests, FRAMING_TEST) {
+    DictionaryTrie dict;
+    dict.insert("apple", 5);
+    dict.insert("apple pie", 9);
+    dict.insert("apply", 7);
+    dict.insert("banana", 3);
+    AutocompleteServer server(dict, 2, 4);
+
+    size_t answered;
+    string written = serveAll(server,
+                              "2 app\n"
+                              "10 apple \n"
+                              "3 b_nana\n"
+                              "5 zebra\r\n"
+                              "x app\n"
+                              "5\n"
+                              "5 \n"
+                              "100000 app\n"
+                              "0 app\n"
+                              "1 appl",
+                              answered);
+    ASSERT_EQ(answered, 10);
+    string expected = frame({"apple pie", "apply"}) + frame({"apple pie"}) +
+                      frame({"banana"}) + frame({}) +
+                      "ERR expected <k> <query>\n"
+                      "ERR expected <k> <query>\n"
+                      "ERR empty query\n"
+                      "ERR k above 1000\n" +
+                      frame({}) + frame({"apple pie"});
+    ASSERT_EQ(written, expected);
+}
+
+/* A line too long gets an error wherever the reads split it, and the
+ * requests after it are answered */
+TEST(AutocompleteServerTests, LONG_LINE_TEST) {
+    DictionaryTrie dict;
+    dict.insert("apple", 5);
+    dict.insert("apply", 7);
+    AutocompleteServer server(dict, 2, 4);
+    string longest = "1 " + string(AutocompleteServer::MAX_LINE - 2, 'a');
+    string tooLong = longest + "a";
+
+    size_t answered;
+    string written = serveAll(server,
+                              "1 app\n" + tooLong + "\n" + longest + "\n" +
+                                  "2 " + string(300000, 'p') + "\n" +
+                                  "2 app\n" + tooLong,
+                              answered);
+    ASSERT_EQ(answered, 6);
+    ASSERT_EQ(written, frame({"apply"}) + "ERR line too long\n" + frame({}) +
+                           "ERR line too long\n" +
+                           frame({"apply", "apple"}) +
+                           "ERR line too long\n");
+}
+
+/* A long pipeline answered in many batches matches the trie */
+TEST(AutocompleteServerTests, PIPELINE_TEST) {
+    DictionaryTrie dict;
+    const string alphabet = "abc d_";
+    mt19937 gen(17);
+    vector<string> words;
+    for (int i = 0; i < 2000; i++) {
+        string word;
+        int len = 1 + gen() % 6;
+        for (int j = 0; j < len; j++) {
+            word.push_back(alphabet[gen() % (alphabet.size() - 1)]);
+        }
+        dict.insert(word, 1 + gen() % 100);
+        words.push_back(word);
+    }
+    AutocompleteServer server(dict, 3, 7);
+
+    string input;
+    string expected;
+    for (int i = 0; i < 1000; i++) {
+        string query = words[gen() % words.size()];
+        query.resize(1 + gen() % query.size());
+        unsigned int num = gen() % 12;
+        if (i % 5 == 0) {
+            query[gen() % query.size()] = '_';
+            expected += frame(dict.predictUnderscores(query, num));
+        } else {
+            expected += frame(dict.predictCompletions(query, num));
+        }
+        input += to_string(num) + " " + query + "\n";
+    }
+    size_t answered;
+    ASSERT_EQ(serveAll(server, input, answered), expected);
+    ASSERT_EQ(answered, 1000);
+}
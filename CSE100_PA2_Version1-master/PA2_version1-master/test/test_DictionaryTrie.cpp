@@ -7,10 +7,18 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <new>
+#include <random>
 #include <set>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -20,6 +28,35 @@
 using namespace std;
 using namespace testing;
 
+/* Number of allocations made by the test program */
+static atomic<size_t> numAllocs(0);
+
+// The operators are kept out of line. Inlined into a caller, the malloc
+// and free in them would meet an operator delete or an operator new, and
+// g++ would warn that the allocation and deallocation do not match.
+__attribute__((noinline)) void* operator new(size_t size) {
+    numAllocs++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+// std::stable_sort takes its buffer from the nothrow form, and frees it
+// with the operator delete below
+__attribute__((noinline)) void* operator new(size_t size,
+                                             const nothrow_t&) noexcept {
+    numAllocs++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
 /* Empty test */
 TEST(DictTrieTests, EMPTY_TEST) {
     DictionaryTrie dict;
@@ -169,3 +206,692 @@ TEST_F(TrieUnderscoreTest, edge_TEST) {
     vecReturn = dict.predictUnderscores("_____", 10);
     ASSERT_EQ(vecReturn[0], "apdeq");
 }
+
+/**
+ * Build a DictionaryTrie of random words over a small alphabet, so that
+ * prefixes are shared and many frequencies are tied
+ * */
+class TrieCacheTest : public ::testing::Test {
+  protected:
+    DictionaryTrie dict;
+    vector<string> prefixes;
+    vector<pair<string, unsigned int>> entries;
+
+  public:
+    TrieCacheTest() {
+        mt19937 gen(7);
+        for (int i = 0; i < 3000; i++) {
+            string word;
+            int len = 1 + gen() % 6;
+            for (int j = 0; j < len; j++) {
+                word.push_back('a' + gen() % 5);
+            }
+            unsigned int freq = 1 + gen() % 40;
+            if (dict.insert(word, freq)) {
+                entries.push_back(make_pair(word, freq));
+            }
+        }
+        for (char a = 'a'; a <= 'f'; a++) {
+            prefixes.push_back(string(1, a));
+            for (char b = 'a'; b <= 'e'; b++) {
+                prefixes.push_back(string(1, a) + b);
+                prefixes.push_back(string(1, a) + b + 'c');
+            }
+        }
+    }
+
+    /* Answer every prefix for every numCompletions in nums */
+    vector<vector<string>> answerAll(const vector<unsigned int>& nums) {
+        vector<vector<string>> answers;
+        for (const string& prefix : prefixes) {
+            for (unsigned int num : nums) {
+                answers.push_back(dict.predictCompletions(prefix, num));
+            }
+        }
+        return answers;
+    }
+};
+
+// The cached lists give the same answers as the search
+TEST_F(TrieCacheTest, CACHE_MATCHES_SEARCH_TEST) {
+    vector<unsigned int> nums = {1, 3, 10, 25};
+    vector<vector<string>> expected = answerAll(nums);
+    dict.buildCompletionCache(10, 2);
+    ASSERT_GT(dict.completionCacheMemory(), 0);
+    ASSERT_EQ(answerAll(nums), expected);
+    dict.clearCompletionCache();
+    ASSERT_EQ(dict.completionCacheMemory(), 0);
+    ASSERT_EQ(answerAll(nums), expected);
+}
+
+// Queries give the same answers when run twice and from many threads
+TEST_F(TrieCacheTest, CONCURRENT_QUERY_TEST) {
+    const int NUM_THREADS = 4;
+    vector<unsigned int> nums = {1, 3, 10, 25};
+    vector<vector<string>> expected = answerAll(nums);
+    ASSERT_EQ(answerAll(nums), expected);
+
+    const DictionaryTrie& shared = dict;
+    vector<vector<vector<string>>> answers(NUM_THREADS);
+    vector<thread> threads;
+    for (int t = 0; t < NUM_THREADS; t++) {
+        threads.push_back(thread([&, t]() {
+            for (const string& prefix : prefixes) {
+                for (unsigned int num : nums) {
+                    answers[t].push_back(
+                        shared.predictCompletions(prefix, num));
+                }
+            }
+        }));
+    }
+    for (thread& th : threads) {
+        th.join();
+    }
+    for (int t = 0; t < NUM_THREADS; t++) {
+        ASSERT_EQ(answers[t], expected);
+    }
+}
+
+// A batch gives the answers of one query at a time, in order
+TEST_F(TrieCacheTest, BATCH_TEST) {
+    vector<vector<string>> expected;
+    for (const string& prefix : prefixes) {
+        expected.push_back(dict.predictCompletions(prefix, 10));
+    }
+    ASSERT_EQ(dict.predictCompletionsBatch(prefixes, 10, 1), expected);
+    ThreadPool pool(4);
+    ASSERT_EQ(dict.predictCompletionsBatch(prefixes, 10, pool), expected);
+    ASSERT_EQ(dict.predictCompletionsBatch(prefixes, 10, pool), expected);
+    ASSERT_EQ(dict.predictCompletionsBatch(vector<string>(), 10, pool).size(),
+              0);
+}
+
+// The wildcard traversal finds the same words as a scan of all words
+TEST_F(TrieCacheTest, UNDERSCORE_MATCHES_SCAN_TEST) {
+    vector<string> patterns = {"_",    "__",   "a_",  "_b",     "__c",
+                               "a_c_", "____", "e__", "______", "ab_d_e"};
+    for (const string& pattern : patterns) {
+        vector<pair<string, unsigned int>> matches;
+        for (const pair<string, unsigned int>& e : entries) {
+            bool match = e.first.length() == pattern.length();
+            for (size_t i = 0; match && i < pattern.length(); i++) {
+                match = pattern[i] == '_' || pattern[i] == e.first[i];
+            }
+            if (match) {
+                matches.push_back(e);
+            }
+        }
+        sort(matches.begin(), matches.end(),
+             [](const pair<string, unsigned int>& a,
+                const pair<string, unsigned int>& b) {
+                 return a.second != b.second ? a.second > b.second
+                                             : a.first < b.first;
+             });
+        for (unsigned int num : {1u, 5u, 1000u}) {
+            vector<string> expected;
+            for (size_t i = 0; i < matches.size() && i < num; i++) {
+                expected.push_back(matches[i].first);
+            }
+            ASSERT_EQ(dict.predictUnderscores(pattern, num), expected);
+        }
+    }
+}
+
+// A '_' does not match an underscore or an unprintable character
+TEST(DictTrieTests, UNDERSCORE_CHARACTER_TEST) {
+    DictionaryTrie dict;
+    dict.insert("a_b", 10);
+    dict.insert("a\tb", 20);
+    dict.insert("a-b", 5);
+    dict.insert("a b", 1);
+    vector<string> expected = {"a-b", "a b"};
+    ASSERT_EQ(dict.predictUnderscores("a_b", 10), expected);
+}
+
+// A short list holds every completion and answers any numCompletions
+TEST(DictTrieTests, CACHE_SHORT_LIST_TEST) {
+    DictionaryTrie dict;
+    dict.insert("ape", 30);
+    dict.insert("apde", 50);
+    dict.insert("apdb", 50);
+    dict.insert("az", 500);
+    dict.buildCompletionCache(10, 3);
+    vector<string> expected = {"az", "apdb", "apde", "ape"};
+    ASSERT_EQ(dict.predictCompletions("a", 100), expected);
+    ASSERT_EQ(dict.predictCompletions("apd", 1), vector<string>{"apdb"});
+}
+
+// An insert drops the cache, so the new word shows up
+TEST(DictTrieTests, CACHE_INSERT_TEST) {
+    DictionaryTrie dict;
+    dict.insert("ape", 30);
+    dict.insert("apt", 20);
+    dict.buildCompletionCache(1, 2);
+    ASSERT_EQ(dict.predictCompletions("ap", 1), vector<string>{"ape"});
+    ASSERT_FALSE(dict.insert("ape", 10));
+    ASSERT_GT(dict.completionCacheMemory(), 0);
+    dict.insert("apple", 90);
+    ASSERT_EQ(dict.completionCacheMemory(), 0);
+    ASSERT_EQ(dict.predictCompletions("ap", 1), vector<string>{"apple"});
+}
+
+/* Check the highestFq of every node below node against a fresh
+ * computation and return the highest frequency below node */
+static unsigned int checkHighestFq(const DictionaryTrie& dict,
+                                   uint32_t node) {
+    if (node == DictionaryTrie::NIL) {
+        return 0;
+    }
+    const DictionaryTrie::TrieNode& n = dict.getNode(node);
+    unsigned int highest = n.freq;
+    highest = max(highest, checkHighestFq(dict, n.left));
+    highest = max(highest, checkHighestFq(dict, n.middle));
+    highest = max(highest, checkHighestFq(dict, n.right));
+    EXPECT_EQ(n.highestFq, highest);
+    return highest;
+}
+
+// highestFq stays exact through inserts, updates and removes, so the
+// pruned search keeps matching a scan of the words
+TEST_F(TrieCacheTest, UPDATE_REMOVE_TEST) {
+    mt19937 gen(11);
+    checkHighestFq(dict, dict.root);
+    for (int i = 0; i < 2000; i++) {
+        size_t pick = gen() % entries.size();
+        if (i % 3 == 0) {
+            ASSERT_TRUE(dict.remove(entries[pick].first));
+            ASSERT_FALSE(dict.find(entries[pick].first));
+            ASSERT_FALSE(dict.remove(entries[pick].first));
+            entries.erase(entries.begin() + pick);
+        } else if (i % 3 == 1) {
+            entries[pick].second = 1 + gen() % 60;
+            ASSERT_TRUE(dict.updateFrequency(entries[pick].first,
+                                             entries[pick].second));
+        } else {
+            string word(1 + gen() % 6, 'a');
+            for (char& c : word) {
+                c = 'a' + gen() % 5;
+            }
+            unsigned int freq = 1 + gen() % 60;
+            if (dict.insert(word, freq)) {
+                entries.push_back(make_pair(word, freq));
+            }
+        }
+    }
+    checkHighestFq(dict, dict.root);
+
+    sort(entries.begin(), entries.end(),
+         [](const pair<string, unsigned int>& a,
+            const pair<string, unsigned int>& b) {
+             return a.second != b.second ? a.second > b.second
+                                         : a.first < b.first;
+         });
+    for (const string& prefix : prefixes) {
+        for (unsigned int num : {1u, 5u, 1000u}) {
+            vector<string> expected;
+            for (const pair<string, unsigned int>& e : entries) {
+                if (expected.size() < num &&
+                    e.first.compare(0, prefix.length(), prefix) == 0) {
+                    expected.push_back(e.first);
+                }
+            }
+            ASSERT_EQ(dict.predictCompletions(prefix, num), expected);
+        }
+    }
+}
+
+// Removing the words frees their nodes for later inserts, and a missing
+// word is neither updated nor removed
+TEST(DictTrieTests, REMOVE_TEST) {
+    DictionaryTrie dict;
+    dict.insert("ape", 30);
+    dict.insert("apple", 90);
+    ASSERT_FALSE(dict.updateFrequency("app", 5));
+    ASSERT_FALSE(dict.remove("ap"));
+    ASSERT_EQ(dict.numNodes(), 6);
+    ASSERT_TRUE(dict.remove("apple"));
+    ASSERT_EQ(dict.numNodes(), 3);
+    ASSERT_EQ(dict.getNode(dict.root).highestFq, 30);
+    ASSERT_EQ(dict.predictCompletions("ap", 5), vector<string>{"ape"});
+    ASSERT_TRUE(dict.updateFrequency("ape", 0));
+    ASSERT_EQ(dict.root, DictionaryTrie::NIL);
+    ASSERT_EQ(dict.numNodes(), 0);
+    ASSERT_FALSE(dict.find("ape"));
+    ASSERT_TRUE(dict.insert("apple", 10));
+    ASSERT_EQ(dict.numNodes(), 5);
+    ASSERT_EQ(dict.predictCompletions("a", 5), vector<string>{"apple"});
+}
+
+// The loaders join the words of a phrase with single spaces, end it
+// before a "." word, skip lines without a frequency that fits in an
+// unsigned int or without a phrase, and keep the first line of a word
+TEST(DictTrieTests, LOAD_FILE_TEST) {
+    const string FILE_NAME = "test_DictionaryTrie_load.txt";
+    ofstream out(FILE_NAME, ios::binary);
+    out << "5 hello   world\n7\tfoo\tbar \r\n\n  9   x\r\nno frequency\n"
+        << "12abc  d\n3 hello world\n4 hello again\n4  \n"
+        << "6 dot  . ignored\n2 end.\n1 .\n4294967296 big\n"
+        << "4294967295 max\n8 last line";
+    out.close();
+    vector<string> expected = {"abc d",     "dot",         "end.",
+                               "foo bar",   "hello again", "hello world",
+                               "last line", "max",         "x"};
+
+    DictionaryTrie fromStream;
+    ifstream in(FILE_NAME, ios::binary);
+    Utils::loadDict(fromStream, in);
+    DictionaryTrie fromFile;
+    ASSERT_TRUE(Utils::loadDictFile(fromFile, FILE_NAME));
+    DictionaryTrie balanced;
+    ASSERT_TRUE(Utils::loadDictFileBalanced(balanced, FILE_NAME, 2));
+    for (DictionaryTrie* dict : {&fromStream, &fromFile, &balanced}) {
+        vector<string> all;
+        for (char c = 'a'; c <= 'z'; c++) {
+            for (const string& w : dict->predictCompletions(string(1, c), 10)) {
+                all.push_back(w);
+            }
+        }
+        sort(all.begin(), all.end());
+        ASSERT_EQ(all, expected);
+        ASSERT_EQ(dict->predictCompletions("h", 1),
+                  vector<string>{"hello world"});
+        ASSERT_EQ(dict->predictCompletions("x", 1), vector<string>{"x"});
+    }
+    ASSERT_FALSE(Utils::loadDictFile(fromFile, "no_such_file.txt"));
+    remove(FILE_NAME.c_str());
+}
+
+// A parse split over threads gives the records of a single pass
+TEST(DictTrieTests, PARALLEL_PARSE_TEST) {
+    mt19937 gen(5);
+    string text;
+    for (int i = 0; i < 40000; i++) {
+        text += to_string(gen() % 1000);
+        int words = 1 + gen() % 3;
+        for (int j = 0; j < words; j++) {
+            text += string(1 + gen() % 2, gen() % 4 == 0 ? '\t' : ' ');
+            text += string(1 + gen() % 8, 'a' + gen() % 26);
+        }
+        text += gen() % 10 == 0 ? "\r\n" : "\n";
+    }
+    string copy = text;
+    vector<DictionaryTrie::Record> single =
+        Utils::parseRecords(&text[0], &text[0] + text.size(), 1);
+    vector<DictionaryTrie::Record> parallel =
+        Utils::parseRecords(&copy[0], &copy[0] + copy.size(), 4);
+    ASSERT_EQ(single.size(), 40000);
+    ASSERT_EQ(parallel.size(), single.size());
+    for (size_t i = 0; i < single.size(); i++) {
+        ASSERT_EQ(parallel[i].word, single[i].word);
+        ASSERT_EQ(parallel[i].freq, single[i].freq);
+    }
+}
+
+/* Return the number of nodes of the sibling BST rooted at node, and
+ * check that every sibling BST below it is balanced by size */
+static size_t checkBalanced(const DictionaryTrie& dict, uint32_t node) {
+    if (node == DictionaryTrie::NIL) {
+        return 0;
+    }
+    const DictionaryTrie::TrieNode& n = dict.getNode(node);
+    checkBalanced(dict, n.middle);
+    size_t left = checkBalanced(dict, n.left);
+    size_t right = checkBalanced(dict, n.right);
+    EXPECT_LE(max(left, right) - min(left, right), 1);
+    return 1 + left + right;
+}
+
+// A bulk build holds the words an insert in file order would, with
+// balanced sibling BSTs and exact highestFq
+TEST_F(TrieCacheTest, BULK_BUILD_TEST) {
+    // the same words and frequencies as the fixture
+    mt19937 gen(7);
+    vector<string> words(3000);
+    vector<DictionaryTrie::Record> records;
+    for (string& word : words) {
+        int len = 1 + gen() % 6;
+        for (int j = 0; j < len; j++) {
+            word.push_back('a' + gen() % 5);
+        }
+        unsigned int freq = 1 + gen() % 40;
+        records.push_back(DictionaryTrie::Record{word, freq});
+    }
+    records.push_back(DictionaryTrie::Record{"", 5});
+    records.push_back(DictionaryTrie::Record{"zz", 0});
+
+    DictionaryTrie bulk;
+    bulk.bulkBuild(records);
+    ASSERT_EQ(bulk.numNodes(), dict.numNodes());
+    checkHighestFq(bulk, bulk.root);
+    checkBalanced(bulk, bulk.root);
+    ASSERT_FALSE(bulk.find("zz"));
+    for (const pair<string, unsigned int>& e : entries) {
+        ASSERT_TRUE(bulk.find(e.first));
+    }
+    for (const string& prefix : prefixes) {
+        for (unsigned int num : {1u, 5u, 1000u}) {
+            ASSERT_EQ(bulk.predictCompletions(prefix, num),
+                      dict.predictCompletions(prefix, num));
+        }
+    }
+
+    // on a TST that holds words already the records are inserted, and
+    // the record of a word that is there already is ignored
+    ASSERT_TRUE(dict.find("ab"));
+    vector<DictionaryTrie::Record> more = {{"ab", 99}, {"zebra", 7}};
+    bulk.bulkBuild(more);
+    ASSERT_EQ(bulk.predictCompletions("z", 5), vector<string>{"zebra"});
+    ASSERT_EQ(bulk.predictCompletions("ab", 1),
+              dict.predictCompletions("ab", 1));
+    checkHighestFq(bulk, bulk.root);
+}
+
+/* Return true if some prefix of word is within maxEdits edits of
+ * prefix, by filling the whole edit distance table */
+static bool fuzzyMatch(const string& prefix, const string& word,
+                       unsigned int maxEdits) {
+    vector<vector<unsigned int>> dist(
+        word.length() + 1, vector<unsigned int>(prefix.length() + 1));
+    for (size_t j = 0; j <= prefix.length(); j++) {
+        dist[0][j] = j;
+    }
+    for (size_t i = 1; i <= word.length(); i++) {
+        dist[i][0] = i;
+        for (size_t j = 1; j <= prefix.length(); j++) {
+            dist[i][j] = min({dist[i - 1][j] + 1, dist[i][j - 1] + 1,
+                              dist[i - 1][j - 1] +
+                                  (word[i - 1] != prefix[j - 1])});
+        }
+    }
+    for (size_t i = 0; i <= word.length(); i++) {
+        if (dist[i][prefix.length()] <= maxEdits) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// predictFuzzy gives the most frequent words of a scan with the full
+// edit distance table
+TEST_F(TrieCacheTest, FUZZY_MATCHES_SCAN_TEST) {
+    sort(entries.begin(), entries.end(),
+         [](const pair<string, unsigned int>& a,
+            const pair<string, unsigned int>& b) {
+             return a.second != b.second ? a.second > b.second
+                                         : a.first < b.first;
+         });
+    vector<string> queries = {"a", "ab", "abc", "fab", "eeaa",
+                              "xyz", "abcde", "bdbdbd"};
+    for (const string& prefix : queries) {
+        for (unsigned int edits : {0u, 1u, 2u, 3u}) {
+            for (unsigned int num : {1u, 5u, 1000u}) {
+                vector<string> expected;
+                for (const pair<string, unsigned int>& e : entries) {
+                    if (expected.size() < num &&
+                        fuzzyMatch(prefix, e.first, edits)) {
+                        expected.push_back(e.first);
+                    }
+                }
+                ASSERT_EQ(dict.predictFuzzy(prefix, edits, num), expected)
+                    << prefix << " " << edits << " " << num;
+            }
+        }
+    }
+}
+
+// With no edits predictFuzzy is predictCompletions
+TEST(DictTrieTests, FUZZY_TEST) {
+    DictionaryTrie dict;
+    dict.insert("apple", 10);
+    dict.insert("apply", 30);
+    dict.insert("ample", 20);
+    dict.insert("maple", 5);
+    ASSERT_EQ(dict.predictFuzzy("app", 0, 5),
+              dict.predictCompletions("app", 5));
+    vector<string> oneEdit = {"apply", "ample", "apple"};
+    ASSERT_EQ(dict.predictFuzzy("app", 1, 5), oneEdit);
+    vector<string> twoEdits = {"apply", "ample", "apple", "maple"};
+    ASSERT_EQ(dict.predictFuzzy("apl", 2, 5), twoEdits);
+    ASSERT_EQ(dict.predictFuzzy("", 2, 5), vector<string>());
+}
+
+// SearchStats adds up the nodes of every call that is given it
+TEST(DictTrieTests, SEARCH_STATS_TEST) {
+    DictionaryTrie dict;
+    DictionaryTrie::SearchStats stats;
+    ASSERT_TRUE(dict.insert("abc", 1, &stats));
+    ASSERT_EQ(stats.nodesVisited, 3);
+    ASSERT_TRUE(dict.find("abc", &stats));
+    ASSERT_FALSE(dict.find("abd", &stats));
+    ASSERT_EQ(stats.nodesVisited, 9);
+
+    stats = DictionaryTrie::SearchStats();
+    DictionaryTrie::SearchScratch scratch;
+    vector<string> abc = {"abc"};
+    ASSERT_EQ(dict.predictCompletions("ab", 5, scratch, &stats), abc);
+    ASSERT_EQ(stats.nodesVisited, 3);
+    ASSERT_EQ(dict.predictUnderscores("a_c", 5, &stats), abc);
+    ASSERT_EQ(stats.nodesVisited, 6);
+}
+
+// Equal frequencies go to the alphabetically smaller word, with bytes
+// compared as unsigned like std::string does, whichever way the TST
+// was built
+TEST(DictTrieTests, UNSIGNED_ORDER_TEST) {
+    vector<string> words = {"a\xE9", "ab", "a\x7F", "a", "a\xE9z"};
+    DictionaryTrie dict;
+    DictionaryTrie bulk;
+    vector<DictionaryTrie::Record> records;
+    for (const string& w : words) {
+        dict.insert(w, 7);
+        records.push_back(DictionaryTrie::Record{w, 7});
+    }
+    bulk.bulkBuild(records);
+    vector<string> sorted = words;
+    sort(sorted.begin(), sorted.end());
+    ASSERT_EQ(dict.predictCompletions("a", 10), sorted);
+    ASSERT_EQ(bulk.predictCompletions("a", 10), sorted);
+    for (const string& w : words) {
+        ASSERT_TRUE(bulk.find(w)) << w;
+    }
+}
+
+// The buffer overload only grows out and reuses its strings
+TEST(DictTrieTests, OUTPUT_BUFFER_TEST) {
+    DictionaryTrie dict;
+    dict.insert("apple", 10);
+    dict.insert("apply", 30);
+    dict.insert("ape", 20);
+    dict.insert("bee", 5);
+    DictionaryTrie::SearchScratch scratch;
+    vector<string> out;
+    ASSERT_EQ(dict.predictCompletions("a", 10, scratch, out), 3);
+    vector<string> all = {"apply", "ape", "apple"};
+    ASSERT_EQ(out, all);
+    ASSERT_EQ(dict.predictCompletions("b", 10, scratch, out), 1);
+    ASSERT_EQ(out.size(), 3);
+    ASSERT_EQ(out[0], "bee");
+    ASSERT_EQ(dict.predictCompletions("c", 10, scratch, out), 0);
+    ASSERT_EQ(dict.predictCompletions("appl", 1, scratch, out), 1);
+    ASSERT_EQ(out[0], "apply");
+}
+
+// A k far above the number of words costs no more than the words, in
+// both search orders and both engines
+TEST(DictTrieTests, LARGE_K_TEST) {
+    const unsigned int HUGE_K = 4000000000u;
+    for (DictionaryTrie::Engine engine :
+         {DictionaryTrie::TST, DictionaryTrie::ART}) {
+        DictionaryTrie dict(engine);
+        dict.insert("apple", 10);
+        dict.insert("ape", 20);
+        vector<string> all = {"ape", "apple"};
+        ASSERT_EQ(dict.predictCompletions("a", HUGE_K), all);
+        ASSERT_EQ(dict.predictUnderscores("ap_", HUGE_K),
+                  vector<string>{"ape"});
+        if (engine == DictionaryTrie::TST) {
+            dict.setSearchOrder(DictionaryTrie::BEST_FIRST);
+            ASSERT_EQ(dict.predictCompletions("a", HUGE_K), all);
+        }
+    }
+}
+
+// A snapshot loads back into the same TST, which keeps working
+TEST_F(TrieCacheTest, SNAPSHOT_TEST) {
+    const string FILE_NAME = "test_DictionaryTrie.snapshot";
+    // removals leave free slots that the snapshot keeps
+    for (size_t i = 0; i < entries.size(); i += 7) {
+        ASSERT_TRUE(dict.remove(entries[i].first));
+    }
+    dict.buildCompletionCache(10, 2);
+    vector<unsigned int> nums = {1, 3, 10, 25};
+    vector<vector<string>> expected = answerAll(nums);
+    ASSERT_TRUE(dict.save(FILE_NAME));
+
+    DictionaryTrie loaded;
+    loaded.insert("zzz", 3);
+    ASSERT_TRUE(loaded.load(FILE_NAME));
+    ASSERT_FALSE(loaded.find("zzz"));
+    ASSERT_EQ(loaded.numNodes(), dict.numNodes());
+    ASSERT_EQ(loaded.completionCacheMemory(), 0);
+    swap(dict, loaded);
+    ASSERT_EQ(answerAll(nums), expected);
+    for (size_t i = 0; i < entries.size(); i++) {
+        ASSERT_EQ(dict.find(entries[i].first), i % 7 != 0);
+    }
+    ASSERT_TRUE(dict.insert(entries[0].first, 50));
+    ASSERT_EQ(dict.predictCompletions(entries[0].first.substr(0, 1), 1),
+              vector<string>{entries[0].first});
+
+    // a truncated file, another version and another format are refused
+    ifstream in(FILE_NAME, ios::binary);
+    string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    ofstream(FILE_NAME, ios::binary) << bytes.substr(0, bytes.size() - 1);
+    ASSERT_FALSE(loaded.load(FILE_NAME));
+    string other = bytes;
+    other[8] = char(DictionaryTrie::SNAPSHOT_VERSION + 1);
+    ofstream(FILE_NAME, ios::binary) << other;
+    ASSERT_FALSE(loaded.load(FILE_NAME));
+    other = bytes;
+    other[0] = 'X';
+    ofstream(FILE_NAME, ios::binary) << other;
+    ASSERT_FALSE(loaded.load(FILE_NAME));
+    ASSERT_FALSE(loaded.load("no_such_file.snapshot"));
+    ASSERT_EQ(loaded.predictCompletions("a", 25), expected[0 * 4 + 3]);
+
+    // the same TST saves the same bytes, padding included
+    ASSERT_TRUE(loaded.save(FILE_NAME));
+    ifstream again(FILE_NAME, ios::binary);
+    ASSERT_EQ(string((istreambuf_iterator<char>(again)),
+                     istreambuf_iterator<char>()),
+              bytes);
+    again.close();
+
+    DictionaryTrie art(DictionaryTrie::ART);
+    ASSERT_FALSE(art.save(FILE_NAME));
+    ASSERT_FALSE(art.load(FILE_NAME));
+    remove(FILE_NAME.c_str());
+}
+
+// A snapshot whose links stay in the pool but form a cycle, or put a
+// slot in use on the free list, is refused
+TEST(DictTrieTests, SNAPSHOT_CYCLE_TEST) {
+    const string FILE_NAME = "test_DictionaryTrie_cycle.snapshot";
+    const size_t NODE = sizeof(DictionaryTrie::TrieNode);
+    DictionaryTrie dict;
+    dict.insert("ab", 1);
+    dict.insert("ac", 2);
+    // nodes a, b and c; c is freed onto the free list
+    dict.remove("ac");
+    ASSERT_TRUE(dict.save(FILE_NAME));
+    ifstream in(FILE_NAME, ios::binary);
+    string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    size_t pool = bytes.size() - 3 * NODE;
+
+    auto refused = [&](size_t node, size_t field, uint32_t link) {
+        string changed = bytes;
+        memcpy(&changed[pool + node * NODE + field], &link, sizeof(link));
+        ofstream(FILE_NAME, ios::binary) << changed;
+        DictionaryTrie loaded;
+        return !loaded.load(FILE_NAME);
+    };
+    ASSERT_FALSE(refused(0, 0, DictionaryTrie::NIL));
+    ASSERT_TRUE(refused(1, offsetof(DictionaryTrie::TrieNode, left), 0));
+    ASSERT_TRUE(refused(0, offsetof(DictionaryTrie::TrieNode, right), 1));
+    ASSERT_TRUE(refused(2, offsetof(DictionaryTrie::TrieNode, middle), 2));
+    ASSERT_TRUE(refused(2, offsetof(DictionaryTrie::TrieNode, middle), 1));
+    remove(FILE_NAME.c_str());
+}
+
+// The best-first search gives the answers of the depth-first one, ties
+// included
+TEST_F(TrieCacheTest, BEST_FIRST_TEST) {
+    vector<unsigned int> nums = {1, 3, 10, 25, 5000};
+    vector<vector<string>> expected = answerAll(nums);
+    ASSERT_EQ(dict.searchOrder(), DictionaryTrie::DEPTH_FIRST);
+    dict.setSearchOrder(DictionaryTrie::BEST_FIRST);
+    ASSERT_EQ(answerAll(nums), expected);
+
+    // ties at the cut, and the prefix as a word of its own
+    for (size_t i = 0; i < entries.size(); i += 5) {
+        ASSERT_TRUE(dict.updateFrequency(entries[i].first, 20));
+    }
+    ASSERT_TRUE(dict.insert("fa", 20));
+    ASSERT_TRUE(dict.insert("fab", 20));
+    expected = answerAll(nums);
+    dict.setSearchOrder(DictionaryTrie::DEPTH_FIRST);
+    ASSERT_EQ(answerAll(nums), expected);
+}
+
+// With distinct frequencies the best-first search enters fewer subtrees
+// than the depth-first one to find the top words, and both prune
+TEST_F(TrieCacheTest, BEST_FIRST_STATS_TEST) {
+    DictionaryTrie distinct;
+    for (size_t i = 0; i < entries.size(); i++) {
+        distinct.insert(entries[i].first, i + 1);
+    }
+    DictionaryTrie::SearchScratch scratch;
+    for (unsigned int num : {1u, 10u}) {
+        DictionaryTrie::SearchStats depthFirst;
+        distinct.setSearchOrder(DictionaryTrie::DEPTH_FIRST);
+        vector<string> expected =
+            distinct.predictCompletions("a", num, scratch, &depthFirst);
+        DictionaryTrie::SearchStats bestFirst;
+        distinct.setSearchOrder(DictionaryTrie::BEST_FIRST);
+        ASSERT_EQ(distinct.predictCompletions("a", num, scratch, &bestFirst),
+                  expected);
+        ASSERT_LT(bestFirst.nodesVisited, depthFirst.nodesVisited);
+        ASSERT_GT(bestFirst.nodesPruned, 0);
+        ASSERT_GT(depthFirst.nodesPruned, 0);
+    }
+}
+
+// find reads the bytes of its word where they are, from a string, a
+// string_view or a string literal, and allocates nothing
+TEST_F(TrieCacheTest, FIND_ALLOCATION_TEST) {
+    string text;
+    for (const pair<string, unsigned int>& entry : entries) {
+        text += entry.first + ' ';
+    }
+    string_view view(text);
+    size_t found = 0;
+    size_t before = numAllocs;
+    for (size_t i = 0, at = 0; i < entries.size(); i++) {
+        size_t len = entries[i].first.size();
+        found += dict.find(view.substr(at, len));
+        found += dict.find(entries[i].first);
+        at += len + 1;
+    }
+    found += dict.find("a long word that is not in the dictionary");
+    ASSERT_EQ(numAllocs.load(), before);
+    ASSERT_EQ(found, 2 * entries.size());
+
+    // insert copies the word into its nodes only
+    before = numAllocs;
+    ASSERT_TRUE(dict.insert(view.substr(0, entries[0].first.size() + 1), 3));
+    ASSERT_FALSE(dict.insert(view.substr(0, entries[0].first.size()), 3));
+    ASSERT_LE(numAllocs.load(), before + 1);
+    ASSERT_TRUE(dict.find(entries[0].first + ' '));
+}
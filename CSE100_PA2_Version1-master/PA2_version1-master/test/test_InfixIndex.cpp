@@ -0,0 +1,113 @@
+/**
+ * This file contains tests for the substring index over dictionary
+ * phrases, against a scan of every phrase.
+ */
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "InfixIndex.hpp"
+
+using namespace std;
+using namespace testing;
+
+/* Return the numCompletions most frequent phrases of dict containing
+ * substring, by scanning all of them */
+static vector<string> scanInfix(
+    const vector<pair<string, unsigned int>>& dict, const string& substring,
+    unsigned int numCompletions) {
+    vector<pair<string, unsigned int>> matches;
+    for (const pair<string, unsigned int>& entry : dict) {
+        if (!substring.empty() &&
+            entry.first.find(substring) != string::npos) {
+            matches.push_back(entry);
+        }
+    }
+    sort(matches.begin(), matches.end(),
+         [](const pair<string, unsigned int>& a,
+            const pair<string, unsigned int>& b) {
+             if (a.second != b.second) {
+                 return a.second > b.second;
+             }
+             return a.first < b.first;
+         });
+    vector<string> top;
+    for (size_t i = 0; i < matches.size() && i < numCompletions; i++) {
+        top.push_back(matches[i].first);
+    }
+    return top;
+}
+
+/* Matches inside, at the start and at the end of phrases, counted per
+ * place but reported once per phrase */
+TEST(InfixIndexTests, SMALL_TEST) {
+    vector<DictionaryTrie::Record> records = {
+        {"verified that the", 10}, {"the the", 4}, {"bathe", 7},
+        {"other", 7}, {"the", 0}, {"", 3}, {"that", 2}, {"bathe", 100},
+        {"line\nbreak", 9}};
+    InfixIndex index;
+    index.build(records);
+    ASSERT_EQ(index.numPhrases(), 5);
+    vector<string> expected = {"verified that the", "bathe", "other",
+                               "the the"};
+    ASSERT_EQ(index.predictInfix("the", 10), expected);
+    ASSERT_EQ(index.countOccurrences("the"), 5);
+    ASSERT_EQ(index.predictInfix("the", 2),
+              vector<string>({"verified that the", "bathe"}));
+    ASSERT_EQ(index.predictInfix("hat", 10),
+              vector<string>({"verified that the", "that"}));
+    ASSERT_EQ(index.predictInfix("the the", 10),
+              vector<string>({"the the"}));
+    ASSERT_TRUE(index.predictInfix("the  the", 10).empty());
+    ASSERT_TRUE(index.predictInfix("e\nb", 10).empty());
+    ASSERT_TRUE(index.predictInfix("", 10).empty());
+    ASSERT_TRUE(index.predictInfix("the", 0).empty());
+    ASSERT_EQ(index.countOccurrences("zzz"), 0);
+}
+
+/* Random phrases over a small alphabet, with many matches and many
+ * equal frequencies, answer like a scan */
+TEST(InfixIndexTests, RANDOM_TEST) {
+    const string alphabet = "ab c\xe9";
+    mt19937 gen(23);
+    vector<DictionaryTrie::Record> records;
+    vector<string> phrases;
+    for (int i = 0; i < 3000; i++) {
+        string phrase;
+        int len = 1 + gen() % 12;
+        for (int j = 0; j < len; j++) {
+            phrase.push_back(alphabet[gen() % alphabet.size()]);
+        }
+        phrases.push_back(phrase);
+    }
+    vector<pair<string, unsigned int>> dict;
+    for (const string& phrase : phrases) {
+        unsigned int freq = 1 + gen() % 20;
+        records.push_back({phrase, freq});
+        if (find_if(dict.begin(), dict.end(),
+                    [&](const pair<string, unsigned int>& e) {
+                        return e.first == phrase;
+                    }) == dict.end()) {
+            dict.push_back({phrase, freq});
+        }
+    }
+    InfixIndex index;
+    index.build(records);
+    ASSERT_EQ(index.numPhrases(), dict.size());
+    for (int q = 0; q < 300; q++) {
+        const string& phrase = phrases[gen() % phrases.size()];
+        size_t at = gen() % phrase.size();
+        string substring = phrase.substr(at, 1 + gen() % 5);
+        if (q % 10 == 0) {
+            substring.push_back(alphabet[gen() % alphabet.size()]);
+        }
+        for (unsigned int num : {1u, 3u, 10u, 5000u}) {
+            ASSERT_EQ(index.predictInfix(substring, num),
+                      scanInfix(dict, substring, num))
+                << substring << " " << num;
+        }
+    }
+}
@@ -0,0 +1,206 @@
+/**
+ * This file contains tests for the dictionary of a base trie and a
+ * delta on top of it, against a single DictionaryTrie given the same
+ * changes.
+ */
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "LayeredDictionary.hpp"
+
+using namespace std;
+using namespace testing;
+
+/* Return a random word of 1 to 6 letters from a to e */
+static string randomWord(mt19937& gen) {
+    string word;
+    int len = 1 + gen() % 6;
+    for (int i = 0; i < len; i++) {
+        word.push_back('a' + gen() % 5);
+    }
+    return word;
+}
+
+/* Return a DictionaryTrie holding words with the given frequencies */
+static DictionaryTrie makeTrie(
+    const vector<string>& words, const vector<unsigned int>& freqs,
+    DictionaryTrie::Engine engine = DictionaryTrie::TST) {
+    vector<DictionaryTrie::Record> records;
+    for (size_t i = 0; i < words.size(); i++) {
+        records.push_back({words[i], freqs[i]});
+    }
+    DictionaryTrie trie(engine);
+    trie.bulkBuild(records);
+    return trie;
+}
+
+/* The delta shadows, removes and adds back words of the base, and a
+ * compaction keeps every answer */
+TEST(LayeredDictionaryTests, SMALL_TEST) {
+    LayeredDictionary dict(makeTrie({"apple", "apply", "ape", "bee"},
+                                    {10, 30, 20, 5}));
+    vector<string> all = {"apply", "ape", "apple"};
+    ASSERT_EQ(dict.predictCompletions("a", 10), all);
+    ASSERT_EQ(dict.predictCompletions("a", 4000000000u), all);
+    ASSERT_FALSE(dict.insert("ape", 1));
+    ASSERT_FALSE(dict.insert("", 1));
+    ASSERT_FALSE(dict.insert("apt", 0));
+    ASSERT_TRUE(dict.insert("apt", 25));
+    ASSERT_TRUE(dict.updateFrequency("apple", 40));
+    ASSERT_TRUE(dict.remove("apply"));
+    ASSERT_FALSE(dict.remove("apply"));
+    ASSERT_FALSE(dict.updateFrequency("apply", 3));
+    ASSERT_EQ(dict.deltaSize(), 3);
+    vector<string> changed = {"apple", "apt", "ape"};
+    ASSERT_EQ(dict.predictCompletions("a", 10), changed);
+    ASSERT_EQ(dict.predictUnderscores("ap_", 10),
+              vector<string>({"apt", "ape"}));
+    ASSERT_EQ(dict.frequency("apple"), 40);
+    ASSERT_FALSE(dict.find("apply"));
+
+    ASSERT_TRUE(dict.startCompaction());
+    dict.waitForCompaction();
+    ASSERT_EQ(dict.numCompactions(), 1);
+    ASSERT_EQ(dict.deltaSize(), 0);
+    ASSERT_FALSE(dict.startCompaction());
+    ASSERT_EQ(dict.predictCompletions("a", 10), changed);
+    ASSERT_FALSE(dict.find("apply"));
+
+    ASSERT_TRUE(dict.insert("apply", 2));
+    ASSERT_TRUE(dict.updateFrequency("apt", 0));
+    ASSERT_EQ(dict.predictCompletions("a", 10),
+              vector<string>({"apple", "ape", "apply"}));
+    ASSERT_EQ(dict.predictCompletions("b", 10), vector<string>({"bee"}));
+}
+
+/* A compaction over an ART base keeps the base words, in a new ART
+ * base */
+TEST(LayeredDictionaryTests, ART_BASE_TEST) {
+    LayeredDictionary dict(
+        makeTrie({"apple", "apply"}, {10, 30}, DictionaryTrie::ART));
+    ASSERT_TRUE(dict.insert("apex", 20));
+    ASSERT_TRUE(dict.startCompaction());
+    dict.waitForCompaction();
+    ASSERT_EQ(dict.numCompactions(), 1);
+    ASSERT_TRUE(dict.find("apple"));
+    ASSERT_EQ(dict.frequency("apply"), 30);
+    ASSERT_EQ(dict.predictCompletions("ap", 10),
+              vector<string>({"apply", "apex", "apple"}));
+
+    ASSERT_TRUE(dict.remove("apply"));
+    ASSERT_TRUE(dict.startCompaction());
+    dict.waitForCompaction();
+    ASSERT_EQ(dict.predictCompletions("ap", 10),
+              vector<string>({"apex", "apple"}));
+}
+
+/* Random changes with compactions started by hand and by size, checked
+ * against one DictionaryTrie while they run and after them */
+TEST(LayeredDictionaryTests, RANDOM_TEST) {
+    mt19937 gen(11);
+    vector<string> words;
+    vector<unsigned int> freqs;
+    for (int i = 0; i < 2000; i++) {
+        words.push_back(randomWord(gen));
+        freqs.push_back(1 + gen() % 30);
+    }
+    DictionaryTrie single = makeTrie(words, freqs);
+    LayeredDictionary dict(makeTrie(words, freqs), 150);
+
+    auto check = [&]() {
+        for (int q = 0; q < 50; q++) {
+            string word = randomWord(gen);
+            ASSERT_EQ(dict.frequency(word), single.frequency(word)) << word;
+            string prefix = word.substr(0, 1 + gen() % 2);
+            for (unsigned int num : {1u, 5u, 40u}) {
+                ASSERT_EQ(dict.predictCompletions(prefix, num),
+                          single.predictCompletions(prefix, num))
+                    << prefix << " " << num;
+            }
+            string pattern = word;
+            pattern[gen() % pattern.size()] = '_';
+            ASSERT_EQ(dict.predictUnderscores(pattern, 5),
+                      single.predictUnderscores(pattern, 5))
+                << pattern;
+        }
+    };
+    for (int op = 0; op < 3000; op++) {
+        string word = randomWord(gen);
+        unsigned int freq = gen() % 40;
+        switch (gen() % 3) {
+            case 0:
+                ASSERT_EQ(dict.insert(word, freq + 1),
+                          single.insert(word, freq + 1));
+                break;
+            case 1:
+                ASSERT_EQ(dict.updateFrequency(word, freq),
+                          single.updateFrequency(word, freq));
+                break;
+            default:
+                ASSERT_EQ(dict.remove(word), single.remove(word));
+        }
+        if (op % 500 == 0) {
+            dict.startCompaction();
+        }
+        if (op % 100 == 0) {
+            check();
+        }
+    }
+    dict.waitForCompaction();
+    ASSERT_GT(dict.numCompactions(), 1);
+    check();
+}
+
+/* Queries give the same answers while another thread changes other
+ * words and compactions swap in new bases */
+TEST(LayeredDictionaryTests, CONCURRENT_TEST) {
+    const int NUM_READERS = 3;
+    mt19937 gen(5);
+    vector<string> words;
+    vector<unsigned int> freqs;
+    for (int i = 0; i < 3000; i++) {
+        words.push_back(randomWord(gen));
+        freqs.push_back(1 + gen() % 30);
+    }
+    LayeredDictionary dict(makeTrie(words, freqs), 50);
+    vector<string> prefixes = {"a", "ab", "bad", "c", "de", "e"};
+    vector<vector<string>> expected;
+    for (const string& prefix : prefixes) {
+        expected.push_back(dict.predictCompletions(prefix, 10));
+    }
+
+    atomic<bool> done(false);
+    atomic<int> wrong(0);
+    vector<thread> readers;
+    for (int r = 0; r < NUM_READERS; r++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                for (size_t i = 0; i < prefixes.size(); i++) {
+                    if (dict.predictCompletions(prefixes[i], 10) !=
+                        expected[i]) {
+                        wrong++;
+                    }
+                }
+            }
+        });
+    }
+    // the changed words start with z, which no prefix matches
+    for (int op = 0; op < 2000; op++) {
+        string word = "z" + randomWord(gen);
+        if (!dict.insert(word, 1 + gen() % 100)) {
+            dict.updateFrequency(word, gen() % 3);
+        }
+    }
+    dict.waitForCompaction();
+    done = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQ(wrong, 0);
+    ASSERT_GT(dict.numCompactions(), 0);
+}
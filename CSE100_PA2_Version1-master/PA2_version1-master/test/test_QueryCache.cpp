@@ -0,0 +1,128 @@
+/**
+ * This file contains tests for the QueryCache of predictCompletions
+ * answers, on its own and behind DictionaryTrie.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "DictionaryTrie.hpp"
+#include "QueryCache.hpp"
+
+using namespace std;
+using namespace testing;
+
+/* An answer for a larger k answers a smaller one, and an answer holding
+ * fewer words than asked for answers any k */
+TEST(QueryCacheTests, K_MONOTONIC_TEST) {
+    QueryCache cache(16, 2);
+    vector<string> out = {"ab", "abc", "abd"};
+    size_t count = 0;
+    ASSERT_FALSE(cache.lookup("ab", 2, out, count));
+    cache.store("ab", 3, out, 3);
+    ASSERT_TRUE(cache.lookup("ab", 2, out, count));
+    ASSERT_EQ(count, 2);
+    ASSERT_TRUE(cache.lookup("ab", 3, out, count));
+    ASSERT_FALSE(cache.lookup("ab", 4, out, count));
+    ASSERT_FALSE(cache.lookup("a", 1, out, count));
+
+    vector<string> few = {"xy"};
+    cache.store("x", 5, few, 1);
+    vector<string> empty;
+    ASSERT_TRUE(cache.lookup("x", 100, empty, count));
+    ASSERT_EQ(count, 1);
+    ASSERT_EQ(empty, few);
+
+    QueryCache::Stats stats = cache.stats();
+    ASSERT_EQ(stats.hits, 3);
+    ASSERT_EQ(stats.misses, 3);
+}
+
+/* Invalidation drops the prefixes of the word and nothing else */
+TEST(QueryCacheTests, INVALIDATE_TEST) {
+    QueryCache cache(64, 4);
+    vector<string> out = {"word"};
+    for (const string prefix : {"a", "ap", "app", "b", "apple", "apt"}) {
+        cache.store(prefix, 10, out, 1);
+    }
+    cache.invalidate("apps");
+    size_t count;
+    ASSERT_FALSE(cache.lookup("a", 1, out, count));
+    ASSERT_FALSE(cache.lookup("ap", 1, out, count));
+    ASSERT_FALSE(cache.lookup("app", 1, out, count));
+    ASSERT_TRUE(cache.lookup("b", 1, out, count));
+    ASSERT_TRUE(cache.lookup("apple", 1, out, count));
+    ASSERT_TRUE(cache.lookup("apt", 1, out, count));
+    ASSERT_EQ(cache.stats().invalidations, 3);
+    ASSERT_EQ(cache.size(), 3);
+    cache.clear();
+    ASSERT_EQ(cache.size(), 0);
+}
+
+/* A full shard evicts an entry that was not hit since the hand passed */
+TEST(QueryCacheTests, EVICTION_TEST) {
+    QueryCache cache(4, 1);
+    vector<string> out = {"w"};
+    size_t count;
+    for (const string prefix : {"a", "b", "c", "d"}) {
+        cache.store(prefix, 1, out, 1);
+    }
+    ASSERT_TRUE(cache.lookup("a", 1, out, count));
+    cache.store("e", 1, out, 1);
+    ASSERT_EQ(cache.size(), 4);
+    ASSERT_EQ(cache.stats().evictions, 1);
+    ASSERT_TRUE(cache.lookup("a", 1, out, count));
+    ASSERT_FALSE(cache.lookup("b", 1, out, count));
+    ASSERT_TRUE(cache.lookup("e", 1, out, count));
+}
+
+/* With either engine, cached answers stay the answers of a trie without
+ * a cache while words are inserted, updated and removed */
+TEST(QueryCacheTests, DICTIONARY_TEST) {
+    for (DictionaryTrie::Engine engine :
+         {DictionaryTrie::TST, DictionaryTrie::ART}) {
+        DictionaryTrie plain(engine);
+        DictionaryTrie cached(engine);
+        cached.enableQueryCache(64, 4);
+        const string alphabet = "abc";
+        mt19937 gen(3);
+        auto randomWord = [&](unsigned int maxLen) {
+            string word;
+            int len = 1 + gen() % maxLen;
+            for (int j = 0; j < len; j++) {
+                word.push_back(alphabet[gen() % alphabet.size()]);
+            }
+            return word;
+        };
+        for (int i = 0; i < 3000; i++) {
+            string word = randomWord(5);
+            unsigned int freq = 1 + gen() % 50;
+            switch (gen() % 4) {
+                case 0:
+                    ASSERT_EQ(cached.insert(word, freq),
+                              plain.insert(word, freq));
+                    break;
+                case 1:
+                    ASSERT_EQ(cached.updateFrequency(word, freq),
+                              plain.updateFrequency(word, freq));
+                    break;
+                case 2:
+                    ASSERT_EQ(cached.remove(word), plain.remove(word));
+                    break;
+                default:
+                    string prefix = randomWord(3);
+                    unsigned int num = 1 + gen() % 8;
+                    ASSERT_EQ(cached.predictCompletions(prefix, num),
+                              plain.predictCompletions(prefix, num))
+                        << prefix << " " << num;
+            }
+        }
+        QueryCache::Stats stats = cached.queryCache()->stats();
+        ASSERT_GT(stats.hits, 0);
+        ASSERT_GT(stats.invalidations, 0);
+        cached.disableQueryCache();
+        ASSERT_EQ(cached.queryCache(), nullptr);
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * This file contains tests for the dictionary sharded by first byte,
+ * against a single DictionaryTrie holding the same words.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "ShardedDictionary.hpp"
+
+using namespace std;
+using namespace testing;
+
+/* Return a random word of 1 to 8 bytes over alphabet */
+static string randomWord(mt19937& gen, const string& alphabet) {
+    string word;
+    int len = 1 + gen() % 8;
+    for (int i = 0; i < len; i++) {
+        word.push_back(alphabet[gen() % alphabet.size()]);
+    }
+    return word;
+}
+
+/* The ranges of first bytes follow the records, and words of a byte no
+ * record starts with still have a shard */
+TEST(ShardedDictionaryTests, SMALL_TEST) {
+    vector<string> words = {"apple", "apply", "banana", "band", "cat",
+                            "car", "dog", "do", "apple", ""};
+    vector<DictionaryTrie::Record> records;
+    for (size_t i = 0; i < words.size(); i++) {
+        records.push_back({words[i], unsigned(i + 1)});
+    }
+    ShardedDictionary dict(2);
+    ASSERT_EQ(dict.numShards(), 1);
+    dict.build(records, 3);
+    ASSERT_EQ(dict.numShards(), 3);
+    ASSERT_TRUE(dict.find("apple"));
+    ASSERT_FALSE(dict.find("app"));
+    ASSERT_FALSE(dict.find(""));
+    ASSERT_EQ(dict.shard(0).frequency("apple"), 1);
+    ASSERT_EQ(dict.predictCompletions("ap", 5),
+              vector<string>({"apply", "apple"}));
+    ASSERT_EQ(dict.predictCompletions("ap", 4000000000u),
+              vector<string>({"apply", "apple"}));
+    ASSERT_EQ(dict.predictUnderscores("_a_", 5),
+              vector<string>({"car", "cat"}));
+    ASSERT_EQ(dict.predictUnderscores("_o", 5), vector<string>({"do"}));
+    ASSERT_EQ(dict.predictUnderscores("ba_d", 5), vector<string>({"band"}));
+
+    ASSERT_TRUE(dict.insert("zebra", 50));
+    ASSERT_FALSE(dict.insert("", 50));
+    ASSERT_EQ(dict.predictUnderscores("_e_r_", 5),
+              vector<string>({"zebra"}));
+    ASSERT_TRUE(dict.updateFrequency("dog", 100));
+    ASSERT_EQ(dict.predictUnderscores("__", 1), vector<string>({"do"}));
+    ASSERT_EQ(dict.predictUnderscores("___", 1), vector<string>({"dog"}));
+    ASSERT_TRUE(dict.remove("dog"));
+    ASSERT_FALSE(dict.remove("dog"));
+    ASSERT_EQ(dict.predictUnderscores("___", 1), vector<string>({"car"}));
+}
+
+/* Random words, updates and queries answer like one DictionaryTrie, for
+ * several shard counts */
+TEST(ShardedDictionaryTests, RANDOM_TEST) {
+    const string alphabet = "abcdefgh xyz\xe9";
+    for (unsigned int numShards : {1u, 2u, 5u, 300u}) {
+        mt19937 gen(numShards);
+        vector<string> words;
+        for (int i = 0; i < 4000; i++) {
+            words.push_back(randomWord(gen, alphabet));
+        }
+        vector<DictionaryTrie::Record> records;
+        for (const string& word : words) {
+            records.push_back({word, 1 + unsigned(gen() % 30)});
+        }
+        vector<DictionaryTrie::Record> copy = records;
+        DictionaryTrie single;
+        single.bulkBuild(copy);
+        ShardedDictionary dict(3);
+        dict.build(records, numShards);
+        ASSERT_EQ(dict.numShards(), min(numShards, 256u));
+
+        for (int op = 0; op < 300; op++) {
+            string word = op % 2 ? words[gen() % words.size()]
+                                 : randomWord(gen, alphabet);
+            unsigned int freq = gen() % 40;
+            switch (op % 3) {
+                case 0:
+                    ASSERT_EQ(dict.insert(word, freq),
+                              single.insert(word, freq));
+                    break;
+                case 1:
+                    ASSERT_EQ(dict.updateFrequency(word, freq),
+                              single.updateFrequency(word, freq));
+                    break;
+                default:
+                    ASSERT_EQ(dict.remove(word), single.remove(word));
+            }
+        }
+
+        for (int q = 0; q < 200; q++) {
+            const string& word = words[gen() % words.size()];
+            ASSERT_EQ(dict.find(word), single.find(word));
+            string prefix = word.substr(0, 1 + gen() % 3);
+            ASSERT_EQ(dict.predictCompletions(prefix, 10),
+                      single.predictCompletions(prefix, 10));
+            string pattern = word.substr(0, 1 + gen() % 4);
+            pattern[gen() % pattern.size()] = '_';
+            if (q % 2 == 0) {
+                pattern[0] = '_';
+            }
+            for (unsigned int num : {1u, 7u, 100u}) {
+                ASSERT_EQ(dict.predictUnderscores(pattern, num),
+                          single.predictUnderscores(pattern, num))
+                    << pattern << " " << num;
+            }
+        }
+    }
+}
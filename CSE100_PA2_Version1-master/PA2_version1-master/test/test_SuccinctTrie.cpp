@@ -0,0 +1,142 @@
+/**
+ * This file contains tests for SuccinctTrie: a trie file written from a
+ * DictionaryTrie must answer every query exactly like the DictionaryTrie.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "DictionaryTrie.hpp"
+#include "SuccinctTrie.hpp"
+
+using namespace std;
+using namespace testing;
+
+static const char* TRIE_FILE = "test_SuccinctTrie.trie";
+
+/**
+ * Write a random dictionary to a trie file and map it. The alphabet
+ * has a space, '_' and a character above 127 so that the order of the
+ * labels and the wildcard rules are exercised.
+ * */
+class SuccinctTrieTest : public ::testing::Test {
+  protected:
+    DictionaryTrie dict;
+    SuccinctTrie trie;
+    vector<string> queries;
+
+  public:
+    SuccinctTrieTest() {
+        const string alphabet = "abcde _Z\xe9";
+        mt19937 gen(11);
+        for (int i = 0; i < 4000; i++) {
+            string word;
+            int len = 1 + gen() % 7;
+            for (int j = 0; j < len; j++) {
+                word.push_back(alphabet[gen() % 5 == 0
+                                            ? gen() % alphabet.size()
+                                            : gen() % 5]);
+            }
+            dict.insert(word, 1 + gen() % (i % 2 == 0 ? 30 : 5000000));
+            if (i % 10 == 0) {
+                queries.push_back(word);
+                queries.push_back(word.substr(0, 1 + gen() % len));
+            }
+        }
+        queries.push_back("zzz");
+        queries.push_back("");
+        SuccinctTrie::write(dict, TRIE_FILE);
+        trie.open(TRIE_FILE);
+    }
+
+    ~SuccinctTrieTest() {
+        trie.close();
+        remove(TRIE_FILE);
+    }
+};
+
+// find gives the same answers
+TEST_F(SuccinctTrieTest, FIND_TEST) {
+    ASSERT_GT(trie.numWords(), 0);
+    for (const string& q : queries) {
+        ASSERT_EQ(trie.find(q), dict.find(q)) << q;
+        ASSERT_EQ(trie.find(q + "a"), dict.find(q + "a")) << q;
+    }
+}
+
+// predictCompletions gives the same answers
+TEST_F(SuccinctTrieTest, PREDICT_TEST) {
+    for (const string& q : queries) {
+        for (unsigned int num : {0u, 1u, 4u, 20u, 500u}) {
+            ASSERT_EQ(trie.predictCompletions(q, num),
+                      dict.predictCompletions(q, num))
+                << q << " " << num;
+        }
+    }
+}
+
+// predictUnderscores gives the same answers
+TEST_F(SuccinctTrieTest, UNDERSCORE_TEST) {
+    mt19937 gen(5);
+    for (string q : queries) {
+        for (char& c : q) {
+            if (gen() % 2 == 0) {
+                c = '_';
+            }
+        }
+        for (unsigned int num : {1u, 5u, 100u}) {
+            ASSERT_EQ(trie.predictUnderscores(q, num),
+                      dict.predictUnderscores(q, num))
+                << q << " " << num;
+        }
+    }
+}
+
+// A dictionary with the ART engine gives the file of its words
+TEST_F(SuccinctTrieTest, ART_DICT_TEST) {
+    DictionaryTrie art(DictionaryTrie::ART);
+    string text;
+    vector<DictionaryTrie::Record> records = dict.listWords(text);
+    art.bulkBuild(records);
+    ASSERT_TRUE(SuccinctTrie::write(art, TRIE_FILE));
+    SuccinctTrie fromArt;
+    ASSERT_TRUE(fromArt.open(TRIE_FILE));
+    ASSERT_EQ(fromArt.numWords(), trie.numWords());
+    for (const string& q : queries) {
+        ASSERT_EQ(fromArt.predictCompletions(q, 20),
+                  dict.predictCompletions(q, 20))
+            << q;
+    }
+}
+
+// A missing or foreign file is refused and leaves the trie empty
+TEST(SuccinctTrieTests, BAD_FILE_TEST) {
+    SuccinctTrie trie;
+    ASSERT_FALSE(trie.open("no_such_file.trie"));
+    {
+        ofstream out(TRIE_FILE, ios::binary);
+        out << string(400, 'x');
+    }
+    ASSERT_FALSE(trie.open(TRIE_FILE));
+    remove(TRIE_FILE);
+    ASSERT_EQ(trie.numWords(), 0);
+    ASSERT_FALSE(trie.find("x"));
+    ASSERT_EQ(trie.predictCompletions("x", 3).size(), 0);
+}
+
+// An empty dictionary gives a valid, empty file
+TEST(SuccinctTrieTests, EMPTY_DICT_TEST) {
+    DictionaryTrie dict;
+    ASSERT_TRUE(SuccinctTrie::write(dict, TRIE_FILE));
+    SuccinctTrie trie;
+    ASSERT_TRUE(trie.open(TRIE_FILE));
+    remove(TRIE_FILE);
+    ASSERT_EQ(trie.numWords(), 0);
+    ASSERT_FALSE(trie.find("a"));
+    ASSERT_EQ(trie.predictCompletions("a", 3).size(), 0);
+    ASSERT_EQ(trie.predictUnderscores("_", 3).size(), 0);
+}
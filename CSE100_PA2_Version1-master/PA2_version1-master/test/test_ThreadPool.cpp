@@ -0,0 +1,83 @@
+/**
+ * This file contains tests for the worker pool that DictionaryTrie
+ * uses to answer batches of queries.
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "ThreadPool.hpp"
+
+using namespace std;
+using namespace testing;
+
+/* Every task runs exactly once, on a valid worker */
+TEST(ThreadPoolTests, RUN_ALL_TASKS_TEST) {
+    ThreadPool pool(4);
+    ASSERT_EQ(pool.size(), 4);
+    vector<atomic<int>> runs(1000);
+    for (atomic<int>& r : runs) {
+        r = 0;
+    }
+    atomic<bool> badWorker(false);
+    pool.run(runs.size(), [&](size_t i, unsigned int worker) {
+        runs[i]++;
+        if (worker >= 4) {
+            badWorker = true;
+        }
+    });
+    for (atomic<int>& r : runs) {
+        ASSERT_EQ(r, 1);
+    }
+    ASSERT_FALSE(badWorker);
+}
+
+/* The pool runs job after job, including empty ones */
+TEST(ThreadPoolTests, REUSE_TEST) {
+    ThreadPool pool(3);
+    atomic<size_t> total(0);
+    for (size_t job = 0; job < 50; job++) {
+        pool.run(job, [&](size_t i, unsigned int) { total += i + 1; });
+    }
+    size_t expected = 0;
+    for (size_t job = 0; job < 50; job++) {
+        expected += job * (job + 1) / 2;
+    }
+    ASSERT_EQ(total, expected);
+}
+
+/* A pool of zero threads gets one per hardware thread, at least one */
+TEST(ThreadPoolTests, DEFAULT_SIZE_TEST) {
+    ThreadPool pool;
+    ASSERT_GE(pool.size(), 1);
+    int count = 0;
+    ThreadPool single(1);
+    single.run(10, [&](size_t, unsigned int) { count++; });
+    ASSERT_EQ(count, 10);
+}
+
+/* A throwing task reaches the caller of run, and the pool still works */
+TEST(ThreadPoolTests, EXCEPTION_TEST) {
+    ThreadPool pool(4);
+    atomic<size_t> ran(0);
+    bool caught = false;
+    try {
+        pool.run(1000, [&](size_t i, unsigned int) {
+            if (i == 10) {
+                throw runtime_error("task 10");
+            }
+            ran++;
+        });
+    } catch (const runtime_error& e) {
+        caught = string(e.what()) == "task 10";
+    }
+    ASSERT_TRUE(caught);
+    ASSERT_LT(ran, 1000);
+
+    ran = 0;
+    pool.run(100, [&](size_t, unsigned int) { ran++; });
+    ASSERT_EQ(ran, 100);
+}